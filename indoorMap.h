@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <ostream>
 #include <vector>
@@ -274,6 +276,69 @@ namespace Indoor::Map
         std::vector<WallSegment2D> segments;
     };
 
+    // Thin obstacle like a handrail, represented as a line with thickness.
+    struct LineObstacle
+    {
+        WallMaterial material;
+        ObstacleType type;
+
+        float x1, y1;
+        float x2, y2;
+
+        Point2D start() const { return Point2D(x1, y1); }
+        Point2D end()   const { return Point2D(x2, y2); }
+
+        float thickness;
+
+        // If equal to zero in the xml the floor's height is used.
+        float height;
+    };
+
+    // Round obstacle like a pillar.
+    struct CircleObstacle
+    {
+        WallMaterial material;
+
+        float cx, cy;
+        float radius;
+
+        // If equal to zero in the xml the floor's height is used.
+        float height;
+    };
+
+    // Door which is not part of a wall.
+    struct DoorObstacle
+    {
+        DoorType type;
+        WallMaterial material;
+
+        float x1, y1;
+        float x2, y2;
+
+        Point2D start() const { return Point2D(x1, y1); }
+        Point2D end()   const { return Point2D(x2, y2); }
+
+        float height;
+
+        // Opening direction
+        bool swap;
+    };
+
+    // 3D object like furniture, referencing a model file.
+    struct ObjectObstacle
+    {
+        std::string file;
+
+        // Position, rotation in degrees and scale
+        float x, y, z;
+        float rx, ry, rz;
+        float sx, sy, sz;
+
+        // The area covered by the object.
+        // Given by <point> children or, if there are none, the unit square scaled by sx/sy and rotated by rz around (x, y).
+        std::vector<Point2D> footprint;
+    };
+
     // Represents a single floor of the building.
     struct Floor
     {
@@ -292,6 +357,12 @@ namespace Indoor::Map
         // Contains all walls
         std::vector<Wall> walls;
 
+        // Obstacles besides walls
+        std::vector<LineObstacle> lineObstacles;
+        std::vector<CircleObstacle> circleObstacles;
+        std::vector<DoorObstacle> doorObstacles;
+        std::vector<ObjectObstacle> objectObstacles;
+
         std::vector<AccessPoint> accessPoints;
         std::vector<Beacon> beacons;
         std::vector<GroundtruthPoint> groundtruthPoints;
@@ -331,6 +402,27 @@ namespace Indoor::Map
         std::vector<EarthPosMapPos> correspondences;
     };
 
+    // Content hash of a map, see indoorMapHash.h
+    struct MapHash;
+
+    // Holds the cached content hash of a map. Copies start empty, a copy is usually made to be modified.
+    struct MapHashCache
+    {
+        mutable std::shared_ptr<const MapHash> hash;
+
+        MapHashCache() = default;
+        MapHashCache(const MapHashCache&) {}
+        MapHashCache(MapHashCache&&) noexcept = default;
+
+        MapHashCache& operator=(const MapHashCache&)
+        {
+            hash.reset();
+            return *this;
+        }
+
+        MapHashCache& operator=(MapHashCache&&) noexcept = default;
+    };
+
     // This is the root object of every map file.
     struct Map
     {
@@ -339,6 +431,9 @@ namespace Indoor::Map
 
         EarthRegistration earthRegistration;
         std::vector<Floor> floors;
+
+        // Cached result of contentHash(). Reset it with invalidateContentHash() after modifying the map.
+        MapHashCache cachedHash;
     };
 
 
@@ -393,6 +488,18 @@ namespace Indoor::Map
 
         virtual bool enterWallWindow(WallWindow& wallWindow) { return true; };
         virtual void leaveWallWindow(WallWindow& wallWindow) {};
+
+        virtual bool enterLineObstacle(LineObstacle& line) { return true; };
+        virtual void leaveLineObstacle(LineObstacle& line) {};
+
+        virtual bool enterCircleObstacle(CircleObstacle& circle) { return true; };
+        virtual void leaveCircleObstacle(CircleObstacle& circle) {};
+
+        virtual bool enterDoorObstacle(DoorObstacle& door) { return true; };
+        virtual void leaveDoorObstacle(DoorObstacle& door) {};
+
+        virtual bool enterObjectObstacle(ObjectObstacle& object) { return true; };
+        virtual void leaveObjectObstacle(ObjectObstacle& object) {};
     };
 
 }
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapSchema.h"
+#include "indoorMapWallSegments.h"
+
+namespace Indoor::Map
+{
+    constexpr char MapBinaryMagic[8] = { 'I', 'N', 'D', 'M', 'A', 'P', 'B', 0 };
+    constexpr uint32_t MapBinaryVersion = 1;
+
+    namespace detail
+    {
+        class BinaryWriter
+        {
+        public:
+            std::vector<uint8_t>& out;
+
+            void bytes(const void* data, size_t size)
+            {
+                const uint8_t* p = static_cast<const uint8_t*>(data);
+                out.insert(out.end(), p, p + size);
+            }
+
+            template<typename M>
+            void value(M v)
+            {
+                if constexpr (std::is_same_v<M, float>)
+                    bytes(&v, sizeof(v));
+                else if constexpr (std::is_same_v<M, bool>)
+                    out.push_back(v ? 1 : 0);
+                else
+                {
+                    const int32_t i = static_cast<int32_t>(v);
+                    bytes(&i, sizeof(i));
+                }
+            }
+
+            void string(const std::string& s)
+            {
+                value(static_cast<int32_t>(s.size()));
+                bytes(s.data(), s.size());
+            }
+        };
+
+        class BinaryReader
+        {
+        public:
+            const uint8_t* pos;
+            const uint8_t* end;
+            bool ok = true;
+
+            bool bytes(void* data, size_t size)
+            {
+                if (!ok || static_cast<size_t>(end - pos) < size)
+                    return ok = false;
+                std::memcpy(data, pos, size);
+                pos += size;
+                return true;
+            }
+
+            template<typename M>
+            void value(M& v)
+            {
+                if constexpr (std::is_same_v<M, float>)
+                {
+                    bytes(&v, sizeof(v));
+                }
+                else if constexpr (std::is_same_v<M, bool>)
+                {
+                    uint8_t b = 0;
+                    bytes(&b, 1);
+                    v = b != 0;
+                }
+                else
+                {
+                    int32_t i = 0;
+                    bytes(&i, sizeof(i));
+                    v = static_cast<M>(i);
+                }
+            }
+
+            // Element counts are bounded by the remaining bytes divided by the smallest size of an element,
+            // thus crafted counts cannot make the reader allocate more than the input justifies
+            bool count(uint32_t& n, size_t minElementSize = 1)
+            {
+                bytes(&n, sizeof(n));
+                return ok = ok && n <= static_cast<size_t>(end - pos) / minElementSize;
+            }
+
+            void string(std::string& s)
+            {
+                uint32_t n = 0;
+                if (count(n))
+                {
+                    s.assign(reinterpret_cast<const char*>(pos), n);
+                    pos += n;
+                }
+            }
+        };
+
+        template<typename T, typename M>
+        void encodeField(BinaryWriter& w, const T& object, const ValueField<T, M>& f) { w.value(object.*f.member); }
+
+        template<typename T>
+        void encodeField(BinaryWriter& w, const T& object, const StringField<T>& f) { w.string(object.*f.member); }
+
+        template<typename T>
+        void encodeField(BinaryWriter& w, const T& object, const PointField<T>& f)
+        {
+            w.value(object.*f.x);
+            w.value(object.*f.y);
+        }
+
+        template<typename T>
+        void encodeElement(BinaryWriter& w, const T& object);
+
+        template<typename T, typename Item>
+        void encodeChild(BinaryWriter& w, const T& object, const ListChild<T, Item>& c)
+        {
+            const std::vector<Item>& items = object.*c.member;
+            const uint32_t n = static_cast<uint32_t>(items.size());
+            w.bytes(&n, sizeof(n));
+            for (const Item& item : items)
+                encodeElement(w, item);
+        }
+
+        template<typename T, typename M>
+        void encodeChild(BinaryWriter& w, const T& object, const ObjectChild<T, M>& c)
+        {
+            encodeElement(w, object.*c.member);
+        }
+
+        template<typename T>
+        void encodeElement(BinaryWriter& w, const T& object)
+        {
+            forEachSchemaAttribute<T>([&](const auto& f) { encodeField(w, object, f); });
+            forEachSchemaChild<T>([&](const auto& c) { encodeChild(w, object, c); });
+        }
+
+        // Encoded size of an element with empty strings and lists, no element of the type is smaller
+        template<typename T>
+        size_t minEncodedSize()
+        {
+            static const size_t size = []
+            {
+                std::vector<uint8_t> out;
+                BinaryWriter w{ out };
+                encodeElement(w, T{});
+                return std::max<size_t>(out.size(), 1);
+            }();
+            return size;
+        }
+
+        template<typename T, typename M>
+        void readField(BinaryReader& r, T& object, const ValueField<T, M>& f) { r.value(object.*f.member); }
+
+        template<typename T>
+        void readField(BinaryReader& r, T& object, const StringField<T>& f) { r.string(object.*f.member); }
+
+        template<typename T>
+        void readField(BinaryReader& r, T& object, const PointField<T>& f)
+        {
+            r.value(object.*f.x);
+            r.value(object.*f.y);
+        }
+
+        template<typename T>
+        void readElement(BinaryReader& r, T& object);
+
+        template<typename T, typename Item>
+        void readChild(BinaryReader& r, T& object, const ListChild<T, Item>& c)
+        {
+            uint32_t n = 0;
+            if (!r.count(n, minEncodedSize<Item>()))
+                return;
+
+            std::vector<Item>& items = object.*c.member;
+            items.resize(n);
+            for (Item& item : items)
+            {
+                if (!r.ok)
+                    return;
+                readElement(r, item);
+            }
+        }
+
+        template<typename T, typename M>
+        void readChild(BinaryReader& r, T& object, const ObjectChild<T, M>& c)
+        {
+            readElement(r, object.*c.member);
+        }
+
+        template<typename T>
+        void readElement(BinaryReader& r, T& object)
+        {
+            forEachSchemaAttribute<T>([&](const auto& f) { readField(r, object, f); });
+            forEachSchemaChild<T>([&](const auto& c) { readChild(r, object, c); });
+        }
+    }
+
+    // Compact binary form of a map, generated from the schema (see indoorMapSchema.h): the magic, the version,
+    // then every element's fields in schema order and its children as count + elements. Native byte order.
+    // Unlike the XML the derived z positions are stored, wall segments are not.
+    inline std::vector<uint8_t> encodeMapBinary(const Map& map)
+    {
+        std::vector<uint8_t> out;
+        detail::BinaryWriter w{ out };
+        w.bytes(MapBinaryMagic, sizeof(MapBinaryMagic));
+        w.bytes(&MapBinaryVersion, sizeof(MapBinaryVersion));
+        detail::encodeElement(w, map);
+        return out;
+    }
+
+    // Returns false if the data is no valid encoded map. Wall segments are generated unless disabled.
+    inline bool decodeMapBinary(const uint8_t* data, size_t size, Map& map, bool generateSegments = true)
+    {
+        detail::BinaryReader r{ data, data + size };
+
+        char magic[sizeof(MapBinaryMagic)];
+        uint32_t version = 0;
+        if (!r.bytes(magic, sizeof(magic)) || std::memcmp(magic, MapBinaryMagic, sizeof(magic)) != 0
+            || !r.bytes(&version, sizeof(version)) || version != MapBinaryVersion)
+        {
+            return false;
+        }
+
+        map = Map();
+        detail::readElement(r, map);
+        if (!r.ok || r.pos != r.end)
+            return false;
+
+        if (generateSegments)
+        {
+            for (Floor& floor : map.floors)
+            {
+                for (Wall& wall : floor.walls)
+                    generateWallSegments(wall);
+            }
+        }
+        return true;
+    }
+
+    inline bool saveMapBinary(const Map& map, const std::string& filename)
+    {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out.is_open())
+            return false;
+
+        const std::vector<uint8_t> data = encodeMapBinary(map);
+        out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        return static_cast<bool>(out);
+    }
+
+    inline bool loadMapBinary(const std::string& filename, Map& map, bool generateSegments = true)
+    {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in.is_open())
+            return false;
+
+        const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        return decodeMapBinary(data.data(), data.size(), map, generateSegments);
+    }
+}
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compressed maps are read if the library is enabled:
+// define INDOOR_MAP_WITH_ZLIB (link zlib) for gzip and INDOOR_MAP_WITH_ZSTD (link libzstd) for zstd.
+#if defined(INDOOR_MAP_WITH_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(INDOOR_MAP_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+namespace Indoor::Map
+{
+    enum class CompressionFormat
+    {
+        None,
+        Gzip,
+        Zstd
+    };
+
+    enum class DecompressStatus
+    {
+        Ok,
+        Unsupported,    // the library for the format is not enabled
+        Corrupt,        // invalid or truncated compressed data
+        ReadError
+    };
+
+    // Detects the format by its magic bytes, at least 4 bytes should be given
+    inline CompressionFormat detectCompression(const void* data, size_t size)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        if (size >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+            return CompressionFormat::Gzip;
+        if (size >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd)
+            return CompressionFormat::Zstd;
+        return CompressionFormat::None;
+    }
+
+    inline bool compressionSupported(CompressionFormat format)
+    {
+        switch (format)
+        {
+        case CompressionFormat::None: return true;
+#if defined(INDOOR_MAP_WITH_ZLIB)
+        case CompressionFormat::Gzip: return true;
+#endif
+#if defined(INDOOR_MAP_WITH_ZSTD)
+        case CompressionFormat::Zstd: return true;
+#endif
+        default: return false;
+        }
+    }
+
+    namespace detail
+    {
+        // Decompresses chunks of input directly into the end of a string, which grows geometrically.
+        // Concatenated gzip members and zstd frames are decompressed one after another.
+        class StreamDecompressor
+        {
+        private:
+            CompressionFormat format;
+            std::string& out;
+            size_t outSize;
+            bool ended = false;
+            bool valid = false;
+
+#if defined(INDOOR_MAP_WITH_ZLIB)
+            z_stream zlib{};
+#endif
+#if defined(INDOOR_MAP_WITH_ZSTD)
+            ZSTD_DStream* zstd = nullptr;
+#endif
+
+            // Free space at the end of out, at least 64 KiB
+            char* space(size_t& available)
+            {
+                if (out.size() - outSize < 65536)
+                    out.resize(std::max(out.size() * 2, outSize + (size_t(1) << 20)));
+                available = out.size() - outSize;
+                return &out[outSize];
+            }
+
+        public:
+            // Appends to out, sizeHint is the expected decompressed size
+            StreamDecompressor(CompressionFormat format, std::string& out, size_t sizeHint = 0)
+                : format(format), out(out), outSize(out.size())
+            {
+                if (sizeHint > 0)
+                    out.resize(outSize + sizeHint);
+
+#if defined(INDOOR_MAP_WITH_ZLIB)
+                // 15 + 32: maximum window, gzip or zlib header
+                if (format == CompressionFormat::Gzip)
+                    valid = inflateInit2(&zlib, 15 + 32) == Z_OK;
+#endif
+#if defined(INDOOR_MAP_WITH_ZSTD)
+                if (format == CompressionFormat::Zstd)
+                {
+                    zstd = ZSTD_createDStream();
+                    valid = zstd && !ZSTD_isError(ZSTD_initDStream(zstd));
+                }
+#endif
+            }
+
+            ~StreamDecompressor()
+            {
+#if defined(INDOOR_MAP_WITH_ZLIB)
+                if (format == CompressionFormat::Gzip && valid)
+                    inflateEnd(&zlib);
+#endif
+#if defined(INDOOR_MAP_WITH_ZSTD)
+                if (zstd)
+                    ZSTD_freeDStream(zstd);
+#endif
+                out.resize(outSize);
+            }
+
+            StreamDecompressor(const StreamDecompressor&) = delete;
+            StreamDecompressor& operator=(const StreamDecompressor&) = delete;
+
+            bool isValid() const { return valid; }
+
+            // True if the input so far ends with a complete member or frame
+            bool finished() const { return ended; }
+
+            // Returns false on invalid data
+            bool feed(const uint8_t* data, size_t size)
+            {
+                if (!valid)
+                    return false;
+
+#if defined(INDOOR_MAP_WITH_ZLIB)
+                if (format == CompressionFormat::Gzip)
+                {
+                    zlib.next_in = const_cast<Bytef*>(data);
+                    zlib.avail_in = static_cast<uInt>(size);
+                    bool full = false;
+                    while (zlib.avail_in > 0 || full)
+                    {
+                        // Another member follows
+                        if (ended && zlib.avail_in > 0)
+                        {
+                            if (inflateReset(&zlib) != Z_OK)
+                                return false;
+                            ended = false;
+                        }
+
+                        size_t available;
+                        char* dst = space(available);
+                        const uInt chunk = static_cast<uInt>(std::min<size_t>(available, 1u << 30));
+                        zlib.next_out = reinterpret_cast<Bytef*>(dst);
+                        zlib.avail_out = chunk;
+
+                        const int r = inflate(&zlib, Z_NO_FLUSH);
+                        outSize += chunk - zlib.avail_out;
+                        full = zlib.avail_out == 0;
+
+                        // Z_BUF_ERROR: the input is used up and no output is pending
+                        if (r == Z_STREAM_END)
+                            ended = true;
+                        else if (r == Z_BUF_ERROR)
+                            break;
+                        else if (r != Z_OK)
+                            return false;
+                    }
+                    return true;
+                }
+#endif
+#if defined(INDOOR_MAP_WITH_ZSTD)
+                if (format == CompressionFormat::Zstd)
+                {
+                    ZSTD_inBuffer in = { data, size, 0 };
+                    bool full = false;
+                    while (in.pos < in.size || full)
+                    {
+                        size_t available;
+                        char* dst = space(available);
+                        ZSTD_outBuffer o = { dst, available, 0 };
+
+                        const size_t r = ZSTD_decompressStream(zstd, &o, &in);
+                        if (ZSTD_isError(r))
+                            return false;
+
+                        outSize += o.pos;
+                        full = o.pos == o.size;
+                        ended = r == 0;
+                    }
+                    return true;
+                }
+#endif
+                (void)data;
+                (void)size;
+                return false;
+            }
+        };
+
+        // Reads a stream in chunks on a second thread, thus reading overlaps with the consumer.
+        // At most depth chunks are buffered.
+        class ChunkReader
+        {
+        private:
+            std::istream& in;
+            const size_t chunkSize;
+            const size_t depth;
+
+            std::mutex mutex;
+            std::condition_variable changed;
+            std::deque<std::vector<uint8_t>> chunks;
+            std::vector<std::vector<uint8_t>> spare;
+            bool done = false;
+            bool failed = false;
+            bool stopped = false;
+
+            std::thread thread;
+
+            void run()
+            {
+                while (true)
+                {
+                    std::vector<uint8_t> chunk;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        changed.wait(lock, [&] { return stopped || chunks.size() < depth; });
+                        if (stopped)
+                            return;
+                        if (!spare.empty())
+                        {
+                            chunk = std::move(spare.back());
+                            spare.pop_back();
+                        }
+                    }
+
+                    chunk.resize(chunkSize);
+                    in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunkSize));
+                    chunk.resize(static_cast<size_t>(in.gcount()));
+                    const bool end = !in;
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!chunk.empty())
+                        chunks.push_back(std::move(chunk));
+                    if (end)
+                    {
+                        done = true;
+                        failed = in.bad();
+                    }
+                    changed.notify_all();
+                    if (end)
+                        return;
+                }
+            }
+
+        public:
+            ChunkReader(std::istream& in, size_t chunkSize = size_t(1) << 20, size_t depth = 4)
+                : in(in), chunkSize(chunkSize), depth(depth)
+            {
+                thread = std::thread([this] { run(); });
+            }
+
+            ~ChunkReader()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopped = true;
+                }
+                changed.notify_all();
+                thread.join();
+            }
+
+            ChunkReader(const ChunkReader&) = delete;
+            ChunkReader& operator=(const ChunkReader&) = delete;
+
+            // Replaces chunk by the next one, the previous buffer is reused. False at the end of the stream.
+            bool next(std::vector<uint8_t>& chunk)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (chunk.capacity() > 0)
+                    spare.push_back(std::move(chunk));
+
+                changed.wait(lock, [&] { return !chunks.empty() || done; });
+                if (chunks.empty())
+                    return false;
+
+                chunk = std::move(chunks.front());
+                chunks.pop_front();
+                changed.notify_all();
+                return true;
+            }
+
+            // After next() returned false: whether the stream failed
+            bool readFailed()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return failed;
+            }
+        };
+    }
+
+    // Decompresses the remaining stream and appends it to content. The stream is read on a second thread,
+    // overlapped with decompression. sizeHint is the expected decompressed size, e.g. a multiple of the file size.
+    inline DecompressStatus decompressStream(std::istream& in, CompressionFormat format, std::string& content, size_t sizeHint = 0)
+    {
+        if (!compressionSupported(format) || format == CompressionFormat::None)
+            return DecompressStatus::Unsupported;
+
+        detail::StreamDecompressor decompressor(format, content, sizeHint);
+        if (!decompressor.isValid())
+            return DecompressStatus::Unsupported;
+
+        detail::ChunkReader reader(in);
+        std::vector<uint8_t> chunk;
+        while (reader.next(chunk))
+        {
+            if (!decompressor.feed(chunk.data(), chunk.size()))
+                return DecompressStatus::Corrupt;
+        }
+
+        if (reader.readFailed())
+            return DecompressStatus::ReadError;
+        return decompressor.finished() ? DecompressStatus::Ok : DecompressStatus::Corrupt;
+    }
+
+    // Decompresses a buffer and appends it to content
+    inline DecompressStatus decompressBuffer(const void* data, size_t size, CompressionFormat format, std::string& content)
+    {
+        if (!compressionSupported(format) || format == CompressionFormat::None)
+            return DecompressStatus::Unsupported;
+
+        detail::StreamDecompressor decompressor(format, content, size * 8);
+        if (!decompressor.isValid())
+            return DecompressStatus::Unsupported;
+
+        if (!decompressor.feed(static_cast<const uint8_t*>(data), size))
+            return DecompressStatus::Corrupt;
+        return decompressor.finished() ? DecompressStatus::Ok : DecompressStatus::Corrupt;
+    }
+}
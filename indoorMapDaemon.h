@@ -0,0 +1,1052 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "indoorMap.h"
+#include "indoorMapDoorState.h"
+#include "indoorMapHash.h"
+#include "indoorMapKdTree.h"
+#include "indoorMapNavGraph.h"
+#include "indoorMapParser.h"
+#include "indoorMapQuery.h"
+#include "indoorMapSharedMemory.h"
+
+namespace Indoor::Map
+{
+    // Binary protocol of the map query daemon.
+    // Every request and response is a frame: QueryFrameHeader followed by bodySize bytes.
+    // The body of a request contains count QueryRequest records, the body of a response count QueryResponse records.
+    // Each record is followed by its variable length data, padded to 4 bytes.
+    // All values use the byte order of the host, the socket is local only.
+
+    constexpr uint32_t QueryProtocolMagic = 0x31514D49; // "IMQ1"
+
+    enum class QueryType : uint16_t
+    {
+        // Floor at z and whether (x, y) is within its outline
+        PointInFloor = 1,
+
+        // Position of the POI named by the request's data
+        RoomLookup,
+
+        // Nearest POI to (x, y) on the floor at z
+        NearestPoi,
+
+        // RSSI at (x, y, z) of the access point or beacon with the MAC address given by the request's data
+        PredictRssi,
+
+        // Walking route from (x, y, z) to (x2, y2, z2)
+        Route,
+
+        // Sets the state of a door for the following routes, the request's data is a DoorStateUpdate
+        SetDoorState
+    };
+
+    enum class QueryStatus : uint16_t
+    {
+        Ok,
+        NotFound,
+        UnknownMap,
+        InvalidRequest,
+        NotSupported
+    };
+
+    struct QueryFrameHeader
+    {
+        uint32_t magic;
+        uint32_t count;
+        uint32_t bodySize;
+    };
+
+    struct QueryRequest
+    {
+        uint16_t type;
+
+        // Index of the map as passed to MapQueryServer
+        uint16_t map;
+
+        // Number of data bytes following this record (without padding)
+        uint32_t dataLength;
+
+        float x, y, z;
+        float x2, y2, z2;
+    };
+
+    struct QueryResponse
+    {
+        uint16_t type;
+        uint16_t status;
+
+        int32_t floor;
+        int32_t index;
+
+        // PointInFloor: 1 if inside the outline, NearestPoi: distance, PredictRssi: dBm, Route: length
+        float value;
+
+        float x, y, z;
+
+        // Number of data bytes following this record (without padding).
+        // NearestPoi and RoomLookup: POI name, Route: waypoints as x, y, z floats
+        uint32_t dataLength;
+    };
+
+    // Data of a SetDoorState request. Door ids are assigned by DoorStateOverlay (indoorMapDoorState.h).
+    // States are kept while the map content is unchanged, a changed map starts with all doors open.
+    struct DoorStateUpdate
+    {
+        uint32_t door;
+        uint32_t open;
+        float cost;
+    };
+
+    // Request with its data, used by MapQueryClient
+    struct Query
+    {
+        QueryType type;
+        uint16_t map = 0;
+        float x = 0, y = 0, z = 0;
+        float x2 = 0, y2 = 0, z2 = 0;
+        std::string data;
+    };
+
+    // Response with its data, returned by MapQueryClient
+    struct QueryResult
+    {
+        QueryResponse response;
+        std::vector<char> data;
+
+        QueryStatus status() const { return static_cast<QueryStatus>(response.status); }
+        std::string text() const { return std::string(data.begin(), data.end()); }
+    };
+
+    namespace detail
+    {
+        inline size_t padded(size_t length)
+        {
+            return (length + 3) & ~size_t(3);
+        }
+
+        inline void appendBytes(std::vector<char>& buffer, const void* data, size_t length)
+        {
+            // Empty data may come from an empty vector, data() is then allowed to be null
+            if (length == 0)
+                return;
+            const size_t at = buffer.size();
+            buffer.resize(at + padded(length), '\0');
+            std::memcpy(buffer.data() + at, data, length);
+        }
+
+        inline bool writeAll(int fd, const char* data, size_t length)
+        {
+            while (length > 0)
+            {
+                const ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                data += n;
+                length -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        inline bool readAll(int fd, char* data, size_t length)
+        {
+            while (length > 0)
+            {
+                const ssize_t n = ::recv(fd, data, length, 0);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                data += n;
+                length -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+    }
+
+    // Serves queries on loaded maps over a unix domain socket.
+    // Maps are loaded once and shared by all clients. Sources are reloaded in the background when they change,
+    // requests in flight keep using the previous version.
+    // One epoll thread handles all connections, the queries are answered by a pool of worker threads.
+    class MapQueryServer
+    {
+    public:
+        struct Options
+        {
+            std::string socketPath;
+
+            // 0 uses the number of hardware threads
+            size_t workerCount = 0;
+
+            // Interval in which the map sources are checked for changes
+            int reloadIntervalMs = 2000;
+
+            // Larger requests are rejected and the connection is closed.
+            // Each connection buffers at most one frame of this size of input and of unsent responses,
+            // beyond that it is not read until the backlog is processed.
+            uint32_t maxFrameSize = 16 * 1024 * 1024;
+        };
+
+        // A map source is either a file path or "shm:" followed by the name of a segment published by SharedMap.
+        struct MapSource
+        {
+            std::string path;
+        };
+
+    private:
+        struct ServedMap
+        {
+            std::shared_ptr<const Map> map;
+            std::shared_ptr<const MapPointIndex> pointIndex;
+
+            // Route queries, the graph references the map and the door states.
+            // The states are updated in place, they are atomic.
+            std::shared_ptr<DoorStateOverlay> doors;
+            std::shared_ptr<const NavGraph> navGraph;
+
+            // File modification time or shared memory segment of the loaded version, see sourceVersion()
+            int64_t version = -1;
+
+            // MapHash::all of the loaded map, a changed source with equal content keeps the served data
+            Hash128 contentHash;
+        };
+
+        struct Connection
+        {
+            int fd = -1;
+            uint64_t id = 0;
+            std::vector<char> in;
+            std::vector<char> out;
+            size_t outPos = 0;
+
+            // Only one frame per connection is processed at a time, this keeps responses in order.
+            bool busy = false;
+
+            // Events registered with epoll
+            uint32_t events = EPOLLIN;
+        };
+
+        struct Completion
+        {
+            int fd;
+            uint64_t connectionId;
+            std::vector<char> frame;
+        };
+
+        Options options;
+        std::vector<MapSource> sources;
+        std::vector<std::shared_ptr<const ServedMap>> maps;
+
+        int listenFd = -1;
+        int epollFd = -1;
+        int wakeFd = -1;
+        std::atomic<bool> running{ false };
+
+        std::unordered_map<int, Connection> connections;
+        uint64_t nextConnectionId = 1;
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> jobs;
+        std::mutex jobMutex;
+        std::condition_variable jobCondition;
+        bool stopWorkers = false;
+
+        std::vector<Completion> completions;
+        std::mutex completionMutex;
+
+        std::atomic<bool> reloadPending{ false };
+
+        static std::runtime_error systemError(const std::string& what)
+        {
+            return std::runtime_error(what + ": " + std::strerror(errno));
+        }
+
+        std::shared_ptr<const ServedMap> servedMap(size_t index) const
+        {
+            return std::atomic_load(&maps[index]);
+        }
+
+        static bool isSharedMemory(const MapSource& source)
+        {
+            return source.path.compare(0, 4, "shm:") == 0;
+        }
+
+        // Returns the version of the source or -1 if it is not available: the modification time of a file,
+        // the inode of a shared memory segment. SharedMap::publish() creates a new segment, thus a new inode,
+        // independent of the generation passed to it. The segment is not mapped for the check.
+        static int64_t sourceVersion(const MapSource& source)
+        {
+            struct stat st;
+            if (isSharedMemory(source))
+            {
+                const int fd = shm_open(source.path.c_str() + 4, O_RDONLY, 0);
+                if (fd < 0)
+                    return -1;
+                const int result = fstat(fd, &st);
+                ::close(fd);
+                return result == 0 ? static_cast<int64_t>(st.st_ino) : -1;
+            }
+
+            if (stat(source.path.c_str(), &st) != 0)
+                return -1;
+            return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        }
+
+        // Loads the map and its content hash, returns nullptr if the source can not be read
+        static std::shared_ptr<const Map> loadSource(const MapSource& source, Hash128& hash)
+        {
+            if (isSharedMemory(source))
+            {
+                try
+                {
+                    SharedMap shared = SharedMap::attach(source.path.substr(4));
+                    hash = shared.view().header().contentHash;
+                    return std::make_shared<const Map>(shared.view().toMap());
+                }
+                catch (const std::exception&)
+                {
+                    return nullptr;
+                }
+            }
+
+            MapParser parser;
+            ParseResult result = parser.tryReadMapFromFile(source.path);
+            if (!result.ok())
+                return nullptr;
+            hash = contentHash(*result.map).all;
+            return result.map;
+        }
+
+        // Reloads all changed sources. A failed reload keeps the previous version.
+        void reloadChangedMaps()
+        {
+            for (size_t i = 0; i < sources.size(); i++)
+            {
+                const std::shared_ptr<const ServedMap> current = servedMap(i);
+                const int64_t version = sourceVersion(sources[i]);
+                if (version < 0 || version == current->version)
+                    continue;
+
+                Hash128 hash;
+                std::shared_ptr<const Map> map = loadSource(sources[i], hash);
+                if (!map)
+                    continue;
+
+                auto served = std::make_shared<ServedMap>();
+                if (current->map && hash == current->contentHash)
+                {
+                    // Touched or republished without changes
+                    *served = *current;
+                }
+                else
+                {
+                    served->map = map;
+                    served->pointIndex = std::make_shared<const MapPointIndex>(*map);
+                    served->doors = std::make_shared<DoorStateOverlay>(*map);
+                    served->navGraph = std::make_shared<const NavGraph>(*map, *served->doors);
+                    served->contentHash = hash;
+                }
+                served->version = version;
+                std::atomic_store(&maps[i], std::shared_ptr<const ServedMap>(served));
+            }
+        }
+
+        void workerLoop()
+        {
+            while (true)
+            {
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(jobMutex);
+                    jobCondition.wait(lock, [this] { return stopWorkers || !jobs.empty(); });
+                    if (stopWorkers && jobs.empty())
+                        return;
+
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+            }
+        }
+
+        void submit(std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                jobs.push_back(std::move(job));
+            }
+            jobCondition.notify_one();
+        }
+
+        void wake()
+        {
+            const uint64_t one = 1;
+            ssize_t n = ::write(wakeFd, &one, sizeof(one));
+            (void)n;
+        }
+
+        void closeConnection(int fd)
+        {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            ::close(fd);
+            connections.erase(fd);
+        }
+
+        size_t bufferLimit() const
+        {
+            return sizeof(QueryFrameHeader) + options.maxFrameSize;
+        }
+
+        // Reading stops while the input buffer is full, the socket buffer then blocks the client
+        void updateEvents(Connection& c)
+        {
+            const uint32_t events = (c.in.size() < bufferLimit() ? static_cast<uint32_t>(EPOLLIN) : 0u)
+                | (c.outPos < c.out.size() ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+            if (events == c.events)
+                return;
+
+            c.events = events;
+            epoll_event ev = {};
+            ev.events = events;
+            ev.data.fd = c.fd;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+        }
+
+        void acceptConnections()
+        {
+            while (true)
+            {
+                const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0)
+                    return;
+
+                Connection c;
+                c.fd = fd;
+                c.id = nextConnectionId++;
+                connections[fd] = std::move(c);
+
+                epoll_event ev = {};
+                ev.events = EPOLLIN;
+                ev.data.fd = fd;
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+            }
+        }
+
+        // Dispatches the next complete frame of the connection to the worker pool.
+        // Clients which do not read their responses are not served further until they do.
+        // Returns false if the connection sent an invalid frame.
+        bool dispatchFrame(Connection& c)
+        {
+            if (c.busy || c.in.size() < sizeof(QueryFrameHeader) || c.out.size() - c.outPos >= bufferLimit())
+                return true;
+
+            QueryFrameHeader header;
+            std::memcpy(&header, c.in.data(), sizeof(header));
+            if (header.magic != QueryProtocolMagic || header.bodySize > options.maxFrameSize)
+                return false;
+
+            const size_t frameSize = sizeof(header) + header.bodySize;
+            if (c.in.size() < frameSize)
+                return true;
+
+            auto frame = std::make_shared<std::vector<char>>(c.in.begin(), c.in.begin() + frameSize);
+            c.in.erase(c.in.begin(), c.in.begin() + frameSize);
+            c.busy = true;
+
+            const int fd = c.fd;
+            const uint64_t id = c.id;
+            submit([this, fd, id, frame]()
+            {
+                std::vector<char> response = processFrame(frame->data(), frame->size());
+                {
+                    std::lock_guard<std::mutex> lock(completionMutex);
+                    completions.push_back(Completion{ fd, id, std::move(response) });
+                }
+                wake();
+            });
+
+            return true;
+        }
+
+        // Dispatches the next frame and updates the events, returns false if the connection was closed
+        bool serveConnection(Connection& c)
+        {
+            if (!dispatchFrame(c))
+            {
+                closeConnection(c.fd);
+                return false;
+            }
+
+            updateEvents(c);
+            return true;
+        }
+
+        void readConnection(Connection& c)
+        {
+            char buffer[16384];
+            while (c.in.size() < bufferLimit())
+            {
+                const ssize_t n = ::recv(c.fd, buffer, std::min(sizeof(buffer), bufferLimit() - c.in.size()), 0);
+                if (n > 0)
+                {
+                    c.in.insert(c.in.end(), buffer, buffer + n);
+                    continue;
+                }
+
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                {
+                    closeConnection(c.fd);
+                    return;
+                }
+
+                if (errno != EINTR)
+                    break;
+            }
+
+            serveConnection(c);
+        }
+
+        // Returns false if the connection was closed.
+        bool writeConnection(Connection& c)
+        {
+            while (c.outPos < c.out.size())
+            {
+                const ssize_t n = ::send(c.fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+                if (n > 0)
+                {
+                    c.outPos += static_cast<size_t>(n);
+                    continue;
+                }
+
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+                if (n < 0 && errno == EINTR)
+                    continue;
+
+                closeConnection(c.fd);
+                return false;
+            }
+
+            if (c.outPos == c.out.size())
+            {
+                c.out.clear();
+                c.outPos = 0;
+            }
+
+            updateEvents(c);
+            return true;
+        }
+
+        void handleCompletions()
+        {
+            uint64_t value;
+            ssize_t n = ::read(wakeFd, &value, sizeof(value));
+            (void)n;
+
+            std::vector<Completion> done;
+            {
+                std::lock_guard<std::mutex> lock(completionMutex);
+                done.swap(completions);
+            }
+
+            for (Completion& completion : done)
+            {
+                // The descriptor may have been closed and reused by a new connection in the meantime
+                auto it = connections.find(completion.fd);
+                if (it == connections.end() || it->second.id != completion.connectionId)
+                    continue;
+
+                Connection& c = it->second;
+                c.busy = false;
+                c.out.insert(c.out.end(), completion.frame.begin(), completion.frame.end());
+                if (writeConnection(c))
+                    serveConnection(c);
+            }
+        }
+
+        QueryResponse answer(const QueryRequest& request, const std::string& data, std::vector<char>& responseData) const
+        {
+            QueryResponse response = {};
+            response.type = request.type;
+            response.floor = -1;
+            response.index = -1;
+
+            if (request.map >= maps.size())
+            {
+                response.status = static_cast<uint16_t>(QueryStatus::UnknownMap);
+                return response;
+            }
+
+            const std::shared_ptr<const ServedMap> served = servedMap(request.map);
+            if (!served->map)
+            {
+                response.status = static_cast<uint16_t>(QueryStatus::UnknownMap);
+                return response;
+            }
+
+            const Map& map = *served->map;
+            const Point2D pos(request.x, request.y);
+            QueryStatus status = QueryStatus::NotFound;
+
+            switch (static_cast<QueryType>(request.type))
+            {
+            case QueryType::PointInFloor:
+            {
+                response.floor = floorIndexAt(map, request.z);
+                if (response.floor >= 0)
+                {
+                    response.value = isInOutline(map.floors[response.floor], pos) ? 1.0f : 0.0f;
+                    status = QueryStatus::Ok;
+                }
+                break;
+            }
+            case QueryType::RoomLookup:
+            {
+                int floorIndex, poiIndex;
+                if (findPointOfInterest(map, data, floorIndex, poiIndex))
+                {
+                    const PointOfInterest& poi = map.floors[floorIndex].pois[poiIndex];
+                    response.floor = floorIndex;
+                    response.index = poiIndex;
+                    response.x = poi.x;
+                    response.y = poi.y;
+                    response.z = map.floors[floorIndex].atHeight;
+                    responseData.assign(poi.name.begin(), poi.name.end());
+                    status = QueryStatus::Ok;
+                }
+                break;
+            }
+            case QueryType::NearestPoi:
+            {
+                response.floor = floorIndexAt(map, request.z);
+                if (response.floor >= 0)
+                {
+                    const Floor& floor = map.floors[response.floor];
+                    response.index = served->pointIndex->floors[response.floor].pois.nearest({ pos.x, pos.y });
+                    if (response.index >= 0)
+                    {
+                        const PointOfInterest& poi = floor.pois[response.index];
+                        response.x = poi.x;
+                        response.y = poi.y;
+                        response.z = floor.atHeight;
+                        response.value = (Point2D(poi.x, poi.y) - pos).length();
+                        responseData.assign(poi.name.begin(), poi.name.end());
+                        status = QueryStatus::Ok;
+                    }
+                }
+                break;
+            }
+            case QueryType::PredictRssi:
+            {
+                for (size_t f = 0; f < map.floors.size() && status != QueryStatus::Ok; f++)
+                {
+                    const Floor& floor = map.floors[f];
+                    for (size_t i = 0; i < floor.accessPoints.size(); i++)
+                    {
+                        if (floor.accessPoints[i].macAddress == data)
+                        {
+                            response.floor = static_cast<int32_t>(f);
+                            response.index = static_cast<int32_t>(i);
+                            response.value = predictRssi(map, floor.accessPoints[i], request.x, request.y, request.z);
+                            status = QueryStatus::Ok;
+                            break;
+                        }
+                    }
+                    for (size_t i = 0; i < floor.beacons.size() && status != QueryStatus::Ok; i++)
+                    {
+                        if (floor.beacons[i].macAddress == data)
+                        {
+                            response.floor = static_cast<int32_t>(f);
+                            response.index = static_cast<int32_t>(i);
+                            response.value = predictRssi(map, floor.beacons[i], request.x, request.y, request.z);
+                            status = QueryStatus::Ok;
+                        }
+                    }
+                }
+                break;
+            }
+            case QueryType::Route:
+            {
+                // One workspace per worker thread, searches only touch the visited nodes
+                thread_local NavSearchWorkspace workspace;
+                thread_local std::vector<NavWaypoint> path;
+
+                const int fromFloor = floorIndexAt(map, request.z);
+                const int toFloor = floorIndexAt(map, request.z2);
+                float length;
+                if (fromFloor >= 0 && toFloor >= 0
+                    && shortestPath(*served->navGraph, fromFloor, pos, toFloor, Point2D(request.x2, request.y2), path, length, workspace))
+                {
+                    response.floor = fromFloor;
+                    response.value = length;
+                    response.x = request.x2;
+                    response.y = request.y2;
+                    response.z = map.floors[toFloor].atHeight;
+
+                    for (const NavWaypoint& wp : path)
+                    {
+                        const float xyz[3] = { wp.position.x, wp.position.y, map.floors[wp.floor].atHeight };
+                        const char* bytes = reinterpret_cast<const char*>(xyz);
+                        responseData.insert(responseData.end(), bytes, bytes + sizeof(xyz));
+                    }
+                    status = QueryStatus::Ok;
+                }
+                break;
+            }
+            case QueryType::SetDoorState:
+            {
+                DoorStateUpdate update;
+                if (data.size() != sizeof(update))
+                {
+                    status = QueryStatus::InvalidRequest;
+                    break;
+                }
+
+                std::memcpy(&update, data.data(), sizeof(update));
+                response.index = static_cast<int32_t>(update.door);
+                if (update.door < served->doors->size())
+                {
+                    served->doors->set(update.door, DoorState{ update.open != 0, update.cost });
+                    status = QueryStatus::Ok;
+                }
+                break;
+            }
+            default:
+                status = QueryStatus::InvalidRequest;
+                break;
+            }
+
+            response.status = static_cast<uint16_t>(status);
+            return response;
+        }
+
+    public:
+        MapQueryServer(const Options& options, const std::vector<MapSource>& sources)
+            : options(options), sources(sources)
+        {
+            for (size_t i = 0; i < sources.size(); i++)
+            {
+                maps.push_back(std::make_shared<const ServedMap>());
+            }
+        }
+
+        ~MapQueryServer()
+        {
+            stop();
+        }
+
+        // Map currently served for the source index, may be null if the source could not be loaded yet.
+        std::shared_ptr<const Map> map(size_t index) const
+        {
+            return servedMap(index)->map;
+        }
+
+        // Door states used by route queries on the map currently served for the source index, may be null.
+        // Updates take effect for the following queries, a reloaded map with changed content gets new states.
+        std::shared_ptr<DoorStateOverlay> doorStates(size_t index) const
+        {
+            return servedMap(index)->doors;
+        }
+
+        // Answers all requests of a frame and returns the response frame.
+        // Invalid frames result in an empty response frame.
+        std::vector<char> processFrame(const char* frame, size_t size) const
+        {
+            QueryFrameHeader header;
+            uint32_t answered = 0;
+
+            // The header is written last, when the body size is known
+            QueryFrameHeader responseHeader = {};
+            std::vector<char> result(sizeof(responseHeader));
+
+            if (size >= sizeof(header))
+            {
+                std::memcpy(&header, frame, sizeof(header));
+
+                const char* pos = frame + sizeof(header);
+                const char* end = frame + std::min<size_t>(size, sizeof(header) + header.bodySize);
+
+                for (uint32_t i = 0; i < header.count; i++)
+                {
+                    QueryRequest request;
+                    if (static_cast<size_t>(end - pos) < sizeof(request))
+                        break;
+                    std::memcpy(&request, pos, sizeof(request));
+                    pos += sizeof(request);
+
+                    if (static_cast<size_t>(end - pos) < detail::padded(request.dataLength))
+                        break;
+                    const std::string data(pos, request.dataLength);
+                    pos += detail::padded(request.dataLength);
+
+                    std::vector<char> responseData;
+                    QueryResponse response = answer(request, data, responseData);
+                    response.dataLength = static_cast<uint32_t>(responseData.size());
+
+                    detail::appendBytes(result, &response, sizeof(response));
+                    detail::appendBytes(result, responseData.data(), responseData.size());
+                    answered++;
+                }
+            }
+
+            responseHeader.magic = QueryProtocolMagic;
+            responseHeader.count = answered;
+            responseHeader.bodySize = static_cast<uint32_t>(result.size() - sizeof(responseHeader));
+            std::memcpy(result.data(), &responseHeader, sizeof(responseHeader));
+            return result;
+        }
+
+        // Loads all maps, binds the socket and serves until stop() is called.
+        // Throws std::runtime_error if the socket can not be created.
+        void run()
+        {
+            reloadChangedMaps();
+
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            if (options.socketPath.size() >= sizeof(addr.sun_path))
+                throw std::runtime_error("Map query socket path too long: '" + options.socketPath + "'");
+            std::strcpy(addr.sun_path, options.socketPath.c_str());
+
+            listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listenFd < 0)
+                throw systemError("Creating map query socket");
+
+            ::unlink(options.socketPath.c_str());
+            if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(listenFd, 128) != 0)
+            {
+                const std::runtime_error error = systemError("Binding map query socket '" + options.socketPath + "'");
+                closeDescriptors();
+                ::unlink(options.socketPath.c_str());
+                throw error;
+            }
+
+            epollFd = epoll_create1(EPOLL_CLOEXEC);
+            wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (epollFd < 0 || wakeFd < 0)
+            {
+                const std::runtime_error error = systemError("Creating map query event loop");
+                closeDescriptors();
+                ::unlink(options.socketPath.c_str());
+                throw error;
+            }
+
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = listenFd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+            ev.data.fd = wakeFd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+
+            size_t workerCount = options.workerCount ? options.workerCount : std::max(1u, std::thread::hardware_concurrency());
+            stopWorkers = false;
+            for (size_t i = 0; i < workerCount; i++)
+            {
+                workers.emplace_back([this] { workerLoop(); });
+            }
+
+            running = true;
+            auto lastReload = std::chrono::steady_clock::now();
+            epoll_event events[64];
+            while (running)
+            {
+                const int n = epoll_wait(epollFd, events, 64, options.reloadIntervalMs);
+
+                for (int i = 0; i < n; i++)
+                {
+                    const int fd = events[i].data.fd;
+                    if (fd == listenFd)
+                    {
+                        acceptConnections();
+                    }
+                    else if (fd == wakeFd)
+                    {
+                        handleCompletions();
+                    }
+                    else
+                    {
+                        auto it = connections.find(fd);
+                        if (it == connections.end())
+                            continue;
+
+                        // The peer is gone, reading may be paused and would not notice it
+                        if (events[i].events & (EPOLLHUP | EPOLLERR))
+                        {
+                            closeConnection(fd);
+                            continue;
+                        }
+
+                        // Sent responses may let the next frame be dispatched
+                        if ((events[i].events & EPOLLOUT) && (!writeConnection(it->second) || !serveConnection(it->second)))
+                            continue;
+                        if (events[i].events & EPOLLIN)
+                            readConnection(it->second);
+                    }
+                }
+
+                // Reloading is done by a worker, queries keep being answered with the current maps
+                const auto now = std::chrono::steady_clock::now();
+                if (now - lastReload >= std::chrono::milliseconds(options.reloadIntervalMs) && !reloadPending.exchange(true))
+                {
+                    lastReload = now;
+                    submit([this]
+                    {
+                        reloadChangedMaps();
+                        reloadPending = false;
+                    });
+                }
+            }
+
+            shutdown();
+        }
+
+        // Can be called from any thread.
+        void stop()
+        {
+            if (running.exchange(false))
+                wake();
+        }
+
+    private:
+        void shutdown()
+        {
+            {
+                std::lock_guard<std::mutex> lock(jobMutex);
+                stopWorkers = true;
+            }
+            jobCondition.notify_all();
+            for (std::thread& worker : workers)
+                worker.join();
+            workers.clear();
+
+            for (auto& entry : connections)
+                ::close(entry.first);
+            connections.clear();
+
+            closeDescriptors();
+            ::unlink(options.socketPath.c_str());
+        }
+
+        // Also used if run() fails half way, only the created descriptors are open.
+        void closeDescriptors()
+        {
+            for (int* fd : { &listenFd, &epollFd, &wakeFd })
+            {
+                if (*fd >= 0)
+                    ::close(*fd);
+                *fd = -1;
+            }
+        }
+    };
+
+    // Blocking client of MapQueryServer.
+    class MapQueryClient
+    {
+    private:
+        int fd = -1;
+
+    public:
+        // Throws std::runtime_error if the daemon is not reachable.
+        explicit MapQueryClient(const std::string& socketPath)
+        {
+            fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+            if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+            {
+                const std::string msg = "Map query daemon not reachable at '" + socketPath + "': " + std::strerror(errno);
+                if (fd >= 0)
+                    ::close(fd);
+                throw std::runtime_error(msg);
+            }
+        }
+
+        MapQueryClient(const MapQueryClient&) = delete;
+        MapQueryClient& operator=(const MapQueryClient&) = delete;
+
+        ~MapQueryClient()
+        {
+            if (fd >= 0)
+                ::close(fd);
+        }
+
+        // Sends all queries in one frame. Throws std::runtime_error if the connection is lost.
+        std::vector<QueryResult> query(const std::vector<Query>& queries)
+        {
+            std::vector<char> body;
+            for (const Query& q : queries)
+            {
+                QueryRequest request = {};
+                request.type = static_cast<uint16_t>(q.type);
+                request.map = q.map;
+                request.dataLength = static_cast<uint32_t>(q.data.size());
+                request.x = q.x;
+                request.y = q.y;
+                request.z = q.z;
+                request.x2 = q.x2;
+                request.y2 = q.y2;
+                request.z2 = q.z2;
+
+                detail::appendBytes(body, &request, sizeof(request));
+                detail::appendBytes(body, q.data.data(), q.data.size());
+            }
+
+            QueryFrameHeader header = { QueryProtocolMagic, static_cast<uint32_t>(queries.size()), static_cast<uint32_t>(body.size()) };
+            if (!detail::writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) || !detail::writeAll(fd, body.data(), body.size()))
+                throw std::runtime_error("Map query daemon connection lost");
+
+            if (!detail::readAll(fd, reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != QueryProtocolMagic)
+                throw std::runtime_error("Map query daemon connection lost");
+
+            body.resize(header.bodySize);
+            if (!detail::readAll(fd, body.data(), body.size()))
+                throw std::runtime_error("Map query daemon connection lost");
+
+            std::vector<QueryResult> results;
+            size_t pos = 0;
+            for (uint32_t i = 0; i < header.count && pos + sizeof(QueryResponse) <= body.size(); i++)
+            {
+                QueryResult result;
+                std::memcpy(&result.response, body.data() + pos, sizeof(QueryResponse));
+                pos += sizeof(QueryResponse);
+
+                const size_t length = std::min<size_t>(result.response.dataLength, body.size() - pos);
+                result.data.assign(body.begin() + pos, body.begin() + pos + length);
+                pos += detail::padded(length);
+
+                results.push_back(std::move(result));
+            }
+
+            return results;
+        }
+    };
+}
@@ -0,0 +1,478 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapHash.h"
+
+namespace Indoor::Map
+{
+    // Changes of a single element list of a floor.
+    template<typename T>
+    struct ElementChanges
+    {
+        // Indices into the list of the old floor
+        std::vector<size_t> removed;
+
+        // New elements, appended to the list
+        std::vector<T> added;
+
+        // Index into the list of the old floor and its new value
+        std::vector<std::pair<size_t, T>> modified;
+
+        bool empty() const { return removed.empty() && added.empty() && modified.empty(); }
+    };
+
+    // Changes of a single floor.
+    // Walls and obstacles are matched by content and geometry, transmitters by MAC address,
+    // POIs, polygons and fingerprint locations by name and groundtruth points by id.
+    struct FloorPatch
+    {
+        // Index of the floor within the old map
+        size_t floorIndex = 0;
+
+        // New atHeight, height and name if attributesChanged is set
+        bool attributesChanged = false;
+        float atHeight = 0.0f;
+        float height = 0.0f;
+        std::string name;
+
+        ElementChanges<Polygon2D> outline;
+        ElementChanges<Wall> walls;
+        ElementChanges<LineObstacle> lineObstacles;
+        ElementChanges<CircleObstacle> circleObstacles;
+        ElementChanges<DoorObstacle> doorObstacles;
+        ElementChanges<ObjectObstacle> objectObstacles;
+        ElementChanges<AccessPoint> accessPoints;
+        ElementChanges<Beacon> beacons;
+        ElementChanges<GroundtruthPoint> groundtruthPoints;
+        ElementChanges<FingerprintLocation> fingerprintLocations;
+        ElementChanges<PointOfInterest> pois;
+
+        bool empty() const
+        {
+            return !attributesChanged && outline.empty() && walls.empty()
+                && lineObstacles.empty() && circleObstacles.empty() && doorObstacles.empty() && objectObstacles.empty()
+                && accessPoints.empty() && beacons.empty() && groundtruthPoints.empty()
+                && fingerprintLocations.empty() && pois.empty();
+        }
+    };
+
+    // Where a floor of the new map comes from
+    struct FloorOrigin
+    {
+        // Index into MapPatch::addedFloors if set, otherwise into the floors of the old map
+        bool added = false;
+        size_t index = 0;
+    };
+
+    // Change set between two maps. Floors are matched by name.
+    struct MapPatch
+    {
+        // New width and depth if attributesChanged is set
+        bool attributesChanged = false;
+        float width = 0.0f;
+        float depth = 0.0f;
+
+        bool earthRegistrationChanged = false;
+        EarthRegistration earthRegistration;
+
+        // Indices of floors of the old map
+        std::vector<size_t> removedFloors;
+
+        // New floors, appended to the floor list
+        std::vector<Floor> addedFloors;
+
+        // Only floors with changes are listed
+        std::vector<FloorPatch> floors;
+
+        // Floors of the new map in order. Empty if the remaining old floors keep their order
+        // and the added floors follow them.
+        std::vector<FloorOrigin> floorOrder;
+
+        // Content hashes (MapHash::all) of the old and the new map. Floors are addressed by index,
+        // thus the patch only applies to the map it was computed from.
+        Hash128 baseHash;
+        Hash128 targetHash;
+
+        bool empty() const
+        {
+            return !attributesChanged && !earthRegistrationChanged && removedFloors.empty() && addedFloors.empty() && floors.empty()
+                && floorOrder.empty();
+        }
+    };
+
+    namespace detail
+    {
+        // Matches the elements of a and b in two passes.
+        // 1) Elements with identical content hash are unchanged.
+        // 2) Remaining elements with equal keys are modified.
+        // Everything else is removed from a or added in b.
+        // Runs in O(n log n), the second pass only touches unmatched elements.
+        template<typename T, typename HashFunc, typename KeyFunc>
+        ElementChanges<T> diffElements(const std::vector<T>& a, const std::vector<T>& b, HashFunc hashFunc, KeyFunc keyFunc)
+        {
+            ElementChanges<T> changes;
+
+            std::vector<Hash128> hashB(b.size());
+            for (size_t j = 0; j < b.size(); j++)
+            {
+                hashB[j] = hashFunc(b[j]);
+            }
+
+            std::vector<bool> matchedA(a.size(), false);
+            std::vector<bool> alignedB(b.size(), false);
+            std::vector<size_t> unmatchedB;
+
+            // Edits usually keep the element order, thus elements at the same index are compared first.
+            // Only the remaining elements of a are sorted by hash.
+            std::vector<std::pair<Hash128, size_t>> hashA;
+            for (size_t i = 0; i < a.size(); i++)
+            {
+                const Hash128 h = hashFunc(a[i]);
+                if (i < b.size() && h == hashB[i])
+                    matchedA[i] = alignedB[i] = true;
+                else
+                    hashA.emplace_back(h, i);
+            }
+
+            auto less = [](const std::pair<Hash128, size_t>& x, const std::pair<Hash128, size_t>& y)
+            {
+                if (x.first.lo != y.first.lo) return x.first.lo < y.first.lo;
+                if (x.first.hi != y.first.hi) return x.first.hi < y.first.hi;
+                return x.second < y.second;
+            };
+            std::sort(hashA.begin(), hashA.end(), less);
+
+            // Pass 1: unchanged elements
+            for (size_t j = 0; j < b.size(); j++)
+            {
+                if (alignedB[j])
+                    continue;
+
+                const Hash128& h = hashB[j];
+                bool found = false;
+
+                auto it = std::lower_bound(hashA.begin(), hashA.end(), std::make_pair(h, size_t(0)), less);
+                for (; it != hashA.end() && it->first == h; ++it)
+                {
+                    if (!matchedA[it->second])
+                    {
+                        matchedA[it->second] = true;
+                        found = true;
+                        break;
+                    }
+                }
+
+                if (!found)
+                    unmatchedB.push_back(j);
+            }
+
+            // Pass 2: modified elements
+            using Key = decltype(keyFunc(a[0]));
+            std::unordered_multimap<Key, size_t> byKey;
+            if (!unmatchedB.empty())
+            {
+                for (size_t i = 0; i < a.size(); i++)
+                {
+                    if (!matchedA[i])
+                        byKey.emplace(keyFunc(a[i]), i);
+                }
+            }
+
+            for (size_t j : unmatchedB)
+            {
+                auto it = byKey.find(keyFunc(b[j]));
+                if (it != byKey.end())
+                {
+                    matchedA[it->second] = true;
+                    changes.modified.emplace_back(it->second, b[j]);
+                    byKey.erase(it);
+                }
+                else
+                {
+                    changes.added.push_back(b[j]);
+                }
+            }
+
+            for (size_t i = 0; i < a.size(); i++)
+            {
+                if (!matchedA[i])
+                    changes.removed.push_back(i);
+            }
+
+            return changes;
+        }
+
+        template<typename T>
+        void applyChanges(std::vector<T>& elements, const ElementChanges<T>& changes)
+        {
+            for (const auto& mod : changes.modified)
+            {
+                elements[mod.first] = mod.second;
+            }
+
+            std::vector<size_t> removed = changes.removed;
+            std::sort(removed.begin(), removed.end());
+
+            size_t write = 0;
+            size_t r = 0;
+            for (size_t i = 0; i < elements.size(); i++)
+            {
+                if (r < removed.size() && removed[r] == i)
+                {
+                    r++;
+                    continue;
+                }
+
+                if (write != i)
+                    elements[write] = std::move(elements[i]);
+                write++;
+            }
+            elements.resize(write);
+
+            elements.insert(elements.end(), changes.added.begin(), changes.added.end());
+        }
+
+        // Builds the floor list of the patched map, shared by the Map and MapSnapshot overloads of apply().
+        // patchFloor(floor, floorPatch) applies a FloorPatch, addFloor(const Floor&) converts an added floor.
+        template<typename F, typename PatchFunc, typename AddFunc>
+        std::vector<F> applyFloors(const std::vector<F>& floors, const MapPatch& patch, PatchFunc patchFloor, AddFunc addFloor)
+        {
+            std::vector<const FloorPatch*> floorPatches(floors.size(), nullptr);
+            for (const FloorPatch& fp : patch.floors)
+            {
+                floorPatches[fp.floorIndex] = &fp;
+            }
+
+            auto oldFloor = [&](size_t i) -> F
+            {
+                return floorPatches[i] ? patchFloor(floors[i], *floorPatches[i]) : floors[i];
+            };
+
+            std::vector<F> result;
+            if (!patch.floorOrder.empty())
+            {
+                result.reserve(patch.floorOrder.size());
+                for (const FloorOrigin& origin : patch.floorOrder)
+                {
+                    result.push_back(origin.added ? addFloor(patch.addedFloors[origin.index]) : oldFloor(origin.index));
+                }
+                return result;
+            }
+
+            std::vector<bool> removed(floors.size(), false);
+            for (size_t i : patch.removedFloors)
+            {
+                removed[i] = true;
+            }
+
+            result.reserve(floors.size() - patch.removedFloors.size() + patch.addedFloors.size());
+            for (size_t i = 0; i < floors.size(); i++)
+            {
+                if (!removed[i])
+                    result.push_back(oldFloor(i));
+            }
+
+            for (const Floor& floor : patch.addedFloors)
+            {
+                result.push_back(addFloor(floor));
+            }
+
+            return result;
+        }
+
+        // Identifies a wall by its geometry only
+        inline uint64_t wallGeometryKey(const Wall& wall)
+        {
+            return Hasher().add(wall.x1).add(wall.y1).add(wall.x2).add(wall.y2).finish().lo;
+        }
+
+        inline uint64_t lineObstacleKey(const LineObstacle& line)
+        {
+            return Hasher().add(line.x1).add(line.y1).add(line.x2).add(line.y2).finish().lo;
+        }
+
+        inline uint64_t circleObstacleKey(const CircleObstacle& circle)
+        {
+            return Hasher().add(circle.cx).add(circle.cy).finish().lo;
+        }
+
+        inline uint64_t doorObstacleKey(const DoorObstacle& door)
+        {
+            return Hasher().add(door.x1).add(door.y1).add(door.x2).add(door.y2).finish().lo;
+        }
+
+        inline uint64_t objectObstacleKey(const ObjectObstacle& object)
+        {
+            return Hasher().add(object.file).add(object.x).add(object.y).add(object.z).finish().lo;
+        }
+
+        inline std::string polygonKey(const Polygon2D& polygon) { return polygon.name; }
+        inline std::string accessPointKey(const AccessPoint& ap) { return ap.macAddress; }
+        inline std::string beaconKey(const Beacon& b) { return b.macAddress; }
+        inline int groundtruthPointKey(const GroundtruthPoint& gt) { return gt.id; }
+        inline std::string fingerprintLocationKey(const FingerprintLocation& fl) { return fl.name; }
+        inline std::string pointOfInterestKey(const PointOfInterest& poi) { return poi.name; }
+    }
+
+    // Computes the changes of a single floor.
+    inline FloorPatch diffFloor(const Floor& a, const Floor& b)
+    {
+        FloorPatch patch;
+
+        if (a.atHeight != b.atHeight || a.height != b.height || a.name != b.name)
+        {
+            patch.attributesChanged = true;
+            patch.atHeight = b.atHeight;
+            patch.height = b.height;
+            patch.name = b.name;
+        }
+
+        patch.outline = detail::diffElements(a.outline.polygons, b.outline.polygons, hashPolygon, detail::polygonKey);
+        patch.walls = detail::diffElements(a.walls, b.walls, hashWall, detail::wallGeometryKey);
+        patch.lineObstacles = detail::diffElements(a.lineObstacles, b.lineObstacles, hashLineObstacle, detail::lineObstacleKey);
+        patch.circleObstacles = detail::diffElements(a.circleObstacles, b.circleObstacles, hashCircleObstacle, detail::circleObstacleKey);
+        patch.doorObstacles = detail::diffElements(a.doorObstacles, b.doorObstacles, hashDoorObstacle, detail::doorObstacleKey);
+        patch.objectObstacles = detail::diffElements(a.objectObstacles, b.objectObstacles, hashObjectObstacle, detail::objectObstacleKey);
+        patch.accessPoints = detail::diffElements(a.accessPoints, b.accessPoints, hashAccessPoint, detail::accessPointKey);
+        patch.beacons = detail::diffElements(a.beacons, b.beacons, hashBeacon, detail::beaconKey);
+        patch.groundtruthPoints = detail::diffElements(a.groundtruthPoints, b.groundtruthPoints, hashGroundtruthPoint, detail::groundtruthPointKey);
+        patch.fingerprintLocations = detail::diffElements(a.fingerprintLocations, b.fingerprintLocations, hashFingerprintLocation, detail::fingerprintLocationKey);
+        patch.pois = detail::diffElements(a.pois, b.pois, hashPointOfInterest, detail::pointOfInterestKey);
+
+        return patch;
+    }
+
+    // Computes the change set to get from map a to map b.
+    // Floors with equal cached content hashes are skipped without comparing their elements.
+    inline MapPatch diff(const Map& a, const Map& b)
+    {
+        MapPatch patch;
+
+        if (a.width != b.width || a.depth != b.depth)
+        {
+            patch.attributesChanged = true;
+            patch.width = b.width;
+            patch.depth = b.depth;
+        }
+
+        const MapHash hashA = contentHash(a);
+        const MapHash hashB = contentHash(b);
+        patch.baseHash = hashA.all;
+        patch.targetHash = hashB.all;
+
+        if (hashA.earthRegistration != hashB.earthRegistration)
+        {
+            patch.earthRegistrationChanged = true;
+            patch.earthRegistration = b.earthRegistration;
+        }
+
+        // Match floors by name, duplicate names are matched in order
+        std::unordered_multimap<std::string, size_t> floorsA;
+        for (size_t i = 0; i < a.floors.size(); i++)
+        {
+            floorsA.emplace(a.floors[i].name, i);
+        }
+
+        std::vector<bool> matchedA(a.floors.size(), false);
+        for (size_t j = 0; j < b.floors.size(); j++)
+        {
+            size_t match = a.floors.size();
+            auto range = floorsA.equal_range(b.floors[j].name);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (!matchedA[it->second] && it->second < match)
+                    match = it->second;
+            }
+
+            if (match == a.floors.size())
+            {
+                patch.floorOrder.push_back({ true, patch.addedFloors.size() });
+                patch.addedFloors.push_back(b.floors[j]);
+                continue;
+            }
+
+            patch.floorOrder.push_back({ false, match });
+            matchedA[match] = true;
+            if (hashA.floors[match].all == hashB.floors[j].all)
+                continue;
+
+            FloorPatch floorPatch = diffFloor(a.floors[match], b.floors[j]);
+            floorPatch.floorIndex = match;
+            if (!floorPatch.empty())
+                patch.floors.push_back(std::move(floorPatch));
+        }
+
+        for (size_t i = 0; i < a.floors.size(); i++)
+        {
+            if (!matchedA[i])
+                patch.removedFloors.push_back(i);
+        }
+
+        // The order is only kept if it differs from the old floors followed by the added ones
+        bool defaultOrder = true;
+        for (size_t j = 1; j < patch.floorOrder.size(); j++)
+        {
+            const FloorOrigin& prev = patch.floorOrder[j - 1];
+            const FloorOrigin& next = patch.floorOrder[j];
+            if ((prev.added && !next.added) || (!prev.added && !next.added && prev.index > next.index))
+                defaultOrder = false;
+        }
+        if (defaultOrder)
+            patch.floorOrder.clear();
+
+        return patch;
+    }
+
+    // Applies the changes of a FloorPatch to a copy of the floor.
+    inline Floor apply(const Floor& floor, const FloorPatch& patch)
+    {
+        Floor result = floor;
+
+        if (patch.attributesChanged)
+        {
+            result.atHeight = patch.atHeight;
+            result.height = patch.height;
+            result.name = patch.name;
+        }
+
+        detail::applyChanges(result.outline.polygons, patch.outline);
+        detail::applyChanges(result.walls, patch.walls);
+        detail::applyChanges(result.lineObstacles, patch.lineObstacles);
+        detail::applyChanges(result.circleObstacles, patch.circleObstacles);
+        detail::applyChanges(result.doorObstacles, patch.doorObstacles);
+        detail::applyChanges(result.objectObstacles, patch.objectObstacles);
+        detail::applyChanges(result.accessPoints, patch.accessPoints);
+        detail::applyChanges(result.beacons, patch.beacons);
+        detail::applyChanges(result.groundtruthPoints, patch.groundtruthPoints);
+        detail::applyChanges(result.fingerprintLocations, patch.fingerprintLocations);
+        detail::applyChanges(result.pois, patch.pois);
+
+        return result;
+    }
+
+    // Creates a new map by applying the patch to a map equal to the first argument of diff().
+    // Removed floors are dropped, added floors are placed as in the second argument of diff().
+    // Unchanged floors are copied, use the MapSnapshot overload (indoorMapSnapshot.h) to share them instead.
+    // Returns nullptr if the patch was not computed from a map with this content (MapPatch::baseHash).
+    inline std::shared_ptr<Map> apply(const Map& map, const MapPatch& patch)
+    {
+        if (contentHash(map).all != patch.baseHash)
+            return nullptr;
+
+        auto result = std::make_shared<Map>();
+        result->width = patch.attributesChanged ? patch.width : map.width;
+        result->depth = patch.attributesChanged ? patch.depth : map.depth;
+        result->earthRegistration = patch.earthRegistrationChanged ? patch.earthRegistration : map.earthRegistration;
+        result->floors = detail::applyFloors(map.floors, patch,
+            [](const Floor& floor, const FloorPatch& fp) { return apply(floor, fp); },
+            [](const Floor& floor) { return floor; });
+        return result;
+    }
+}
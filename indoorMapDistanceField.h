@@ -0,0 +1,564 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapHash.h"
+#include "indoorMapParallel.h"
+#include "indoorMapWallIndex.h"
+
+namespace Indoor::Map
+{
+    // Closest point to p on the segment [a, b]
+    inline Point2D closestPointOnSegment(const Point2D& p, const Point2D& a, const Point2D& b)
+    {
+        const Point2D ab = b - a;
+        const float len2 = ab.x * ab.x + ab.y * ab.y;
+        if (len2 <= 0.0f)
+            return a;
+
+        const Point2D ap = p - a;
+        const float t = std::clamp((ap.x * ab.x + ap.y * ab.y) / len2, 0.0f, 1.0f);
+        return a + ab * t;
+    }
+
+    struct WalkableGridOptions
+    {
+        // Edge length of a cell in meters
+        float cellSize = 0.25f;
+
+        // Additional distance to blocking walls and obstacles, beyond half the wall thickness
+        float clearance = 0.0f;
+
+        // Threads used to rasterize the rows, 0 uses all hardware threads
+        size_t threadCount = 0;
+    };
+
+    // Raster of the walkable area of a floor.
+    // A cell is walkable if its center is within the outline (see isInOutline()) and not within
+    // half the thickness of a blocking wall. Moving to a neighbouring cell is not possible if
+    // a blocking segment crosses the line between the cell centers.
+    // Floors without outline polygons are walkable within the bounding box of their walls.
+    class WalkableGrid
+    {
+    public:
+        enum CellFlags : uint8_t
+        {
+            Walkable = 1,
+            BlockedEast = 2,    // to cell (x + 1, y)
+            BlockedNorth = 4,   // to cell (x, y + 1)
+            DoorEast = 8,       // the move to (x + 1, y) passes an open door
+            DoorNorth = 16      // the move to (x, y + 1) passes an open door
+        };
+
+        // Move through a door: key is 2 * cell + 1 for north moves, 2 * cell for east moves
+        struct DoorMove
+        {
+            uint64_t key;
+            IndexedSegment door;
+
+            bool operator< (const DoorMove& m) const { return key < m.key; }
+        };
+
+    private:
+        Point2D gridOrigin;
+        float size = 0.25f;
+        uint32_t cellsX = 0;
+        uint32_t cellsY = 0;
+        std::vector<uint8_t> flags;
+
+        // Sorted by key
+        std::vector<DoorMove> doorMoves;
+
+        // Content hash of the source floor (see indoorMapHash.h)
+        Hash128 floorHash;
+
+        // Marks the cells of row y whose center is inside the polygon (even-odd rule, see pointInPolygon())
+        void rasterizeRow(const std::vector<Point2D>& polygon, uint32_t y, std::vector<float>& crossings, std::vector<uint8_t>& inside) const
+        {
+            const float yc = gridOrigin.y + (y + 0.5f) * size;
+
+            crossings.clear();
+            for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+            {
+                const Point2D& a = polygon[i];
+                const Point2D& b = polygon[j];
+                if ((a.y > yc) != (b.y > yc))
+                    crossings.push_back((b.x - a.x) * (yc - a.y) / (b.y - a.y) + a.x);
+            }
+            std::sort(crossings.begin(), crossings.end());
+
+            for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+            {
+                const float from = std::ceil((crossings[k] - gridOrigin.x) / size - 0.5f);
+                const float to = std::ceil((crossings[k + 1] - gridOrigin.x) / size - 0.5f);
+                const int64_t x0 = std::max<int64_t>(0, static_cast<int64_t>(from));
+                const int64_t x1 = std::min<int64_t>(cellsX, static_cast<int64_t>(to));
+                for (int64_t x = x0; x < x1; x++)
+                    inside[x] = 1;
+            }
+        }
+
+    public:
+        WalkableGrid() = default;
+
+        template<typename Filter = DefaultBlocker>
+        explicit WalkableGrid(const Floor& floor, const WalkableGridOptions& options = WalkableGridOptions(), Filter filter = Filter())
+            : size(options.cellSize), floorHash(computeFloorHash(floor).all)
+        {
+            const WallIndex index(floor);
+
+            Point2D minP(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+            Point2D maxP(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+            auto extend = [&](const Point2D& p)
+            {
+                minP = Point2D(std::min(minP.x, p.x), std::min(minP.y, p.y));
+                maxP = Point2D(std::max(maxP.x, p.x), std::max(maxP.y, p.y));
+            };
+
+            bool hasOutline = false;
+            for (const Polygon2D& polygon : floor.outline.polygons)
+            {
+                if (polygon.method != PolygonMethod::Add)
+                    continue;
+                hasOutline = true;
+                for (const Point2D& p : polygon.points)
+                    extend(p);
+            }
+            if (!hasOutline)
+            {
+                for (const IndexedSegment& s : index.segments())
+                {
+                    extend(s.start);
+                    extend(s.end);
+                }
+            }
+            if (minP.x > maxP.x)
+                return;
+
+            gridOrigin = minP;
+            cellsX = static_cast<uint32_t>(std::ceil((maxP.x - minP.x) / size)) + 1;
+            cellsY = static_cast<uint32_t>(std::ceil((maxP.y - minP.y) / size)) + 1;
+            flags.assign(static_cast<size_t>(cellsX) * cellsY, 0);
+
+            float maxHalfThickness = 0.0f;
+            for (const IndexedSegment& s : index.segments())
+                maxHalfThickness = std::max(maxHalfThickness, s.thickness / 2.0f);
+            const float reach = maxHalfThickness + options.clearance;
+
+            // Walkable cells, rows are independent
+            parallelFor(cellsY, options.threadCount, [&](size_t begin, size_t end, size_t)
+            {
+                std::vector<float> crossings;
+                std::vector<uint8_t> added(cellsX);
+                std::vector<uint8_t> removed(cellsX);
+
+                for (uint32_t y = static_cast<uint32_t>(begin); y < end; y++)
+                {
+                    std::fill(added.begin(), added.end(), hasOutline ? 0 : 1);
+                    std::fill(removed.begin(), removed.end(), 0);
+                    for (const Polygon2D& polygon : floor.outline.polygons)
+                    {
+                        if (polygon.points.empty())
+                            continue;
+                        rasterizeRow(polygon.points, y, crossings, polygon.method == PolygonMethod::Add ? added : removed);
+                    }
+
+                    for (uint32_t x = 0; x < cellsX; x++)
+                    {
+                        if (!added[x] || removed[x])
+                            continue;
+
+                        // Too close to a blocking segment
+                        const Point2D c = center(x, y);
+                        bool blocked = false;
+                        index.forEachInBox(c - Point2D(reach, reach), c + Point2D(reach, reach), [&](uint32_t i)
+                        {
+                            const IndexedSegment& s = index.segments()[i];
+                            if (blocked || !filter(s))
+                                return;
+                            const float limit = s.thickness / 2.0f + options.clearance;
+                            blocked = (c - closestPointOnSegment(c, s.start, s.end)).length() < limit;
+                        });
+
+                        if (!blocked)
+                            flags[cellIndex(x, y)] = Walkable;
+                    }
+                }
+            });
+
+            // Blocked moves between walkable cells, collected separately as the rows read their neighbours.
+            // Open doors are recorded, thus runtime door states (see indoorMapDoorState.h) can close them again.
+            auto passableDoor = [&filter](const IndexedSegment& s) { return s.type == WallSegmentType::Door && !filter(s); };
+            std::vector<uint8_t> moveFlags(flags.size(), 0);
+            const size_t threadCount = options.threadCount == 0 ? defaultThreadCount() : options.threadCount;
+            std::vector<std::vector<DoorMove>> threadDoorMoves(threadCount);
+
+            parallelFor(cellsY, threadCount, [&](size_t begin, size_t end, size_t thread)
+            {
+                auto move = [&](size_t i, const Point2D& a, const Point2D& b, bool north)
+                {
+                    if (index.intersects(a, b, filter))
+                    {
+                        moveFlags[i] |= north ? BlockedNorth : BlockedEast;
+                        return;
+                    }
+
+                    float t;
+                    const int door = index.firstHit(a, b, t, passableDoor);
+                    if (door >= 0)
+                    {
+                        moveFlags[i] |= north ? DoorNorth : DoorEast;
+                        threadDoorMoves[thread].push_back(DoorMove{ 2 * static_cast<uint64_t>(i) + (north ? 1 : 0), index.segments()[door] });
+                    }
+                };
+
+                for (uint32_t y = static_cast<uint32_t>(begin); y < end; y++)
+                {
+                    for (uint32_t x = 0; x < cellsX; x++)
+                    {
+                        const size_t i = cellIndex(x, y);
+                        if (!(flags[i] & Walkable))
+                            continue;
+
+                        const Point2D c = center(x, y);
+                        if (x + 1 < cellsX && (flags[i + 1] & Walkable))
+                            move(i, c, center(x + 1, y), false);
+                        if (y + 1 < cellsY && (flags[i + cellsX] & Walkable))
+                            move(i, c, center(x, y + 1), true);
+                    }
+                }
+            });
+
+            for (size_t i = 0; i < flags.size(); i++)
+                flags[i] |= moveFlags[i];
+
+            // Threads process consecutive rows, thus the concatenation is sorted
+            for (const std::vector<DoorMove>& moves : threadDoorMoves)
+                doorMoves.insert(doorMoves.end(), moves.begin(), moves.end());
+        }
+
+        const Point2D& origin() const { return gridOrigin; }
+        float cellSize() const { return size; }
+        uint32_t width() const { return cellsX; }
+        uint32_t height() const { return cellsY; }
+        size_t cellCount() const { return flags.size(); }
+        const Hash128& sourceHash() const { return floorHash; }
+
+        size_t cellIndex(uint32_t x, uint32_t y) const { return static_cast<size_t>(y) * cellsX + x; }
+
+        Point2D center(uint32_t x, uint32_t y) const
+        {
+            return Point2D(gridOrigin.x + (x + 0.5f) * size, gridOrigin.y + (y + 0.5f) * size);
+        }
+
+        Point2D center(size_t index) const
+        {
+            return center(static_cast<uint32_t>(index % cellsX), static_cast<uint32_t>(index / cellsX));
+        }
+
+        // Cell containing p, false if p is outside of the grid
+        bool cellOf(const Point2D& p, uint32_t& x, uint32_t& y) const
+        {
+            const float fx = std::floor((p.x - gridOrigin.x) / size);
+            const float fy = std::floor((p.y - gridOrigin.y) / size);
+            if (!(fx >= 0.0f && fy >= 0.0f && fx < cellsX && fy < cellsY))
+                return false;
+
+            x = static_cast<uint32_t>(fx);
+            y = static_cast<uint32_t>(fy);
+            return true;
+        }
+
+        bool isWalkable(size_t index) const { return flags[index] & Walkable; }
+
+        bool isWalkable(const Point2D& p) const
+        {
+            uint32_t x, y;
+            return cellOf(p, x, y) && isWalkable(cellIndex(x, y));
+        }
+
+        // Calls func(neighbourIndex) for the 4-neighbours reachable from the walkable cell
+        template<typename Func>
+        void forEachNeighbour(size_t index, Func func) const
+        {
+            const uint32_t x = static_cast<uint32_t>(index % cellsX);
+            const uint32_t y = static_cast<uint32_t>(index / cellsX);
+
+            if (x + 1 < cellsX && (flags[index + 1] & Walkable) && !(flags[index] & BlockedEast))
+                func(index + 1);
+            if (x > 0 && (flags[index - 1] & Walkable) && !(flags[index - 1] & BlockedEast))
+                func(index - 1);
+            if (y + 1 < cellsY && (flags[index + cellsX] & Walkable) && !(flags[index] & BlockedNorth))
+                func(index + cellsX);
+            if (y > 0 && (flags[index - cellsX] & Walkable) && !(flags[index - cellsX] & BlockedNorth))
+                func(index - cellsX);
+        }
+
+        const std::vector<uint8_t>& cellFlags() const { return flags; }
+
+        // Door passed by the move from cell index to its east or north neighbour, nullptr if there is none
+        const IndexedSegment* doorOfMove(size_t index, bool north) const
+        {
+            const DoorMove key{ 2 * static_cast<uint64_t>(index) + (north ? 1 : 0), IndexedSegment() };
+            auto it = std::lower_bound(doorMoves.begin(), doorMoves.end(), key);
+            return it != doorMoves.end() && it->key == key.key ? &it->door : nullptr;
+        }
+    };
+
+    constexpr char DistanceFieldMagic[8] = { 'I', 'N', 'D', 'M', 'A', 'P', 'D', 0 };
+    constexpr uint32_t DistanceFieldVersion = 1;
+
+    struct DistanceFieldHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint32_t width;
+        uint32_t height;
+        float originX;
+        float originY;
+        float cellSize;
+        uint32_t padding;
+
+        // Content hash of the floor the grid was built from
+        Hash128 sourceHash;
+    };
+
+    // Walking distance in meters from every cell of a WalkableGrid to the nearest source.
+    // Cells which are not walkable or not reachable are infinite.
+    class DistanceField
+    {
+    private:
+        Point2D gridOrigin;
+        float size = 0.25f;
+        uint32_t cellsX = 0;
+        uint32_t cellsY = 0;
+        Hash128 floorHash;
+        std::vector<float> dist;
+
+        friend class DistanceFieldBuilder;
+
+    public:
+        DistanceField() = default;
+
+        explicit DistanceField(const WalkableGrid& grid)
+            : gridOrigin(grid.origin()), size(grid.cellSize()), cellsX(grid.width()), cellsY(grid.height()),
+              floorHash(grid.sourceHash()), dist(grid.cellCount(), std::numeric_limits<float>::infinity())
+        {
+        }
+
+        const Point2D& origin() const { return gridOrigin; }
+        float cellSize() const { return size; }
+        uint32_t width() const { return cellsX; }
+        uint32_t height() const { return cellsY; }
+        const Hash128& sourceHash() const { return floorHash; }
+        const std::vector<float>& values() const { return dist; }
+
+        float at(size_t index) const { return dist[index]; }
+
+        // Distance at the cell containing p, infinity outside of the grid
+        float at(const Point2D& p) const
+        {
+            const float fx = std::floor((p.x - gridOrigin.x) / size);
+            const float fy = std::floor((p.y - gridOrigin.y) / size);
+            if (!(fx >= 0.0f && fy >= 0.0f && fx < cellsX && fy < cellsY))
+                return std::numeric_limits<float>::infinity();
+
+            return dist[static_cast<size_t>(fy) * cellsX + static_cast<size_t>(fx)];
+        }
+
+        // Binary format: DistanceFieldHeader followed by width * height floats, native byte order.
+        bool saveToFile(const std::string& filename) const
+        {
+            std::ofstream out(filename, std::ios::binary);
+            if (!out.is_open())
+                return false;
+
+            DistanceFieldHeader header{};
+            std::memcpy(header.magic, DistanceFieldMagic, sizeof(header.magic));
+            header.version = DistanceFieldVersion;
+            header.headerSize = sizeof(DistanceFieldHeader);
+            header.width = cellsX;
+            header.height = cellsY;
+            header.originX = gridOrigin.x;
+            header.originY = gridOrigin.y;
+            header.cellSize = size;
+            header.sourceHash = floorHash;
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(dist.data()), static_cast<std::streamsize>(dist.size() * sizeof(float)));
+            return static_cast<bool>(out);
+        }
+
+        // Returns false if the file does not exist or is no valid distance field.
+        // Compare sourceHash() with computeFloorHash(floor).all to detect fields of outdated maps.
+        bool loadFromFile(const std::string& filename)
+        {
+            std::ifstream in(filename, std::ios::binary);
+            if (!in.is_open())
+                return false;
+
+            in.seekg(0, std::ios::end);
+            const std::streamoff fileSize = in.tellg();
+            in.seekg(0, std::ios::beg);
+
+            DistanceFieldHeader header;
+            if (fileSize < static_cast<std::streamoff>(sizeof(header))
+                || !in.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(header.magic, DistanceFieldMagic, sizeof(header.magic)) != 0
+                || header.version != DistanceFieldVersion
+                || header.headerSize != sizeof(DistanceFieldHeader)
+                || !(header.cellSize > 0.0f))
+            {
+                return false;
+            }
+
+            // The header is not trusted, the values must be in the file before they are allocated.
+            // Divisions instead of the product, which can overflow.
+            const uint64_t available = static_cast<uint64_t>(fileSize) - sizeof(header);
+            if (header.width != 0 && header.height > available / sizeof(float) / header.width)
+                return false;
+
+            std::vector<float> values(static_cast<size_t>(header.width) * header.height);
+            if (!in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(float))))
+                return false;
+
+            gridOrigin = Point2D(header.originX, header.originY);
+            size = header.cellSize;
+            cellsX = header.width;
+            cellsY = header.height;
+            floorHash = header.sourceHash;
+            dist = std::move(values);
+            return true;
+        }
+    };
+
+    // Computes distance fields with the fast marching method on the 4-neighbourhood of the grid,
+    // i.e. the distances approximate the Euclidean walking distance instead of a grid metric.
+    // The builder keeps its state, thus repeated computations on the same grid do not allocate.
+    class DistanceFieldBuilder
+    {
+    private:
+        enum : uint8_t { Far, Trial, Known };
+
+        const WalkableGrid* grid;
+        std::vector<uint8_t> state;
+        std::vector<std::pair<float, uint32_t>> heap;
+
+        // Solution of the Eikonal equation at cell i from its known neighbours
+        float solve(const DistanceField& field, size_t i) const
+        {
+            const uint32_t w = grid->width();
+            const float inf = std::numeric_limits<float>::infinity();
+            float a = inf;
+            float b = inf;
+
+            grid->forEachNeighbour(i, [&](size_t n)
+            {
+                if (state[n] != Known)
+                    return;
+                const bool horizontal = n / w == i / w;
+                float& v = horizontal ? a : b;
+                v = std::min(v, field.dist[n]);
+            });
+
+            const float h = grid->cellSize();
+            if (a > b)
+                std::swap(a, b);
+            if (b == inf || b - a >= h)
+                return a + h;
+            return 0.5f * (a + b + std::sqrt(2.0f * h * h - (a - b) * (a - b)));
+        }
+
+    public:
+        explicit DistanceFieldBuilder(const WalkableGrid& grid)
+            : grid(&grid)
+        {
+        }
+
+        // Multi-source field: distance to the nearest source. Sources outside of the walkable area are ignored.
+        void compute(const std::vector<Point2D>& sources, DistanceField& field)
+        {
+            field = DistanceField(*grid);
+            state.assign(grid->cellCount(), Far);
+            heap.clear();
+
+            auto greater = std::greater<std::pair<float, uint32_t>>();
+            for (const Point2D& p : sources)
+            {
+                uint32_t x, y;
+                if (!grid->cellOf(p, x, y) || !grid->isWalkable(grid->cellIndex(x, y)))
+                    continue;
+
+                const size_t i = grid->cellIndex(x, y);
+                const float d = (p - grid->center(x, y)).length();
+                if (d < field.dist[i])
+                {
+                    field.dist[i] = d;
+                    state[i] = Trial;
+                    heap.emplace_back(d, static_cast<uint32_t>(i));
+                    std::push_heap(heap.begin(), heap.end(), greater);
+                }
+            }
+
+            while (!heap.empty())
+            {
+                std::pop_heap(heap.begin(), heap.end(), greater);
+                const auto [d, i] = heap.back();
+                heap.pop_back();
+
+                // Outdated entry
+                if (state[i] == Known || d > field.dist[i])
+                    continue;
+                state[i] = Known;
+
+                grid->forEachNeighbour(i, [&](size_t n)
+                {
+                    if (state[n] == Known)
+                        return;
+
+                    const float nd = solve(field, n);
+                    if (nd < field.dist[n])
+                    {
+                        field.dist[n] = nd;
+                        state[n] = Trial;
+                        heap.emplace_back(nd, static_cast<uint32_t>(n));
+                        std::push_heap(heap.begin(), heap.end(), greater);
+                    }
+                });
+            }
+        }
+
+        DistanceField compute(const std::vector<Point2D>& sources)
+        {
+            DistanceField field;
+            compute(sources, field);
+            return field;
+        }
+    };
+
+    // Computes one field per source set in parallel, e.g. one per room for O(1) "walking distance to room X" lookups.
+    // The marching front itself is sequential, the fields are independent.
+    inline std::vector<DistanceField> computeDistanceFields(const WalkableGrid& grid, const std::vector<std::vector<Point2D>>& sourceSets,
+                                                            size_t threadCount = 0)
+    {
+        std::vector<DistanceField> fields(sourceSets.size());
+        parallelFor(sourceSets.size(), threadCount, [&](size_t begin, size_t end, size_t)
+        {
+            DistanceFieldBuilder builder(grid);
+            for (size_t i = begin; i < end; i++)
+                builder.compute(sourceSets[i], fields[i]);
+        });
+        return fields;
+    }
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapWallIndex.h"
+
+namespace Indoor::Map
+{
+    // Runtime state of a single door.
+    struct DoorState
+    {
+        bool open = true;
+
+        // Additional cost in meters for passing the door, e.g. for slow revolving doors.
+        // The overlay stores negative costs and NaN as 0, graph searches rely on non-negative costs.
+        float cost = 0.0f;
+    };
+
+    // Runtime door states on top of an immutable map, e.g. locked doors or closed fire doors.
+    // Every wall door and door obstacle has a dense id. States are stored in one atomic word per door,
+    // thus updates are lock-free and never block readers. Every update increments the epoch, readers
+    // caching derived data (routes, visibility) compare epochs to detect changes.
+    // The overlay only depends on the number of doors per wall and floor, indices need not be rebuilt.
+    class DoorStateOverlay
+    {
+    private:
+        // Door ids of floor f: wall doors first, then door obstacles
+        std::vector<uint32_t> floorBase;
+
+        // First door id of every wall, walls of all floors concatenated
+        std::vector<uint32_t> wallBase;
+        std::vector<uint32_t> floorWallBase;
+
+        std::vector<uint32_t> obstacleBase;
+
+        uint32_t count = 0;
+        std::unique_ptr<std::atomic<uint64_t>[]> states;
+        std::atomic<uint64_t> currentEpoch{ 0 };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "door states require lock-free 64 bit atomics");
+
+        // Low 32 bits: cost as float bits, bit 32: closed. Negative costs and NaN become 0.
+        static uint64_t pack(const DoorState& state)
+        {
+            const float cost = state.cost > 0.0f ? state.cost : 0.0f;
+            uint32_t bits;
+            std::memcpy(&bits, &cost, sizeof(bits));
+            return static_cast<uint64_t>(bits) | (state.open ? 0 : (uint64_t(1) << 32));
+        }
+
+        static DoorState unpack(uint64_t word)
+        {
+            DoorState state;
+            const uint32_t bits = static_cast<uint32_t>(word);
+            std::memcpy(&state.cost, &bits, sizeof(bits));
+            state.open = (word >> 32) == 0;
+            return state;
+        }
+
+    public:
+        explicit DoorStateOverlay(const Map& map)
+        {
+            for (const Floor& floor : map.floors)
+            {
+                floorBase.push_back(count);
+                floorWallBase.push_back(static_cast<uint32_t>(wallBase.size()));
+                for (const Wall& wall : floor.walls)
+                {
+                    wallBase.push_back(count);
+                    count += static_cast<uint32_t>(wall.doors.size());
+                }
+                obstacleBase.push_back(count);
+                count += static_cast<uint32_t>(floor.doorObstacles.size());
+            }
+            floorBase.push_back(count);
+
+            states.reset(new std::atomic<uint64_t>[count]);
+            for (uint32_t i = 0; i < count; i++)
+                states[i].store(pack(DoorState()), std::memory_order_relaxed);
+        }
+
+        size_t size() const { return count; }
+
+        // Door ids of a floor are [floorBegin(f), floorEnd(f))
+        uint32_t floorBegin(size_t floor) const { return floorBase[floor]; }
+        uint32_t floorEnd(size_t floor) const { return floorBase[floor + 1]; }
+
+        uint32_t wallDoorId(size_t floor, size_t wall, size_t door) const { return wallBase[floorWallBase[floor] + wall] + static_cast<uint32_t>(door); }
+        uint32_t doorObstacleId(size_t floor, size_t door) const { return obstacleBase[floor] + static_cast<uint32_t>(door); }
+
+        // Id of a door segment of a WallIndex built from the given floor, or -1 if it is no door
+        int64_t doorId(size_t floor, const IndexedSegment& seg) const
+        {
+            if (seg.type != WallSegmentType::Door)
+                return -1;
+            if (seg.source == SegmentSource::DoorObstacle)
+                return doorObstacleId(floor, seg.element);
+            if (seg.source == SegmentSource::Wall && seg.listIndex >= 0)
+                return wallDoorId(floor, seg.element, static_cast<size_t>(seg.listIndex));
+            return -1;
+        }
+
+        DoorState get(uint32_t id) const
+        {
+            return unpack(states[id].load(std::memory_order_acquire));
+        }
+
+        bool isOpen(uint32_t id) const { return get(id).open; }
+
+        // Cost of passing the door, infinity if it is closed
+        float cost(uint32_t id) const
+        {
+            const DoorState state = get(id);
+            return state.open ? state.cost : std::numeric_limits<float>::infinity();
+        }
+
+        void set(uint32_t id, const DoorState& state)
+        {
+            states[id].store(pack(state), std::memory_order_release);
+            currentEpoch.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        void setOpen(uint32_t id, bool open)
+        {
+            uint64_t word = states[id].load(std::memory_order_relaxed);
+            DoorState state;
+            do
+            {
+                state = unpack(word);
+                state.open = open;
+            } while (!states[id].compare_exchange_weak(word, pack(state), std::memory_order_release, std::memory_order_relaxed));
+            currentEpoch.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        void setCost(uint32_t id, float cost)
+        {
+            uint64_t word = states[id].load(std::memory_order_relaxed);
+            DoorState state;
+            do
+            {
+                state = unpack(word);
+                state.cost = cost;
+            } while (!states[id].compare_exchange_weak(word, pack(state), std::memory_order_release, std::memory_order_relaxed));
+            currentEpoch.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+        // Incremented by every update. A reader which sees epoch e also sees all updates made before e was published.
+        uint64_t epoch() const { return currentEpoch.load(std::memory_order_acquire); }
+    };
+
+    // WallIndex filter: walls and windows block, doors only if the overlay marks them closed.
+    struct DoorStateBlocker
+    {
+        const DoorStateOverlay* overlay;
+
+        // Floor the WallIndex was built from
+        size_t floor;
+
+        bool operator()(const IndexedSegment& seg) const
+        {
+            if (seg.type != WallSegmentType::Door)
+                return true;
+
+            const int64_t id = overlay->doorId(floor, seg);
+            return id >= 0 && !overlay->isOpen(static_cast<uint32_t>(id));
+        }
+    };
+}
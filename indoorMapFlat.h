@@ -0,0 +1,864 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapHash.h"
+
+namespace Indoor::Map
+{
+    // Flat, pointer-free representation of a Map.
+    // All data is stored in one contiguous buffer and referenced by offsets, thus the buffer can be
+    // memory mapped by other processes (see indoorMapSharedMemory.h) or written to disk as is.
+    // Every floor references ranges of global element arrays, every wall ranges of the door, window and segment arrays.
+
+    constexpr char FlatMapMagic[8] = { 'I', 'N', 'D', 'M', 'A', 'P', 'F', 0 };
+    constexpr uint32_t FlatMapVersion = 2;
+
+    // Range of a global element array
+    struct FlatRange
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // Reference into the string table. The string is additionally zero terminated.
+    struct FlatString
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // Byte offset and element count of an array within the buffer
+    struct FlatArray
+    {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct FlatPoint
+    {
+        float x, y;
+    };
+
+    struct FlatPolygon
+    {
+        FlatString name;
+        int32_t method;
+        uint32_t isOutdoor;
+        FlatRange points;
+    };
+
+    struct FlatDoor
+    {
+        int32_t material;
+        float width, height, atLinePos;
+        int32_t type;
+        uint8_t leftRight;
+        uint8_t inOut;
+        uint8_t padding[2];
+    };
+
+    struct FlatWindow
+    {
+        int32_t material;
+        float width, height, atLinePos;
+        float atHeigth;
+        uint8_t inOut;
+        uint8_t padding[3];
+    };
+
+    struct FlatWallSegment
+    {
+        int32_t listIndex;
+        int32_t type;
+        FlatPoint start;
+        FlatPoint end;
+    };
+
+    struct FlatWall
+    {
+        int32_t material;
+        int32_t type;
+        float x1, y1, x2, y2;
+        float thickness;
+        float height;
+        FlatRange doors;
+        FlatRange windows;
+        FlatRange segments;
+    };
+
+    struct FlatLineObstacle
+    {
+        int32_t material;
+        int32_t type;
+        float x1, y1, x2, y2;
+        float thickness;
+        float height;
+    };
+
+    struct FlatCircleObstacle
+    {
+        int32_t material;
+        float cx, cy;
+        float radius;
+        float height;
+    };
+
+    struct FlatDoorObstacle
+    {
+        int32_t type;
+        int32_t material;
+        float x1, y1, x2, y2;
+        float height;
+        uint8_t swap;
+        uint8_t padding[3];
+    };
+
+    // The footprint references the global point array
+    struct FlatObjectObstacle
+    {
+        FlatString file;
+        float x, y, z;
+        float rx, ry, rz;
+        float sx, sy, sz;
+        FlatRange footprint;
+    };
+
+    struct FlatAccessPoint
+    {
+        FlatString name;
+        FlatString macAddress;
+        float x, y, z, heightAboveFloor;
+        float mdl_txp, mdl_exp, mdl_waf;
+    };
+
+    struct FlatBeacon
+    {
+        FlatString name;
+        FlatString macAddress;
+        FlatString uuid;
+        FlatString major;
+        FlatString minor;
+        float x, y, z, heightAboveFloor;
+        float mdl_txp, mdl_exp, mdl_waf;
+    };
+
+    struct FlatGroundtruthPoint
+    {
+        int32_t id;
+        float x, y, z, heightAboveFloor;
+    };
+
+    struct FlatFingerprintLocation
+    {
+        FlatString name;
+        float x, y, z, heightAboveFloor;
+    };
+
+    struct FlatPointOfInterest
+    {
+        FlatString name;
+        int32_t type;
+        float x, y;
+    };
+
+    struct FlatEarthPosMapPos
+    {
+        float lat, lon, alt;
+        float x, y, z;
+    };
+
+    struct FlatFloor
+    {
+        float atHeight;
+        float height;
+        FlatString name;
+
+        FlatRange polygons;
+        FlatRange walls;
+        FlatRange lineObstacles;
+        FlatRange circleObstacles;
+        FlatRange doorObstacles;
+        FlatRange objectObstacles;
+        FlatRange accessPoints;
+        FlatRange beacons;
+        FlatRange groundtruthPoints;
+        FlatRange fingerprintLocations;
+        FlatRange pois;
+    };
+
+    struct FlatMapHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+
+        // Size of the whole buffer including this header
+        uint64_t totalSize;
+
+        // Set by the publisher, e.g. to detect updates of a shared memory segment
+        uint64_t generation;
+
+        // Content hash of the source map (see indoorMapHash.h)
+        Hash128 contentHash;
+
+        float width;
+        float depth;
+
+        FlatArray earthRegistration;
+        FlatArray floors;
+        FlatArray polygons;
+        FlatArray points;
+        FlatArray walls;
+        FlatArray doors;
+        FlatArray windows;
+        FlatArray segments;
+        FlatArray lineObstacles;
+        FlatArray circleObstacles;
+        FlatArray doorObstacles;
+        FlatArray objectObstacles;
+        FlatArray accessPoints;
+        FlatArray beacons;
+        FlatArray groundtruthPoints;
+        FlatArray fingerprintLocations;
+        FlatArray pois;
+        FlatArray strings;
+    };
+
+    // Read-only array view into the buffer
+    template<typename T>
+    struct FlatSpan
+    {
+        const T* data = nullptr;
+        size_t count = 0;
+
+        const T* begin() const { return data; }
+        const T* end() const { return data + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        const T& operator[](size_t i) const { return data[i]; }
+    };
+
+    // Converts a Map into the flat representation.
+    class FlatMapBuilder
+    {
+    private:
+        std::vector<FlatEarthPosMapPos> earthRegistration;
+        std::vector<FlatFloor> floors;
+        std::vector<FlatPolygon> polygons;
+        std::vector<FlatPoint> points;
+        std::vector<FlatWall> walls;
+        std::vector<FlatDoor> doors;
+        std::vector<FlatWindow> windows;
+        std::vector<FlatWallSegment> segments;
+        std::vector<FlatLineObstacle> lineObstacles;
+        std::vector<FlatCircleObstacle> circleObstacles;
+        std::vector<FlatDoorObstacle> doorObstacles;
+        std::vector<FlatObjectObstacle> objectObstacles;
+        std::vector<FlatAccessPoint> accessPoints;
+        std::vector<FlatBeacon> beacons;
+        std::vector<FlatGroundtruthPoint> groundtruthPoints;
+        std::vector<FlatFingerprintLocation> fingerprintLocations;
+        std::vector<FlatPointOfInterest> pois;
+        std::vector<char> strings;
+
+        FlatMapHeader header = {};
+
+        FlatString addString(const std::string& str)
+        {
+            FlatString fs;
+            fs.offset = static_cast<uint32_t>(strings.size());
+            fs.length = static_cast<uint32_t>(str.size());
+            strings.insert(strings.end(), str.begin(), str.end());
+            strings.push_back('\0');
+            return fs;
+        }
+
+        template<typename T>
+        static FlatRange rangeFrom(const std::vector<T>& elements, size_t first)
+        {
+            return FlatRange{ static_cast<uint32_t>(first), static_cast<uint32_t>(elements.size() - first) };
+        }
+
+        static constexpr uint64_t align(uint64_t offset)
+        {
+            return (offset + 7) & ~uint64_t(7);
+        }
+
+        template<typename T>
+        void layout(FlatArray& array, const std::vector<T>& elements, uint64_t& offset) const
+        {
+            offset = align(offset);
+            array.offset = offset;
+            array.count = elements.size();
+            offset += elements.size() * sizeof(T);
+        }
+
+        template<typename T>
+        static void copy(char* dst, const FlatArray& array, const std::vector<T>& elements)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "flat elements must be trivially copyable");
+            if (!elements.empty())
+                std::memcpy(dst + array.offset, elements.data(), elements.size() * sizeof(T));
+        }
+
+        void addFloor(const Floor& floor)
+        {
+            FlatFloor ff = {};
+            ff.atHeight = floor.atHeight;
+            ff.height = floor.height;
+            ff.name = addString(floor.name);
+
+            size_t first = polygons.size();
+            for (const Polygon2D& polygon : floor.outline.polygons)
+            {
+                FlatPolygon fp = {};
+                fp.name = addString(polygon.name);
+                fp.method = static_cast<int32_t>(polygon.method);
+                fp.isOutdoor = polygon.isOutdoor ? 1 : 0;
+
+                const size_t firstPoint = points.size();
+                for (const Point2D& p : polygon.points)
+                    points.push_back(FlatPoint{ p.x, p.y });
+                fp.points = rangeFrom(points, firstPoint);
+
+                polygons.push_back(fp);
+            }
+            ff.polygons = rangeFrom(polygons, first);
+
+            first = walls.size();
+            for (const Wall& wall : floor.walls)
+            {
+                FlatWall fw = {};
+                fw.material = static_cast<int32_t>(wall.material);
+                fw.type = static_cast<int32_t>(wall.type);
+                fw.x1 = wall.x1;
+                fw.y1 = wall.y1;
+                fw.x2 = wall.x2;
+                fw.y2 = wall.y2;
+                fw.thickness = wall.thickness;
+                fw.height = wall.height;
+
+                size_t firstElement = doors.size();
+                for (const WallDoor& door : wall.doors)
+                {
+                    FlatDoor fd = {};
+                    fd.material = static_cast<int32_t>(door.material);
+                    fd.width = door.width;
+                    fd.height = door.height;
+                    fd.atLinePos = door.atLinePos;
+                    fd.type = static_cast<int32_t>(door.type);
+                    fd.leftRight = door.leftRight ? 1 : 0;
+                    fd.inOut = door.inOut ? 1 : 0;
+                    doors.push_back(fd);
+                }
+                fw.doors = rangeFrom(doors, firstElement);
+
+                firstElement = windows.size();
+                for (const WallWindow& window : wall.windows)
+                {
+                    FlatWindow fwin = {};
+                    fwin.material = static_cast<int32_t>(window.material);
+                    fwin.width = window.width;
+                    fwin.height = window.height;
+                    fwin.atLinePos = window.atLinePos;
+                    fwin.atHeigth = window.atHeigth;
+                    fwin.inOut = window.inOut ? 1 : 0;
+                    windows.push_back(fwin);
+                }
+                fw.windows = rangeFrom(windows, firstElement);
+
+                firstElement = segments.size();
+                for (const WallSegment2D& seg : wall.segments)
+                {
+                    segments.push_back(FlatWallSegment{ seg.listIndex, static_cast<int32_t>(seg.type),
+                                                        FlatPoint{ seg.start.x, seg.start.y }, FlatPoint{ seg.end.x, seg.end.y } });
+                }
+                fw.segments = rangeFrom(segments, firstElement);
+
+                walls.push_back(fw);
+            }
+            ff.walls = rangeFrom(walls, first);
+
+            first = lineObstacles.size();
+            for (const LineObstacle& line : floor.lineObstacles)
+            {
+                lineObstacles.push_back(FlatLineObstacle{ static_cast<int32_t>(line.material), static_cast<int32_t>(line.type),
+                                                          line.x1, line.y1, line.x2, line.y2, line.thickness, line.height });
+            }
+            ff.lineObstacles = rangeFrom(lineObstacles, first);
+
+            first = circleObstacles.size();
+            for (const CircleObstacle& circle : floor.circleObstacles)
+            {
+                circleObstacles.push_back(FlatCircleObstacle{ static_cast<int32_t>(circle.material), circle.cx, circle.cy, circle.radius, circle.height });
+            }
+            ff.circleObstacles = rangeFrom(circleObstacles, first);
+
+            first = doorObstacles.size();
+            for (const DoorObstacle& door : floor.doorObstacles)
+            {
+                FlatDoorObstacle fd = {};
+                fd.type = static_cast<int32_t>(door.type);
+                fd.material = static_cast<int32_t>(door.material);
+                fd.x1 = door.x1;
+                fd.y1 = door.y1;
+                fd.x2 = door.x2;
+                fd.y2 = door.y2;
+                fd.height = door.height;
+                fd.swap = door.swap ? 1 : 0;
+                doorObstacles.push_back(fd);
+            }
+            ff.doorObstacles = rangeFrom(doorObstacles, first);
+
+            first = objectObstacles.size();
+            for (const ObjectObstacle& object : floor.objectObstacles)
+            {
+                const size_t firstPoint = points.size();
+                for (const Point2D& p : object.footprint)
+                    points.push_back(FlatPoint{ p.x, p.y });
+
+                objectObstacles.push_back(FlatObjectObstacle{ addString(object.file), object.x, object.y, object.z,
+                                                              object.rx, object.ry, object.rz, object.sx, object.sy, object.sz,
+                                                              rangeFrom(points, firstPoint) });
+            }
+            ff.objectObstacles = rangeFrom(objectObstacles, first);
+
+            first = accessPoints.size();
+            for (const AccessPoint& ap : floor.accessPoints)
+            {
+                accessPoints.push_back(FlatAccessPoint{ addString(ap.name), addString(ap.macAddress),
+                                                        ap.x, ap.y, ap.z, ap.heightAboveFloor,
+                                                        ap.mdl_txp, ap.mdl_exp, ap.mdl_waf });
+            }
+            ff.accessPoints = rangeFrom(accessPoints, first);
+
+            first = beacons.size();
+            for (const Beacon& b : floor.beacons)
+            {
+                beacons.push_back(FlatBeacon{ addString(b.name), addString(b.macAddress), addString(b.uuid),
+                                              addString(b.major), addString(b.minor),
+                                              b.x, b.y, b.z, b.heightAboveFloor,
+                                              b.mdl_txp, b.mdl_exp, b.mdl_waf });
+            }
+            ff.beacons = rangeFrom(beacons, first);
+
+            first = groundtruthPoints.size();
+            for (const GroundtruthPoint& gt : floor.groundtruthPoints)
+            {
+                groundtruthPoints.push_back(FlatGroundtruthPoint{ gt.id, gt.x, gt.y, gt.z, gt.heightAboveFloor });
+            }
+            ff.groundtruthPoints = rangeFrom(groundtruthPoints, first);
+
+            first = fingerprintLocations.size();
+            for (const FingerprintLocation& fl : floor.fingerprintLocations)
+            {
+                fingerprintLocations.push_back(FlatFingerprintLocation{ addString(fl.name), fl.x, fl.y, fl.z, fl.heightAboveFloor });
+            }
+            ff.fingerprintLocations = rangeFrom(fingerprintLocations, first);
+
+            first = pois.size();
+            for (const PointOfInterest& poi : floor.pois)
+            {
+                pois.push_back(FlatPointOfInterest{ addString(poi.name), static_cast<int32_t>(poi.type), poi.x, poi.y });
+            }
+            ff.pois = rangeFrom(pois, first);
+
+            floors.push_back(ff);
+        }
+
+    public:
+        explicit FlatMapBuilder(const Map& map, uint64_t generation = 0)
+        {
+            std::memcpy(header.magic, FlatMapMagic, sizeof(header.magic));
+            header.version = FlatMapVersion;
+            header.headerSize = sizeof(FlatMapHeader);
+            header.generation = generation;
+            header.contentHash = contentHash(map).all;
+            header.width = map.width;
+            header.depth = map.depth;
+
+            for (const EarthPosMapPos& pos : map.earthRegistration.correspondences)
+            {
+                earthRegistration.push_back(FlatEarthPosMapPos{ pos.lat, pos.lon, pos.alt, pos.x, pos.y, pos.z });
+            }
+
+            for (const Floor& floor : map.floors)
+            {
+                addFloor(floor);
+            }
+
+            uint64_t offset = sizeof(FlatMapHeader);
+            layout(header.earthRegistration, earthRegistration, offset);
+            layout(header.floors, floors, offset);
+            layout(header.polygons, polygons, offset);
+            layout(header.points, points, offset);
+            layout(header.walls, walls, offset);
+            layout(header.doors, doors, offset);
+            layout(header.windows, windows, offset);
+            layout(header.segments, segments, offset);
+            layout(header.lineObstacles, lineObstacles, offset);
+            layout(header.circleObstacles, circleObstacles, offset);
+            layout(header.doorObstacles, doorObstacles, offset);
+            layout(header.objectObstacles, objectObstacles, offset);
+            layout(header.accessPoints, accessPoints, offset);
+            layout(header.beacons, beacons, offset);
+            layout(header.groundtruthPoints, groundtruthPoints, offset);
+            layout(header.fingerprintLocations, fingerprintLocations, offset);
+            layout(header.pois, pois, offset);
+            layout(header.strings, strings, offset);
+            header.totalSize = align(offset);
+        }
+
+        // Number of bytes required by writeTo()
+        size_t size() const
+        {
+            return static_cast<size_t>(header.totalSize);
+        }
+
+        // Writes the flat map to dst which must provide size() bytes and be 8 byte aligned.
+        // The header is written last, i.e. readers polling the magic never see a partially written map.
+        void writeTo(void* dst) const
+        {
+            char* bytes = static_cast<char*>(dst);
+            std::memset(bytes, 0, size());
+
+            copy(bytes, header.earthRegistration, earthRegistration);
+            copy(bytes, header.floors, floors);
+            copy(bytes, header.polygons, polygons);
+            copy(bytes, header.points, points);
+            copy(bytes, header.walls, walls);
+            copy(bytes, header.doors, doors);
+            copy(bytes, header.windows, windows);
+            copy(bytes, header.segments, segments);
+            copy(bytes, header.lineObstacles, lineObstacles);
+            copy(bytes, header.circleObstacles, circleObstacles);
+            copy(bytes, header.doorObstacles, doorObstacles);
+            copy(bytes, header.objectObstacles, objectObstacles);
+            copy(bytes, header.accessPoints, accessPoints);
+            copy(bytes, header.beacons, beacons);
+            copy(bytes, header.groundtruthPoints, groundtruthPoints);
+            copy(bytes, header.fingerprintLocations, fingerprintLocations);
+            copy(bytes, header.pois, pois);
+            copy(bytes, header.strings, strings);
+
+            std::memcpy(bytes, &header, sizeof(header));
+        }
+
+        std::vector<uint64_t> build() const
+        {
+            // uint64_t guarantees the alignment
+            std::vector<uint64_t> buffer(size() / sizeof(uint64_t));
+            writeTo(buffer.data());
+            return buffer;
+        }
+    };
+
+    // Read-only, zero-copy access to a flat map buffer.
+    class FlatMapView
+    {
+    private:
+        const char* bytes = nullptr;
+        const FlatMapHeader* hdr = nullptr;
+
+        template<typename T>
+        FlatSpan<T> array(const FlatArray& a) const
+        {
+            return FlatSpan<T>{ reinterpret_cast<const T*>(bytes + a.offset), static_cast<size_t>(a.count) };
+        }
+
+        template<typename T>
+        static FlatSpan<T> sub(const FlatSpan<T>& all, const FlatRange& range)
+        {
+            return FlatSpan<T>{ all.data + range.first, range.count };
+        }
+
+        template<typename T>
+        static bool arrayValid(const FlatArray& a, uint64_t size)
+        {
+            return a.offset % alignof(T) == 0 && a.offset <= size && a.count <= (size - a.offset) / sizeof(T);
+        }
+
+        static bool rangeValid(const FlatRange& r, uint64_t count)
+        {
+            return static_cast<uint64_t>(r.first) + r.count <= count;
+        }
+
+        bool stringValid(const FlatString& s) const
+        {
+            return static_cast<uint64_t>(s.offset) + s.length < hdr->strings.count && bytes[hdr->strings.offset + s.offset + s.length] == '\0';
+        }
+
+        // Checks all offsets, thus a corrupt or malicious buffer can not cause out of bound reads.
+        bool validate(size_t size) const
+        {
+            const FlatMapHeader& h = *hdr;
+            if (size < sizeof(FlatMapHeader)
+                || std::memcmp(h.magic, FlatMapMagic, sizeof(h.magic)) != 0
+                || h.version != FlatMapVersion
+                || h.headerSize != sizeof(FlatMapHeader)
+                || h.totalSize > size)
+            {
+                return false;
+            }
+
+            const uint64_t total = h.totalSize;
+            if (!arrayValid<FlatEarthPosMapPos>(h.earthRegistration, total) || !arrayValid<FlatFloor>(h.floors, total)
+                || !arrayValid<FlatPolygon>(h.polygons, total) || !arrayValid<FlatPoint>(h.points, total)
+                || !arrayValid<FlatWall>(h.walls, total) || !arrayValid<FlatDoor>(h.doors, total)
+                || !arrayValid<FlatWindow>(h.windows, total) || !arrayValid<FlatWallSegment>(h.segments, total)
+                || !arrayValid<FlatLineObstacle>(h.lineObstacles, total) || !arrayValid<FlatCircleObstacle>(h.circleObstacles, total)
+                || !arrayValid<FlatDoorObstacle>(h.doorObstacles, total) || !arrayValid<FlatObjectObstacle>(h.objectObstacles, total)
+                || !arrayValid<FlatAccessPoint>(h.accessPoints, total) || !arrayValid<FlatBeacon>(h.beacons, total)
+                || !arrayValid<FlatGroundtruthPoint>(h.groundtruthPoints, total)
+                || !arrayValid<FlatFingerprintLocation>(h.fingerprintLocations, total)
+                || !arrayValid<FlatPointOfInterest>(h.pois, total) || !arrayValid<char>(h.strings, total))
+            {
+                return false;
+            }
+
+            for (const FlatFloor& f : floors())
+            {
+                if (!stringValid(f.name) || !rangeValid(f.polygons, h.polygons.count) || !rangeValid(f.walls, h.walls.count)
+                    || !rangeValid(f.lineObstacles, h.lineObstacles.count) || !rangeValid(f.circleObstacles, h.circleObstacles.count)
+                    || !rangeValid(f.doorObstacles, h.doorObstacles.count) || !rangeValid(f.objectObstacles, h.objectObstacles.count)
+                    || !rangeValid(f.accessPoints, h.accessPoints.count) || !rangeValid(f.beacons, h.beacons.count)
+                    || !rangeValid(f.groundtruthPoints, h.groundtruthPoints.count)
+                    || !rangeValid(f.fingerprintLocations, h.fingerprintLocations.count) || !rangeValid(f.pois, h.pois.count))
+                {
+                    return false;
+                }
+            }
+
+            for (const FlatPolygon& p : array<FlatPolygon>(h.polygons))
+            {
+                if (!stringValid(p.name) || !rangeValid(p.points, h.points.count))
+                    return false;
+            }
+
+            for (const FlatWall& w : array<FlatWall>(h.walls))
+            {
+                if (!rangeValid(w.doors, h.doors.count) || !rangeValid(w.windows, h.windows.count) || !rangeValid(w.segments, h.segments.count))
+                    return false;
+            }
+
+            for (const FlatObjectObstacle& o : array<FlatObjectObstacle>(h.objectObstacles))
+            {
+                if (!stringValid(o.file) || !rangeValid(o.footprint, h.points.count))
+                    return false;
+            }
+
+            for (const FlatAccessPoint& ap : array<FlatAccessPoint>(h.accessPoints))
+            {
+                if (!stringValid(ap.name) || !stringValid(ap.macAddress))
+                    return false;
+            }
+
+            for (const FlatBeacon& b : array<FlatBeacon>(h.beacons))
+            {
+                if (!stringValid(b.name) || !stringValid(b.macAddress) || !stringValid(b.uuid) || !stringValid(b.major) || !stringValid(b.minor))
+                    return false;
+            }
+
+            for (const FlatFingerprintLocation& fl : array<FlatFingerprintLocation>(h.fingerprintLocations))
+            {
+                if (!stringValid(fl.name))
+                    return false;
+            }
+
+            for (const FlatPointOfInterest& poi : array<FlatPointOfInterest>(h.pois))
+            {
+                if (!stringValid(poi.name))
+                    return false;
+            }
+
+            return true;
+        }
+
+    public:
+        FlatMapView() = default;
+
+        // The buffer must stay valid while the view is used. valid() is false if the buffer is not a flat map.
+        FlatMapView(const void* data, size_t size)
+            : bytes(static_cast<const char*>(data)), hdr(static_cast<const FlatMapHeader*>(data))
+        {
+            if (!data || !validate(size))
+            {
+                bytes = nullptr;
+                hdr = nullptr;
+            }
+        }
+
+        bool valid() const { return hdr != nullptr; }
+
+        const FlatMapHeader& header() const { return *hdr; }
+
+        std::string_view string(const FlatString& s) const
+        {
+            return std::string_view(bytes + hdr->strings.offset + s.offset, s.length);
+        }
+
+        FlatSpan<FlatEarthPosMapPos> earthRegistration() const { return array<FlatEarthPosMapPos>(hdr->earthRegistration); }
+        FlatSpan<FlatFloor> floors() const { return array<FlatFloor>(hdr->floors); }
+
+        FlatSpan<FlatPolygon> polygons(const FlatFloor& f) const { return sub(array<FlatPolygon>(hdr->polygons), f.polygons); }
+        FlatSpan<FlatPoint> points(const FlatPolygon& p) const { return sub(array<FlatPoint>(hdr->points), p.points); }
+        FlatSpan<FlatWall> walls(const FlatFloor& f) const { return sub(array<FlatWall>(hdr->walls), f.walls); }
+        FlatSpan<FlatDoor> doors(const FlatWall& w) const { return sub(array<FlatDoor>(hdr->doors), w.doors); }
+        FlatSpan<FlatWindow> windows(const FlatWall& w) const { return sub(array<FlatWindow>(hdr->windows), w.windows); }
+        FlatSpan<FlatWallSegment> segments(const FlatWall& w) const { return sub(array<FlatWallSegment>(hdr->segments), w.segments); }
+        FlatSpan<FlatLineObstacle> lineObstacles(const FlatFloor& f) const { return sub(array<FlatLineObstacle>(hdr->lineObstacles), f.lineObstacles); }
+        FlatSpan<FlatCircleObstacle> circleObstacles(const FlatFloor& f) const { return sub(array<FlatCircleObstacle>(hdr->circleObstacles), f.circleObstacles); }
+        FlatSpan<FlatDoorObstacle> doorObstacles(const FlatFloor& f) const { return sub(array<FlatDoorObstacle>(hdr->doorObstacles), f.doorObstacles); }
+        FlatSpan<FlatObjectObstacle> objectObstacles(const FlatFloor& f) const { return sub(array<FlatObjectObstacle>(hdr->objectObstacles), f.objectObstacles); }
+        FlatSpan<FlatPoint> footprint(const FlatObjectObstacle& o) const { return sub(array<FlatPoint>(hdr->points), o.footprint); }
+        FlatSpan<FlatAccessPoint> accessPoints(const FlatFloor& f) const { return sub(array<FlatAccessPoint>(hdr->accessPoints), f.accessPoints); }
+        FlatSpan<FlatBeacon> beacons(const FlatFloor& f) const { return sub(array<FlatBeacon>(hdr->beacons), f.beacons); }
+        FlatSpan<FlatGroundtruthPoint> groundtruthPoints(const FlatFloor& f) const { return sub(array<FlatGroundtruthPoint>(hdr->groundtruthPoints), f.groundtruthPoints); }
+        FlatSpan<FlatFingerprintLocation> fingerprintLocations(const FlatFloor& f) const { return sub(array<FlatFingerprintLocation>(hdr->fingerprintLocations), f.fingerprintLocations); }
+        FlatSpan<FlatPointOfInterest> pois(const FlatFloor& f) const { return sub(array<FlatPointOfInterest>(hdr->pois), f.pois); }
+
+        // Creates a regular Map object from the flat representation.
+        Map toMap() const
+        {
+            Map map;
+            map.width = hdr->width;
+            map.depth = hdr->depth;
+
+            for (const FlatEarthPosMapPos& pos : earthRegistration())
+            {
+                map.earthRegistration.correspondences.push_back(EarthPosMapPos{ pos.lat, pos.lon, pos.alt, pos.x, pos.y, pos.z });
+            }
+
+            for (const FlatFloor& ff : floors())
+            {
+                Floor floor;
+                floor.atHeight = ff.atHeight;
+                floor.height = ff.height;
+                floor.name = std::string(string(ff.name));
+
+                for (const FlatPolygon& fp : polygons(ff))
+                {
+                    Polygon2D polygon;
+                    polygon.name = std::string(string(fp.name));
+                    polygon.method = static_cast<PolygonMethod>(fp.method);
+                    polygon.isOutdoor = fp.isOutdoor != 0;
+                    for (const FlatPoint& p : points(fp))
+                        polygon.points.push_back(Point2D(p.x, p.y));
+                    floor.outline.polygons.push_back(polygon);
+                }
+
+                for (const FlatWall& fw : walls(ff))
+                {
+                    Wall wall;
+                    wall.material = static_cast<WallMaterial>(fw.material);
+                    wall.type = static_cast<ObstacleType>(fw.type);
+                    wall.x1 = fw.x1;
+                    wall.y1 = fw.y1;
+                    wall.x2 = fw.x2;
+                    wall.y2 = fw.y2;
+                    wall.thickness = fw.thickness;
+                    wall.height = fw.height;
+
+                    for (const FlatDoor& fd : doors(fw))
+                    {
+                        WallDoor door;
+                        door.material = static_cast<WallMaterial>(fd.material);
+                        door.width = fd.width;
+                        door.height = fd.height;
+                        door.atLinePos = fd.atLinePos;
+                        door.type = static_cast<DoorType>(fd.type);
+                        door.leftRight = fd.leftRight != 0;
+                        door.inOut = fd.inOut != 0;
+                        wall.doors.push_back(door);
+                    }
+
+                    for (const FlatWindow& fwin : windows(fw))
+                    {
+                        WallWindow window;
+                        window.material = static_cast<WallMaterial>(fwin.material);
+                        window.width = fwin.width;
+                        window.height = fwin.height;
+                        window.atLinePos = fwin.atLinePos;
+                        window.atHeigth = fwin.atHeigth;
+                        window.inOut = fwin.inOut != 0;
+                        wall.windows.push_back(window);
+                    }
+
+                    for (const FlatWallSegment& fs : segments(fw))
+                    {
+                        wall.segments.push_back(WallSegment2D(static_cast<WallSegmentType>(fs.type), fs.listIndex,
+                                                              Point2D(fs.start.x, fs.start.y), Point2D(fs.end.x, fs.end.y)));
+                    }
+
+                    floor.walls.push_back(wall);
+                }
+
+                for (const FlatLineObstacle& fl : lineObstacles(ff))
+                {
+                    floor.lineObstacles.push_back(LineObstacle{ static_cast<WallMaterial>(fl.material), static_cast<ObstacleType>(fl.type),
+                                                                fl.x1, fl.y1, fl.x2, fl.y2, fl.thickness, fl.height });
+                }
+
+                for (const FlatCircleObstacle& fc : circleObstacles(ff))
+                {
+                    floor.circleObstacles.push_back(CircleObstacle{ static_cast<WallMaterial>(fc.material), fc.cx, fc.cy, fc.radius, fc.height });
+                }
+
+                for (const FlatDoorObstacle& fd : doorObstacles(ff))
+                {
+                    floor.doorObstacles.push_back(DoorObstacle{ static_cast<DoorType>(fd.type), static_cast<WallMaterial>(fd.material),
+                                                                fd.x1, fd.y1, fd.x2, fd.y2, fd.height, fd.swap != 0 });
+                }
+
+                for (const FlatObjectObstacle& fo : objectObstacles(ff))
+                {
+                    ObjectObstacle object{ std::string(string(fo.file)), fo.x, fo.y, fo.z, fo.rx, fo.ry, fo.rz, fo.sx, fo.sy, fo.sz, {} };
+                    for (const FlatPoint& p : footprint(fo))
+                        object.footprint.push_back(Point2D(p.x, p.y));
+                    floor.objectObstacles.push_back(object);
+                }
+
+                for (const FlatAccessPoint& fap : accessPoints(ff))
+                {
+                    floor.accessPoints.push_back(AccessPoint{ std::string(string(fap.name)), std::string(string(fap.macAddress)),
+                                                              fap.x, fap.y, fap.z, fap.heightAboveFloor,
+                                                              fap.mdl_txp, fap.mdl_exp, fap.mdl_waf });
+                }
+
+                for (const FlatBeacon& fb : beacons(ff))
+                {
+                    floor.beacons.push_back(Beacon{ std::string(string(fb.name)), std::string(string(fb.macAddress)),
+                                                    std::string(string(fb.uuid)), std::string(string(fb.major)), std::string(string(fb.minor)),
+                                                    fb.x, fb.y, fb.z, fb.heightAboveFloor,
+                                                    fb.mdl_txp, fb.mdl_exp, fb.mdl_waf });
+                }
+
+                for (const FlatGroundtruthPoint& gt : groundtruthPoints(ff))
+                {
+                    floor.groundtruthPoints.push_back(GroundtruthPoint{ gt.id, gt.x, gt.y, gt.z, gt.heightAboveFloor });
+                }
+
+                for (const FlatFingerprintLocation& fl : fingerprintLocations(ff))
+                {
+                    floor.fingerprintLocations.push_back(FingerprintLocation{ std::string(string(fl.name)), fl.x, fl.y, fl.z, fl.heightAboveFloor });
+                }
+
+                for (const FlatPointOfInterest& fpoi : pois(ff))
+                {
+                    floor.pois.push_back(PointOfInterest{ std::string(string(fpoi.name)), static_cast<POIType>(fpoi.type), fpoi.x, fpoi.y });
+                }
+
+                map.floors.push_back(floor);
+            }
+
+            return map;
+        }
+    };
+}
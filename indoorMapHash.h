@@ -0,0 +1,391 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "indoorMap.h"
+
+namespace Indoor::Map
+{
+    // 128 bit hash value. Use lo as 64 bit hash if 128 bits are not needed.
+    struct Hash128
+    {
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+
+        bool operator== (const Hash128& h) const { return lo == h.lo && hi == h.hi; }
+        bool operator!= (const Hash128& h) const { return !(*this == h); }
+    };
+
+    // Streaming hasher with two independent 64 bit lanes.
+    // Values are hashed by their decoded content, thus XML formatting does not change the result.
+    class Hasher
+    {
+    private:
+        uint64_t a;
+        uint64_t b;
+
+        static uint64_t rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+        static uint64_t fmix(uint64_t k)
+        {
+            k ^= k >> 33;
+            k *= 0xff51afd7ed558ccdULL;
+            k ^= k >> 33;
+            k *= 0xc4ceb9fe1a85ec53ULL;
+            k ^= k >> 33;
+            return k;
+        }
+
+    public:
+        explicit Hasher(uint64_t seed = 0)
+            : a(0x9e3779b97f4a7c15ULL ^ seed), b(0xc2b2ae3d27d4eb4fULL + seed)
+        {}
+
+        Hasher& add(uint64_t v)
+        {
+            a = rotl(a ^ (v * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+            b = rotl(b + (v * 0x52dce729ULL), 27) * 0x9e3779b97f4a7c15ULL + 0x38495ab5ULL;
+            return *this;
+        }
+
+        Hasher& add(int v) { return add(static_cast<uint64_t>(static_cast<uint32_t>(v))); }
+        Hasher& add(bool v) { return add(static_cast<uint64_t>(v ? 1 : 0)); }
+
+        Hasher& add(float v)
+        {
+            // -0 equals +0 and all NaNs are equal
+            if (v == 0.0f)
+                v = 0.0f;
+            if (std::isnan(v))
+                v = NAN;
+
+            uint32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            return add(static_cast<uint64_t>(bits));
+        }
+
+        Hasher& add(const std::string& str)
+        {
+            add(static_cast<uint64_t>(str.size()));
+
+            size_t i = 0;
+            for (; i + 8 <= str.size(); i += 8)
+            {
+                uint64_t word;
+                std::memcpy(&word, str.data() + i, 8);
+                add(word);
+            }
+
+            if (i < str.size())
+            {
+                uint64_t word = 0;
+                std::memcpy(&word, str.data() + i, str.size() - i);
+                add(word);
+            }
+
+            return *this;
+        }
+
+        Hasher& add(const Hash128& h)
+        {
+            add(h.lo);
+            return add(h.hi);
+        }
+
+        Hasher& add(const Point2D& p)
+        {
+            add(p.x);
+            return add(p.y);
+        }
+
+        Hash128 finish() const
+        {
+            Hash128 h;
+            h.lo = fmix(a ^ rotl(b, 17));
+            h.hi = fmix(b + h.lo);
+            return h;
+        }
+    };
+
+    // Combines element hashes independent of their order.
+    // Duplicates are still counted, i.e. {a, a} differs from {a}.
+    class UnorderedHasher
+    {
+    private:
+        Hash128 sum;
+        uint64_t count = 0;
+
+    public:
+        void add(const Hash128& h)
+        {
+            sum.lo += h.lo;
+            sum.hi += h.hi;
+            count++;
+        }
+
+        Hash128 finish(uint64_t seed) const
+        {
+            return Hasher(seed).add(sum).add(count).finish();
+        }
+    };
+
+    // Content hash of a single floor.
+    // Every category is hashed separately, thus consumers can check e.g. only if the transmitters changed.
+    struct FloorHash
+    {
+        Hash128 all;
+
+        // atHeight, height and name
+        Hash128 attributes;
+
+        Hash128 outline;
+        Hash128 walls;
+
+        // Line, circle, door and object obstacles
+        Hash128 obstacles;
+
+        Hash128 accessPoints;
+        Hash128 beacons;
+        Hash128 groundtruthPoints;
+        Hash128 fingerprintLocations;
+        Hash128 pois;
+    };
+
+    // Content hash of a map.
+    // Floors are hashed in order, all other collections are hashed independent of their order.
+    struct MapHash
+    {
+        Hash128 all;
+        Hash128 earthRegistration;
+        std::vector<FloorHash> floors;
+    };
+
+    // Seeds to separate the categories, i.e. an empty wall list differs from an empty AP list.
+    enum class HashCategory : uint64_t
+    {
+        Map = 1,
+        EarthRegistration,
+        Floor,
+        Outline,
+        Polygon,
+        Walls,
+        Wall,
+        Doors,
+        Windows,
+        AccessPoints,
+        Beacons,
+        GroundtruthPoints,
+        FingerprintLocations,
+        POIs,
+        Obstacles,
+        LineObstacles,
+        CircleObstacles,
+        DoorObstacles,
+        ObjectObstacles
+    };
+
+    inline Hash128 hashPolygon(const Polygon2D& polygon)
+    {
+        Hasher h(static_cast<uint64_t>(HashCategory::Polygon));
+        h.add(polygon.name).add(static_cast<int>(polygon.method)).add(polygon.isOutdoor);
+        h.add(static_cast<uint64_t>(polygon.points.size()));
+        for (const Point2D& p : polygon.points)
+            h.add(p);
+        return h.finish();
+    }
+
+    inline Hash128 hashDoor(const WallDoor& door)
+    {
+        return Hasher()
+            .add(static_cast<int>(door.material)).add(door.width).add(door.height).add(door.atLinePos)
+            .add(static_cast<int>(door.type)).add(door.leftRight).add(door.inOut)
+            .finish();
+    }
+
+    inline Hash128 hashWindow(const WallWindow& window)
+    {
+        return Hasher()
+            .add(static_cast<int>(window.material)).add(window.width).add(window.height).add(window.atLinePos)
+            .add(window.atHeigth).add(window.inOut)
+            .finish();
+    }
+
+    // Hashes the wall including doors and windows. Segments are derived data and not hashed.
+    inline Hash128 hashWall(const Wall& wall)
+    {
+        UnorderedHasher doors;
+        for (const WallDoor& door : wall.doors)
+            doors.add(hashDoor(door));
+
+        UnorderedHasher windows;
+        for (const WallWindow& window : wall.windows)
+            windows.add(hashWindow(window));
+
+        return Hasher(static_cast<uint64_t>(HashCategory::Wall))
+            .add(static_cast<int>(wall.material)).add(static_cast<int>(wall.type))
+            .add(wall.x1).add(wall.y1).add(wall.x2).add(wall.y2)
+            .add(wall.thickness).add(wall.height)
+            .add(doors.finish(static_cast<uint64_t>(HashCategory::Doors)))
+            .add(windows.finish(static_cast<uint64_t>(HashCategory::Windows)))
+            .finish();
+    }
+
+    inline Hash128 hashLineObstacle(const LineObstacle& line)
+    {
+        return Hasher()
+            .add(static_cast<int>(line.material)).add(static_cast<int>(line.type))
+            .add(line.x1).add(line.y1).add(line.x2).add(line.y2)
+            .add(line.thickness).add(line.height)
+            .finish();
+    }
+
+    inline Hash128 hashCircleObstacle(const CircleObstacle& circle)
+    {
+        return Hasher().add(static_cast<int>(circle.material)).add(circle.cx).add(circle.cy).add(circle.radius).add(circle.height).finish();
+    }
+
+    inline Hash128 hashDoorObstacle(const DoorObstacle& door)
+    {
+        return Hasher()
+            .add(static_cast<int>(door.type)).add(static_cast<int>(door.material))
+            .add(door.x1).add(door.y1).add(door.x2).add(door.y2)
+            .add(door.height).add(door.swap)
+            .finish();
+    }
+
+    inline Hash128 hashObjectObstacle(const ObjectObstacle& object)
+    {
+        Hasher h;
+        h.add(object.file).add(object.x).add(object.y).add(object.z);
+        h.add(object.rx).add(object.ry).add(object.rz).add(object.sx).add(object.sy).add(object.sz);
+        h.add(static_cast<uint64_t>(object.footprint.size()));
+        for (const Point2D& p : object.footprint)
+            h.add(p);
+        return h.finish();
+    }
+
+    inline Hash128 hashAccessPoint(const AccessPoint& ap)
+    {
+        return Hasher()
+            .add(ap.name).add(ap.macAddress)
+            .add(ap.x).add(ap.y).add(ap.z).add(ap.heightAboveFloor)
+            .add(ap.mdl_txp).add(ap.mdl_exp).add(ap.mdl_waf)
+            .finish();
+    }
+
+    inline Hash128 hashBeacon(const Beacon& b)
+    {
+        return Hasher()
+            .add(b.name).add(b.macAddress).add(b.uuid).add(b.major).add(b.minor)
+            .add(b.x).add(b.y).add(b.z).add(b.heightAboveFloor)
+            .add(b.mdl_txp).add(b.mdl_exp).add(b.mdl_waf)
+            .finish();
+    }
+
+    inline Hash128 hashGroundtruthPoint(const GroundtruthPoint& gt)
+    {
+        return Hasher().add(gt.id).add(gt.x).add(gt.y).add(gt.z).add(gt.heightAboveFloor).finish();
+    }
+
+    inline Hash128 hashFingerprintLocation(const FingerprintLocation& fl)
+    {
+        return Hasher().add(fl.name).add(fl.x).add(fl.y).add(fl.z).add(fl.heightAboveFloor).finish();
+    }
+
+    inline Hash128 hashPointOfInterest(const PointOfInterest& poi)
+    {
+        return Hasher().add(poi.name).add(static_cast<int>(poi.type)).add(poi.x).add(poi.y).finish();
+    }
+
+    template<typename T, typename HashFunc>
+    Hash128 hashUnordered(const std::vector<T>& elements, HashCategory category, HashFunc hashFunc)
+    {
+        UnorderedHasher h;
+        for (const T& e : elements)
+            h.add(hashFunc(e));
+        return h.finish(static_cast<uint64_t>(category));
+    }
+
+    inline FloorHash computeFloorHash(const Floor& floor)
+    {
+        FloorHash fh;
+        fh.attributes = Hasher(static_cast<uint64_t>(HashCategory::Floor)).add(floor.atHeight).add(floor.height).add(floor.name).finish();
+
+        fh.outline = hashUnordered(floor.outline.polygons, HashCategory::Outline, hashPolygon);
+        fh.walls = hashUnordered(floor.walls, HashCategory::Walls, hashWall);
+        fh.obstacles = Hasher(static_cast<uint64_t>(HashCategory::Obstacles))
+            .add(hashUnordered(floor.lineObstacles, HashCategory::LineObstacles, hashLineObstacle))
+            .add(hashUnordered(floor.circleObstacles, HashCategory::CircleObstacles, hashCircleObstacle))
+            .add(hashUnordered(floor.doorObstacles, HashCategory::DoorObstacles, hashDoorObstacle))
+            .add(hashUnordered(floor.objectObstacles, HashCategory::ObjectObstacles, hashObjectObstacle))
+            .finish();
+        fh.accessPoints = hashUnordered(floor.accessPoints, HashCategory::AccessPoints, hashAccessPoint);
+        fh.beacons = hashUnordered(floor.beacons, HashCategory::Beacons, hashBeacon);
+        fh.groundtruthPoints = hashUnordered(floor.groundtruthPoints, HashCategory::GroundtruthPoints, hashGroundtruthPoint);
+        fh.fingerprintLocations = hashUnordered(floor.fingerprintLocations, HashCategory::FingerprintLocations, hashFingerprintLocation);
+        fh.pois = hashUnordered(floor.pois, HashCategory::POIs, hashPointOfInterest);
+
+        fh.all = Hasher(static_cast<uint64_t>(HashCategory::Floor))
+            .add(fh.attributes).add(fh.outline).add(fh.walls).add(fh.obstacles)
+            .add(fh.accessPoints).add(fh.beacons).add(fh.groundtruthPoints)
+            .add(fh.fingerprintLocations).add(fh.pois)
+            .finish();
+
+        return fh;
+    }
+
+    inline MapHash computeContentHash(const Map& map)
+    {
+        MapHash mh;
+
+        UnorderedHasher earthReg;
+        for (const EarthPosMapPos& pos : map.earthRegistration.correspondences)
+        {
+            earthReg.add(Hasher().add(pos.lat).add(pos.lon).add(pos.alt).add(pos.x).add(pos.y).add(pos.z).finish());
+        }
+        mh.earthRegistration = earthReg.finish(static_cast<uint64_t>(HashCategory::EarthRegistration));
+
+        Hasher all(static_cast<uint64_t>(HashCategory::Map));
+        all.add(map.width).add(map.depth).add(mh.earthRegistration);
+        all.add(static_cast<uint64_t>(map.floors.size()));
+
+        mh.floors.reserve(map.floors.size());
+        for (const Floor& floor : map.floors)
+        {
+            mh.floors.push_back(computeFloorHash(floor));
+            all.add(mh.floors.back().all);
+        }
+
+        mh.all = all.finish();
+        return mh;
+    }
+
+    // Returns the content hash of the map. It is computed on first use and cached on the map,
+    // copies of the map compute their own. Safe to call concurrently on the same map.
+    inline MapHash contentHash(const Map& map)
+    {
+        std::shared_ptr<const MapHash> cached = std::atomic_load(&map.cachedHash.hash);
+        if (!cached)
+        {
+            cached = std::make_shared<const MapHash>(computeContentHash(map));
+            std::shared_ptr<const MapHash> expected;
+            if (!std::atomic_compare_exchange_strong(&map.cachedHash.hash, &expected, cached))
+            {
+                cached = expected;
+            }
+        }
+
+        return *cached;
+    }
+
+    // Must be called after the map has been modified.
+    inline void invalidateContentHash(Map& map)
+    {
+        std::atomic_store(&map.cachedHash.hash, std::shared_ptr<const MapHash>());
+    }
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapDoorState.h"
+#include "indoorMapNavGraph.h"
+
+namespace Indoor::Map
+{
+    // Closed ring of an isochrone: points[begin .. begin + count)
+    struct IsochroneRing
+    {
+        uint32_t floor;
+        uint32_t begin;
+        uint32_t count;
+
+        // Holes are clockwise, outer rings counter-clockwise
+        bool hole;
+    };
+
+    // Element reached within the distance
+    struct ReachedElement
+    {
+        uint32_t floor;
+
+        // Index within the floor's list, for doors the id within the DoorStateOverlay
+        uint32_t index;
+
+        float distance;
+    };
+
+    // Region reachable within a walking distance. The region is the union of the reached grid cells.
+    // The vectors are cleared and refilled by every query, thus a reused result does not allocate.
+    struct Isochrone
+    {
+        std::vector<Point2D> points;
+        std::vector<IsochroneRing> rings;
+
+        std::vector<ReachedElement> pois;
+        std::vector<ReachedElement> doors;
+        std::vector<ReachedElement> accessPoints;
+        std::vector<ReachedElement> beacons;
+
+        void clear()
+        {
+            points.clear();
+            rings.clear();
+            pois.clear();
+            doors.clear();
+            accessPoints.clear();
+            beacons.clear();
+        }
+    };
+
+    class IsochroneWorkspace
+    {
+    public:
+        NavSearchWorkspace search;
+
+        // Directed boundary edge between lattice points, the reached cell is on the left
+        struct BoundaryEdge
+        {
+            uint32_t floor;
+            int32_t x0, y0;
+            int32_t x1, y1;
+
+            bool operator< (const BoundaryEdge& e) const { return std::tie(floor, y0, x0) < std::tie(e.floor, e.y0, e.x0); }
+        };
+
+        std::vector<BoundaryEdge> edges;
+        std::vector<uint8_t> used;
+    };
+
+    namespace detail
+    {
+        // Shortest distance to p via the cell containing p or one of its 8 neighbours, infinity if none is reached.
+        // Only cells with a straight line to p which passes no blocking wall or closed door count, open doors add their cost.
+        inline float reachedDistance(const NavGraph& graph, const NavSearchWorkspace& ws, uint32_t floor, const Point2D& p)
+        {
+            const WalkableGrid& g = graph.grid(floor);
+            const float fx = std::floor((p.x - g.origin().x) / g.cellSize());
+            const float fy = std::floor((p.y - g.origin().y) / g.cellSize());
+
+            float best = std::numeric_limits<float>::infinity();
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    const float cx = fx + dx;
+                    const float cy = fy + dy;
+                    if (!(cx >= 0.0f && cy >= 0.0f && cx < g.width() && cy < g.height()))
+                        continue;
+
+                    const size_t cell = g.cellIndex(static_cast<uint32_t>(cx), static_cast<uint32_t>(cy));
+                    const float d = ws.dist[graph.node(floor, cell)];
+                    if (!(d < best))
+                        continue;
+
+                    const Point2D c = g.center(cell);
+                    if (!graph.wallIndex(floor).intersects(c, p, DoorStateBlocker{ &graph.doors(), floor }))
+                        best = std::min(best, d + graph.lineCost(floor, c, p));
+                }
+            }
+            return best;
+        }
+
+        // Traces the boundary of the reached cells into rings
+        inline void traceIsochrone(const NavGraph& graph, float maxDistance, Isochrone& result, IsochroneWorkspace& ws)
+        {
+            const NavSearchWorkspace& s = ws.search;
+            auto reached = [&](uint32_t floor, const WalkableGrid& g, int64_t x, int64_t y)
+            {
+                if (x < 0 || y < 0 || x >= g.width() || y >= g.height())
+                    return false;
+                return s.dist[graph.node(floor, g.cellIndex(static_cast<uint32_t>(x), static_cast<uint32_t>(y)))] <= maxDistance;
+            };
+
+            ws.edges.clear();
+            for (uint32_t n : s.touched)
+            {
+                if (s.dist[n] > maxDistance)
+                    continue;
+
+                const uint32_t f = graph.floorOf(n);
+                const WalkableGrid& g = graph.grid(f);
+                const uint32_t cell = graph.cellOf(n);
+                const int32_t x = static_cast<int32_t>(cell % g.width());
+                const int32_t y = static_cast<int32_t>(cell / g.width());
+
+                if (!reached(f, g, x, y - 1))
+                    ws.edges.push_back({ f, x, y, x + 1, y });
+                if (!reached(f, g, x + 1, y))
+                    ws.edges.push_back({ f, x + 1, y, x + 1, y + 1 });
+                if (!reached(f, g, x, y + 1))
+                    ws.edges.push_back({ f, x + 1, y + 1, x, y + 1 });
+                if (!reached(f, g, x - 1, y))
+                    ws.edges.push_back({ f, x, y + 1, x, y });
+            }
+
+            std::sort(ws.edges.begin(), ws.edges.end());
+            ws.used.assign(ws.edges.size(), 0);
+
+            for (size_t first = 0; first < ws.edges.size(); first++)
+            {
+                if (ws.used[first])
+                    continue;
+
+                const uint32_t floor = ws.edges[first].floor;
+                const WalkableGrid& g = graph.grid(floor);
+                IsochroneRing ring{ floor, static_cast<uint32_t>(result.points.size()), 0, false };
+                float area = 0.0f;
+
+                size_t e = first;
+                while (!ws.used[e])
+                {
+                    ws.used[e] = 1;
+                    const IsochroneWorkspace::BoundaryEdge& cur = ws.edges[e];
+                    const int32_t dx = cur.x1 - cur.x0;
+                    const int32_t dy = cur.y1 - cur.y0;
+                    area += static_cast<float>(cur.x0 * cur.y1 - cur.x1 * cur.y0);
+
+                    // Two candidates where only diagonal cells are reached, turning left keeps the cells apart
+                    const IsochroneWorkspace::BoundaryEdge key{ floor, cur.x1, cur.y1, 0, 0 };
+                    auto range = std::equal_range(ws.edges.begin(), ws.edges.end(), key);
+                    size_t next = first;
+                    for (auto it = range.first; it != range.second; ++it)
+                    {
+                        const size_t i = static_cast<size_t>(it - ws.edges.begin());
+                        if (ws.used[i] && i != first)
+                            continue;
+                        next = i;
+                        if (it->x1 - it->x0 == -dy && it->y1 - it->y0 == dx)
+                            break;
+                    }
+
+                    // Only corners are kept
+                    const IsochroneWorkspace::BoundaryEdge& n = ws.edges[next];
+                    if (n.x1 - n.x0 != dx || n.y1 - n.y0 != dy)
+                    {
+                        result.points.push_back(Point2D(g.origin().x + cur.x1 * g.cellSize(), g.origin().y + cur.y1 * g.cellSize()));
+                        ring.count++;
+                    }
+                    e = next;
+                }
+
+                ring.hole = area < 0.0f;
+                result.rings.push_back(ring);
+            }
+        }
+    }
+
+    // Region reachable within maxDistance meters of walking from p on the given floor.
+    // Walls, doors (including their runtime state) and floor connectors of the graph are respected.
+    // Returns false if p is not on the walkable area.
+    inline bool reachableWithin(const NavGraph& graph, uint32_t floor, const Point2D& p, float maxDistance,
+                                Isochrone& result, IsochroneWorkspace& ws)
+    {
+        result.clear();
+        const int64_t start = graph.nodeAt(floor, p);
+        if (start < 0)
+            return false;
+
+        searchNavGraph(graph, static_cast<uint32_t>(start), (graph.position(static_cast<uint32_t>(start)) - p).length(), maxDistance,
+                       ws.search, [](uint32_t, float) { return true; });
+
+        detail::traceIsochrone(graph, maxDistance, result, ws);
+
+        // Elements of floors which have been reached at all
+        const Map& map = graph.map();
+        for (uint32_t f = 0; f < map.floors.size(); f++)
+        {
+            const Floor& fl = map.floors[f];
+            bool reachedFloor = false;
+            for (const IsochroneRing& ring : result.rings)
+                reachedFloor = reachedFloor || ring.floor == f;
+            if (!reachedFloor)
+                continue;
+
+            auto check = [&](std::vector<ReachedElement>& list, uint32_t index, const Point2D& pos)
+            {
+                const float d = detail::reachedDistance(graph, ws.search, f, pos);
+                if (d <= maxDistance)
+                    list.push_back(ReachedElement{ f, index, d });
+            };
+
+            for (uint32_t i = 0; i < fl.pois.size(); i++)
+                check(result.pois, i, Point2D(fl.pois[i].x, fl.pois[i].y));
+            for (uint32_t i = 0; i < fl.accessPoints.size(); i++)
+                check(result.accessPoints, i, Point2D(fl.accessPoints[i].x, fl.accessPoints[i].y));
+            for (uint32_t i = 0; i < fl.beacons.size(); i++)
+                check(result.beacons, i, Point2D(fl.beacons[i].x, fl.beacons[i].y));
+        }
+
+        for (const NavDoor& door : graph.navigationDoors())
+        {
+            const float d = std::min(detail::reachedDistance(graph, ws.search, door.floor, door.sides[0]),
+                                     detail::reachedDistance(graph, ws.search, door.floor, door.sides[1]));
+            if (d <= maxDistance)
+                result.doors.push_back(ReachedElement{ door.floor, door.id, d });
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapParallel.h"
+#include "indoorMapParser.h"
+
+namespace Indoor::Map
+{
+    struct KdNeighbor
+    {
+        // Index of the element within the list the tree was built from
+        uint32_t index;
+        float distanceSquared;
+    };
+
+    // Static k-d tree over 2D or 3D points.
+    // The tree is stored implicitly: for every range [lo, hi) the element at the middle is the split point,
+    // thus no node pointers are needed and queries only touch flat arrays.
+    template<int Dim>
+    class KdTree
+    {
+    public:
+        using Point = std::array<float, Dim>;
+
+    private:
+        struct Entry
+        {
+            Point p;
+            uint32_t index;
+        };
+
+        std::vector<Entry> entries;
+        std::vector<uint8_t> axes;
+
+        static float distanceSquared(const Point& a, const Point& b)
+        {
+            float d = 0.0f;
+            for (int i = 0; i < Dim; i++)
+            {
+                const float v = a[i] - b[i];
+                d += v * v;
+            }
+            return d;
+        }
+
+        void build(size_t lo, size_t hi)
+        {
+            if (hi - lo <= 1)
+                return;
+
+            // Split along the axis with the largest extent
+            Point minP = entries[lo].p;
+            Point maxP = entries[lo].p;
+            for (size_t i = lo + 1; i < hi; i++)
+            {
+                for (int d = 0; d < Dim; d++)
+                {
+                    minP[d] = std::min(minP[d], entries[i].p[d]);
+                    maxP[d] = std::max(maxP[d], entries[i].p[d]);
+                }
+            }
+
+            int axis = 0;
+            for (int d = 1; d < Dim; d++)
+            {
+                if (maxP[d] - minP[d] > maxP[axis] - minP[axis])
+                    axis = d;
+            }
+
+            const size_t mid = (lo + hi) / 2;
+            std::nth_element(entries.begin() + lo, entries.begin() + mid, entries.begin() + hi, [axis](const Entry& a, const Entry& b)
+            {
+                return a.p[axis] < b.p[axis];
+            });
+
+            axes[mid] = static_cast<uint8_t>(axis);
+
+            build(lo, mid);
+            build(mid + 1, hi);
+        }
+
+        // Max heap on the distance, holds the k best candidates
+        static void pushCandidate(std::vector<KdNeighbor>& heap, size_t k, const KdNeighbor& n)
+        {
+            auto cmp = [](const KdNeighbor& a, const KdNeighbor& b) { return a.distanceSquared < b.distanceSquared; };
+
+            if (heap.size() < k)
+            {
+                heap.push_back(n);
+                std::push_heap(heap.begin(), heap.end(), cmp);
+            }
+            else if (n.distanceSquared < heap.front().distanceSquared)
+            {
+                std::pop_heap(heap.begin(), heap.end(), cmp);
+                heap.back() = n;
+                std::push_heap(heap.begin(), heap.end(), cmp);
+            }
+        }
+
+        void knn(size_t lo, size_t hi, const Point& q, size_t k, std::vector<KdNeighbor>& heap) const
+        {
+            while (lo < hi)
+            {
+                const size_t mid = (lo + hi) / 2;
+                pushCandidate(heap, k, KdNeighbor{ entries[mid].index, distanceSquared(entries[mid].p, q) });
+
+                if (hi - lo == 1)
+                    return;
+
+                const int axis = axes[mid];
+                const float diff = q[axis] - entries[mid].p[axis];
+
+                size_t nearLo = lo, nearHi = mid, farLo = mid + 1, farHi = hi;
+                if (diff > 0)
+                {
+                    std::swap(nearLo, farLo);
+                    std::swap(nearHi, farHi);
+                }
+
+                knn(nearLo, nearHi, q, k, heap);
+
+                if (heap.size() == k && diff * diff >= heap.front().distanceSquared)
+                    return;
+
+                lo = farLo;
+                hi = farHi;
+            }
+        }
+
+        void radius(size_t lo, size_t hi, const Point& q, float r2, std::vector<KdNeighbor>& result) const
+        {
+            while (lo < hi)
+            {
+                const size_t mid = (lo + hi) / 2;
+                const float d2 = distanceSquared(entries[mid].p, q);
+                if (d2 <= r2)
+                    result.push_back(KdNeighbor{ entries[mid].index, d2 });
+
+                if (hi - lo == 1)
+                    return;
+
+                const int axis = axes[mid];
+                const float diff = q[axis] - entries[mid].p[axis];
+
+                if (diff <= 0 || diff * diff <= r2)
+                    radius(lo, mid, q, r2, result);
+
+                if (diff >= 0 || diff * diff <= r2)
+                {
+                    lo = mid + 1;
+                    continue;
+                }
+                return;
+            }
+        }
+
+        void nearest(size_t lo, size_t hi, const Point& q, uint32_t& best, float& bestDist) const
+        {
+            while (lo < hi)
+            {
+                const size_t mid = (lo + hi) / 2;
+                const float d2 = distanceSquared(entries[mid].p, q);
+                if (d2 < bestDist)
+                {
+                    bestDist = d2;
+                    best = entries[mid].index;
+                }
+
+                if (hi - lo == 1)
+                    return;
+
+                const int axis = axes[mid];
+                const float diff = q[axis] - entries[mid].p[axis];
+
+                if (diff <= 0)
+                {
+                    nearest(lo, mid, q, best, bestDist);
+                    if (diff * diff >= bestDist)
+                        return;
+                    lo = mid + 1;
+                }
+                else
+                {
+                    nearest(mid + 1, hi, q, best, bestDist);
+                    if (diff * diff >= bestDist)
+                        return;
+                    hi = mid;
+                }
+            }
+        }
+
+        static void sortByDistance(std::vector<KdNeighbor>& result)
+        {
+            std::sort(result.begin(), result.end(), [](const KdNeighbor& a, const KdNeighbor& b)
+            {
+                return a.distanceSquared < b.distanceSquared || (a.distanceSquared == b.distanceSquared && a.index < b.index);
+            });
+        }
+
+    public:
+        KdTree() = default;
+
+        // KdNeighbor::index refers to the position within the given vector.
+        explicit KdTree(const std::vector<Point>& points)
+            : entries(points.size()), axes(points.size(), 0)
+        {
+            for (size_t i = 0; i < points.size(); i++)
+                entries[i] = Entry{ points[i], static_cast<uint32_t>(i) };
+
+            build(0, entries.size());
+        }
+
+        size_t size() const { return entries.size(); }
+        bool empty() const { return entries.empty(); }
+
+        // Index of the nearest point or -1 if the tree is empty. Does not allocate.
+        int nearest(const Point& q, float* distanceSquared = nullptr) const
+        {
+            if (entries.empty())
+                return -1;
+
+            uint32_t best = 0;
+            float bestDist = std::numeric_limits<float>::infinity();
+            nearest(0, entries.size(), q, best, bestDist);
+
+            if (distanceSquared)
+                *distanceSquared = bestDist;
+            return static_cast<int>(best);
+        }
+
+        // The k nearest points sorted by distance. result is reused to avoid allocations.
+        void knn(const Point& q, size_t k, std::vector<KdNeighbor>& result) const
+        {
+            result.clear();
+            if (k == 0)
+                return;
+
+            knn(0, entries.size(), q, k, result);
+            sortByDistance(result);
+        }
+
+        // All points within the radius sorted by distance. result is reused to avoid allocations.
+        void radius(const Point& q, float r, std::vector<KdNeighbor>& result) const
+        {
+            result.clear();
+            radius(0, entries.size(), q, r * r, result);
+            sortByDistance(result);
+        }
+
+        // Answers many k-NN queries in parallel. threadCount 0 uses all hardware threads.
+        std::vector<std::vector<KdNeighbor>> knnBatch(const std::vector<Point>& queries, size_t k, size_t threadCount = 0) const
+        {
+            std::vector<std::vector<KdNeighbor>> results(queries.size());
+            parallelFor(queries.size(), threadCount, [&](size_t begin, size_t end, size_t)
+            {
+                for (size_t i = begin; i < end; i++)
+                    knn(queries[i], k, results[i]);
+            });
+            return results;
+        }
+
+        // Answers many radius queries in parallel. threadCount 0 uses all hardware threads.
+        std::vector<std::vector<KdNeighbor>> radiusBatch(const std::vector<Point>& queries, float r, size_t threadCount = 0) const
+        {
+            std::vector<std::vector<KdNeighbor>> results(queries.size());
+            parallelFor(queries.size(), threadCount, [&](size_t begin, size_t end, size_t)
+            {
+                for (size_t i = begin; i < end; i++)
+                    radius(queries[i], r, results[i]);
+            });
+            return results;
+        }
+    };
+
+    using KdTree2D = KdTree<2>;
+    using KdTree3D = KdTree<3>;
+
+    // 2D trees over the point elements of a single floor.
+    // KdNeighbor::index is the index within the corresponding Floor list.
+    struct FloorPointIndex
+    {
+        KdTree2D pois;
+        KdTree2D accessPoints;
+        KdTree2D beacons;
+        KdTree2D fingerprintLocations;
+        KdTree2D groundtruthPoints;
+
+        FloorPointIndex() = default;
+
+        explicit FloorPointIndex(const Floor& floor)
+            : pois(points2D(floor.pois)),
+              accessPoints(points2D(floor.accessPoints)),
+              beacons(points2D(floor.beacons)),
+              fingerprintLocations(points2D(floor.fingerprintLocations)),
+              groundtruthPoints(points2D(floor.groundtruthPoints))
+        {}
+
+        template<typename T>
+        static std::vector<KdTree2D::Point> points2D(const std::vector<T>& elements)
+        {
+            std::vector<KdTree2D::Point> pts;
+            pts.reserve(elements.size());
+            for (const T& e : elements)
+                pts.push_back({ e.x, e.y });
+            return pts;
+        }
+    };
+
+    // Identifies an element of a map, used by the map wide 3D trees.
+    struct MapElementRef
+    {
+        uint32_t floor;
+        uint32_t index;
+    };
+
+    // 3D tree over one element category of all floors.
+    struct MapPointTree
+    {
+        KdTree3D tree;
+
+        // Maps KdNeighbor::index to the element
+        std::vector<MapElementRef> refs;
+
+        const MapElementRef& ref(const KdNeighbor& n) const { return refs[n.index]; }
+    };
+
+    // Per floor 2D trees and map wide 3D trees.
+    // POIs have no z coordinate, the floor's atHeight is used instead.
+    struct MapPointIndex
+    {
+        std::vector<FloorPointIndex> floors;
+
+        MapPointTree pois;
+        MapPointTree accessPoints;
+        MapPointTree beacons;
+        MapPointTree fingerprintLocations;
+        MapPointTree groundtruthPoints;
+
+        MapPointIndex() = default;
+
+        explicit MapPointIndex(const Map& map)
+        {
+            floors.reserve(map.floors.size());
+            for (const Floor& floor : map.floors)
+                floors.emplace_back(floor);
+
+            pois = buildTree(map, [](const Floor& f) -> const auto& { return f.pois; },
+                             [](const Floor& f, const PointOfInterest& poi) { return KdTree3D::Point{ poi.x, poi.y, f.atHeight }; });
+            accessPoints = buildTree(map, [](const Floor& f) -> const auto& { return f.accessPoints; },
+                                     [](const Floor&, const AccessPoint& ap) { return KdTree3D::Point{ ap.x, ap.y, ap.z }; });
+            beacons = buildTree(map, [](const Floor& f) -> const auto& { return f.beacons; },
+                                [](const Floor&, const Beacon& b) { return KdTree3D::Point{ b.x, b.y, b.z }; });
+            fingerprintLocations = buildTree(map, [](const Floor& f) -> const auto& { return f.fingerprintLocations; },
+                                             [](const Floor&, const FingerprintLocation& fl) { return KdTree3D::Point{ fl.x, fl.y, fl.z }; });
+            groundtruthPoints = buildTree(map, [](const Floor& f) -> const auto& { return f.groundtruthPoints; },
+                                          [](const Floor&, const GroundtruthPoint& gt) { return KdTree3D::Point{ gt.x, gt.y, gt.z }; });
+        }
+
+    private:
+        template<typename ListFunc, typename PointFunc>
+        static MapPointTree buildTree(const Map& map, ListFunc list, PointFunc point)
+        {
+            MapPointTree result;
+            std::vector<KdTree3D::Point> pts;
+
+            for (size_t f = 0; f < map.floors.size(); f++)
+            {
+                const auto& elements = list(map.floors[f]);
+                for (size_t i = 0; i < elements.size(); i++)
+                {
+                    pts.push_back(point(map.floors[f], elements[i]));
+                    result.refs.push_back(MapElementRef{ static_cast<uint32_t>(f), static_cast<uint32_t>(i) });
+                }
+            }
+
+            result.tree = KdTree3D(pts);
+            return result;
+        }
+    };
+
+    // Builds the point index when the map has been parsed.
+    class PointIndexListener : public MapListener
+    {
+    public:
+        std::shared_ptr<MapPointIndex> index;
+
+        void leaveMap(Map& map) override
+        {
+            MapListener::leaveMap(map);
+            this->index = std::make_shared<MapPointIndex>(map);
+        };
+    };
+}
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapNavGraph.h"
+#include "indoorMapParallel.h"
+
+namespace Indoor::Map
+{
+    // Noisy position estimate, e.g. of a Wi-Fi or PDR based localization
+    struct PositionFix
+    {
+        uint32_t floor;
+        Point2D position;
+    };
+
+    struct MapMatchingOptions
+    {
+        // Standard deviation of the fixes in meters
+        float sigma = 3.0f;
+
+        // Transition probability exp(-route / beta), i.e. longer routes between candidates are less likely
+        float beta = 2.0f;
+
+        // Candidates are the walkable cells at the points of a lattice within this radius around the fix.
+        // The nearest maxCandidates are kept, a coarse lattice spreads them over both sides of nearby walls.
+        float candidateRadius = 6.0f;
+        float candidateSpacing = 1.5f;
+        size_t maxCandidates = 16;
+
+        // Routes longer than routeFactor * (distance between the fixes) + 2 * candidateRadius are not feasible
+        float routeFactor = 2.0f;
+
+        // Additionally computes the walking path through all matched positions
+        bool buildPath = false;
+    };
+
+    struct MatchedFix
+    {
+        uint32_t floor;
+        Point2D position;
+
+        // Node of the NavGraph, UINT32_MAX if no walkable cell is near the fix
+        uint32_t node;
+
+        // False if the fix could not be reached from its predecessor, the match starts anew
+        bool connected;
+    };
+
+    struct MatchResult
+    {
+        std::vector<MatchedFix> fixes;
+        std::vector<NavWaypoint> path;
+    };
+
+    // Viterbi map matcher on a NavGraph.
+    // The transition scores of a step are computed by a single multi-source search: every candidate of the
+    // previous fix starts with a distance offset of beta * (best score - its score), thus the distance reaching
+    // a new candidate already includes the best predecessor. Costs O(visited nodes) per fix instead of one
+    // search per candidate pair.
+    // Not thread-safe, use one matcher per thread (see matchTrajectories()).
+    class MapMatcher
+    {
+    private:
+        struct Candidate
+        {
+            uint32_t node;
+            float distance;
+
+            // Log probability of the best sequence ending here
+            float score;
+
+            // Index of the predecessor within the previous step, -1 at the start of a sequence
+            int32_t back;
+        };
+
+        const NavGraph* graph;
+        MapMatchingOptions options;
+        NavSearchWorkspace ws;
+
+        // Candidates of step t are candidates[candidateStart[t] .. candidateStart[t + 1])
+        std::vector<Candidate> candidates;
+        std::vector<uint32_t> candidateStart;
+        std::vector<NavSource> sources;
+        std::vector<NavWaypoint> segment;
+
+        void collectCandidates(const PositionFix& fix)
+        {
+            const size_t first = candidates.size();
+            const float r = options.candidateRadius;
+            const float s = options.candidateSpacing;
+
+            auto add = [&](int64_t node)
+            {
+                if (node < 0)
+                    return;
+                for (size_t i = first; i < candidates.size(); i++)
+                {
+                    if (candidates[i].node == node)
+                        return;
+                }
+                const float d = (graph->position(static_cast<uint32_t>(node)) - fix.position).length();
+                candidates.push_back(Candidate{ static_cast<uint32_t>(node), d, 0.0f, -1 });
+            };
+
+            add(graph->nodeAt(fix.floor, fix.position));
+
+            // Lattice aligned to the map, thus consecutive fixes share candidate nodes
+            const int64_t x0 = static_cast<int64_t>(std::ceil((fix.position.x - r) / s));
+            const int64_t x1 = static_cast<int64_t>(std::floor((fix.position.x + r) / s));
+            const int64_t y0 = static_cast<int64_t>(std::ceil((fix.position.y - r) / s));
+            const int64_t y1 = static_cast<int64_t>(std::floor((fix.position.y + r) / s));
+            for (int64_t y = y0; y <= y1; y++)
+            {
+                for (int64_t x = x0; x <= x1; x++)
+                {
+                    const Point2D p(x * s, y * s);
+                    if ((p - fix.position).length() <= r)
+                        add(graph->nodeAt(fix.floor, p));
+                }
+            }
+
+            std::sort(candidates.begin() + first, candidates.end(), [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+            if (candidates.size() - first > options.maxCandidates)
+                candidates.resize(first + options.maxCandidates);
+
+            for (size_t i = first; i < candidates.size(); i++)
+            {
+                const float z = candidates[i].distance / options.sigma;
+                candidates[i].score = -0.5f * z * z;
+            }
+        }
+
+        // Scores the candidates of step t from those of step t - 1. Returns false if none is reachable.
+        bool transition(size_t t, float fixDistance)
+        {
+            const uint32_t prevBegin = candidateStart[t - 1];
+            const uint32_t prevEnd = candidateStart[t];
+            const uint32_t begin = candidateStart[t];
+            const uint32_t end = static_cast<uint32_t>(candidates.size());
+
+            float best = -std::numeric_limits<float>::infinity();
+            for (uint32_t i = prevBegin; i < prevEnd; i++)
+                best = std::max(best, candidates[i].score);
+
+            const float limit = options.routeFactor * fixDistance + 2.0f * options.candidateRadius;
+            sources.clear();
+            float maxOffset = 0.0f;
+            for (uint32_t i = prevBegin; i < prevEnd; i++)
+            {
+                const float offset = options.beta * (best - candidates[i].score);
+                if (offset > limit)
+                    continue;
+                sources.push_back(NavSource{ candidates[i].node, offset });
+                maxOffset = std::max(maxOffset, offset);
+            }
+
+            // Stop as soon as all candidates are reached
+            size_t remaining = end - begin;
+            searchNavGraph(*graph, sources.data(), sources.size(), limit + maxOffset, ws, [&](uint32_t n, float)
+            {
+                for (uint32_t j = begin; j < end; j++)
+                {
+                    if (candidates[j].node == n)
+                        remaining--;
+                }
+                return remaining > 0;
+            });
+
+            bool reached = false;
+            for (uint32_t j = begin; j < end; j++)
+            {
+                Candidate& c = candidates[j];
+                const float d = ws.dist[c.node];
+                if (d == std::numeric_limits<float>::infinity())
+                {
+                    c.score = -std::numeric_limits<float>::infinity();
+                    continue;
+                }
+
+                // The parent chain ends at the predecessor
+                uint32_t origin = c.node;
+                while (ws.parent[origin] != UINT32_MAX)
+                    origin = ws.parent[origin];
+                for (uint32_t i = prevBegin; i < prevEnd; i++)
+                {
+                    if (candidates[i].node == origin)
+                        c.back = static_cast<int32_t>(i - prevBegin);
+                }
+
+                c.score += best - d / options.beta;
+                reached = true;
+            }
+            return reached;
+        }
+
+    public:
+        MapMatcher(const NavGraph& graph, const MapMatchingOptions& options = MapMatchingOptions())
+            : graph(&graph), options(options)
+        {
+        }
+
+        void match(const std::vector<PositionFix>& fixes, MatchResult& result)
+        {
+            result.fixes.clear();
+            result.path.clear();
+            candidates.clear();
+            candidateStart.clear();
+
+            // Forward pass
+            for (size_t t = 0; t < fixes.size(); t++)
+            {
+                candidateStart.push_back(static_cast<uint32_t>(candidates.size()));
+                collectCandidates(fixes[t]);
+
+                const bool hasPrevious = t > 0 && candidateStart[t] > candidateStart[t - 1];
+                bool connected = hasPrevious && candidates.size() > candidateStart[t]
+                    && transition(t, (fixes[t].position - fixes[t - 1].position).length());
+
+                if (hasPrevious && !connected)
+                {
+                    // Break: restart with the emission scores
+                    for (size_t j = candidateStart[t]; j < candidates.size(); j++)
+                    {
+                        const float z = candidates[j].distance / options.sigma;
+                        candidates[j].score = -0.5f * z * z;
+                        candidates[j].back = -1;
+                    }
+                }
+            }
+            candidateStart.push_back(static_cast<uint32_t>(candidates.size()));
+
+            // Backtracking, a new sequence starts wherever the chain has no predecessor
+            result.fixes.resize(fixes.size());
+            int32_t current = -1;
+            for (size_t t = fixes.size(); t-- > 0;)
+            {
+                const uint32_t begin = candidateStart[t];
+                const uint32_t end = candidateStart[t + 1];
+                MatchedFix& m = result.fixes[t];
+                m = MatchedFix{ fixes[t].floor, fixes[t].position, UINT32_MAX, false };
+
+                if (begin == end)
+                {
+                    current = -1;
+                    continue;
+                }
+
+                if (current < 0)
+                {
+                    float best = -std::numeric_limits<float>::infinity();
+                    for (uint32_t i = begin; i < end; i++)
+                    {
+                        if (candidates[i].score > best || current < 0)
+                        {
+                            best = candidates[i].score;
+                            current = static_cast<int32_t>(i - begin);
+                        }
+                    }
+                }
+
+                const Candidate& c = candidates[begin + current];
+                m.node = c.node;
+                m.position = graph->position(c.node);
+                m.floor = graph->floorOf(c.node);
+                m.connected = c.back >= 0;
+                current = c.back;
+            }
+
+            if (options.buildPath)
+            {
+                for (size_t t = 1; t < result.fixes.size(); t++)
+                {
+                    const MatchedFix& a = result.fixes[t - 1];
+                    const MatchedFix& b = result.fixes[t];
+                    if (!b.connected)
+                        continue;
+
+                    float length;
+                    if (!shortestPath(*graph, a.floor, a.position, b.floor, b.position, segment, length, ws))
+                        continue;
+
+                    // Consecutive segments share their end points
+                    const size_t skip = result.path.empty() ? 0 : 1;
+                    result.path.insert(result.path.end(), segment.begin() + std::min(skip, segment.size()), segment.end());
+                }
+            }
+        }
+
+        MatchResult match(const std::vector<PositionFix>& fixes)
+        {
+            MatchResult result;
+            match(fixes, result);
+            return result;
+        }
+    };
+
+    // Matches independent trajectories in parallel, one matcher per thread.
+    inline std::vector<MatchResult> matchTrajectories(const NavGraph& graph, const std::vector<std::vector<PositionFix>>& trajectories,
+                                                      const MapMatchingOptions& options = MapMatchingOptions(), size_t threadCount = 0)
+    {
+        std::vector<MatchResult> results(trajectories.size());
+        parallelFor(trajectories.size(), threadCount, [&](size_t begin, size_t end, size_t)
+        {
+            MapMatcher matcher(graph, options);
+            for (size_t i = begin; i < end; i++)
+                matcher.match(trajectories[i], results[i]);
+        });
+        return results;
+    }
+}
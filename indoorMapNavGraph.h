@@ -0,0 +1,526 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapDistanceField.h"
+#include "indoorMapDoorState.h"
+#include "indoorMapWallIndex.h"
+
+namespace Indoor::Map
+{
+    // Walkable link between two floors, e.g. stairs or an elevator.
+    // The map format does not describe stairs and elevators yet, thus connectors are provided by the caller.
+    struct FloorConnector
+    {
+        uint32_t floorA;
+        Point2D a;
+
+        uint32_t floorB;
+        Point2D b;
+
+        // Walking distance in meters, negative costs are taken as 0
+        float cost;
+    };
+
+    struct NavGraphOptions
+    {
+        WalkableGridOptions grid;
+        std::vector<FloorConnector> connectors;
+    };
+
+    // Door of the graph, sides are walkable points in front of and behind the door
+    struct NavDoor
+    {
+        // Id within the DoorStateOverlay
+        uint32_t id;
+        uint32_t floor;
+        Point2D center;
+        Point2D sides[2];
+    };
+
+    // Navigation graph over the walkable grids of all floors.
+    // Nodes are walkable cells, edges connect the 8-neighbourhood and floor connectors.
+    // Moves without doors are precomputed as bit masks. Moves through doors consult the DoorStateOverlay
+    // on every traversal, thus closing a door or changing its cost takes effect without rebuilding the graph.
+    class NavGraph
+    {
+    public:
+        // Move directions, bit i of a node's mask is set if the move is possible
+        static constexpr int MoveDx[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+        static constexpr int MoveDy[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+
+    private:
+        // Bits 0-7: moves without doors, bits 8-11: orthogonal moves through an open door, bit 12: connector
+        enum : uint16_t
+        {
+            DoorMoveShift = 8,
+            ConnectorBit = 1 << 12
+        };
+
+        const Map* navMap;
+        const DoorStateOverlay* doorStates;
+
+        std::vector<WalkableGrid> grids;
+        std::vector<WallIndex> indices;
+
+        // Node of cell c on floor f is nodeBase[f] + c
+        std::vector<uint32_t> nodeBase;
+        std::vector<uint16_t> moves;
+
+        // Both directions of every connector, sorted by node
+        struct ConnectorEdge
+        {
+            uint32_t node;
+            uint32_t other;
+            float cost;
+
+            bool operator< (const ConnectorEdge& e) const { return node < e.node; }
+        };
+
+        std::vector<ConnectorEdge> connectorEdges;
+        std::vector<NavDoor> navDoors;
+        float minCost = std::numeric_limits<float>::infinity();
+
+        void buildMoves(uint32_t floor)
+        {
+            const WalkableGrid& g = grids[floor];
+            const std::vector<uint8_t>& flags = g.cellFlags();
+            const int64_t w = g.width();
+            const int64_t h = g.height();
+            uint16_t* m = moves.data() + nodeBase[floor];
+
+            auto walkable = [&](int64_t x, int64_t y) { return x >= 0 && y >= 0 && x < w && y < h && (flags[y * w + x] & WalkableGrid::Walkable); };
+
+            // Orthogonal moves. Flags of a move are stored at its west or south cell.
+            for (int64_t y = 0; y < h; y++)
+            {
+                for (int64_t x = 0; x < w; x++)
+                {
+                    const size_t i = static_cast<size_t>(y * w + x);
+                    if (!(flags[i] & WalkableGrid::Walkable))
+                        continue;
+
+                    for (int k = 0; k < 4; k++)
+                    {
+                        const int64_t nx = x + MoveDx[k];
+                        const int64_t ny = y + MoveDy[k];
+                        if (!walkable(nx, ny))
+                            continue;
+
+                        const uint8_t f = flags[static_cast<size_t>(std::min(y, ny) * w + std::min(x, nx))];
+                        const bool horizontal = k < 2;
+                        if (f & (horizontal ? WalkableGrid::BlockedEast : WalkableGrid::BlockedNorth))
+                            continue;
+
+                        if (f & (horizontal ? WalkableGrid::DoorEast : WalkableGrid::DoorNorth))
+                            m[i] |= static_cast<uint16_t>(1 << (DoorMoveShift + k));
+                        else
+                            m[i] |= static_cast<uint16_t>(1 << k);
+                    }
+                }
+            }
+
+            // Diagonal moves require both detours via the orthogonal neighbours to be free
+            for (int64_t y = 0; y < h; y++)
+            {
+                for (int64_t x = 0; x < w; x++)
+                {
+                    const size_t i = static_cast<size_t>(y * w + x);
+                    for (int k = 4; k < 8; k++)
+                    {
+                        const int kx = MoveDx[k] > 0 ? 0 : 1;
+                        const int ky = MoveDy[k] > 0 ? 2 : 3;
+                        if (!(m[i] & (1 << kx)) || !(m[i] & (1 << ky)))
+                            continue;
+
+                        const size_t viaX = static_cast<size_t>(y * w + x + MoveDx[k]);
+                        const size_t viaY = static_cast<size_t>((y + MoveDy[k]) * w + x);
+                        if ((m[viaX] & (1 << ky)) && (m[viaY] & (1 << kx)))
+                            m[i] |= static_cast<uint16_t>(1 << k);
+                    }
+                }
+            }
+        }
+
+        // Extra cost of an orthogonal door move, infinity if the door is closed
+        float doorCost(uint32_t floor, size_t cell, int k) const
+        {
+            const WalkableGrid& g = grids[floor];
+            const size_t lower = k == 1 ? cell - 1 : (k == 3 ? cell - g.width() : cell);
+            const IndexedSegment* seg = g.doorOfMove(lower, k >= 2);
+            const int64_t id = seg ? doorStates->doorId(floor, *seg) : -1;
+            return id < 0 ? 0.0f : doorStates->cost(static_cast<uint32_t>(id));
+        }
+
+    public:
+        NavGraph(const Map& map, const DoorStateOverlay& doors, const NavGraphOptions& options = NavGraphOptions())
+            : navMap(&map), doorStates(&doors)
+        {
+            uint32_t nodes = 0;
+            for (uint32_t f = 0; f < map.floors.size(); f++)
+            {
+                const Floor& floor = map.floors[f];
+                grids.emplace_back(floor, options.grid);
+                indices.emplace_back(floor);
+                nodeBase.push_back(nodes);
+                nodes += static_cast<uint32_t>(grids.back().cellCount());
+                minCost = std::min(minCost, options.grid.cellSize);
+
+                for (const IndexedSegment& seg : indices.back().segments())
+                {
+                    const int64_t id = doors.doorId(f, seg);
+                    if (id < 0)
+                        continue;
+
+                    const Point2D center = (seg.start + seg.end) / 2.0f;
+                    const Point2D normal = (seg.end - seg.start).orthogonal().normalized() * (seg.thickness / 2.0f + options.grid.cellSize);
+                    navDoors.push_back(NavDoor{ static_cast<uint32_t>(id), f, center, { center + normal, center - normal } });
+                }
+            }
+            nodeBase.push_back(nodes);
+
+            moves.assign(nodes, 0);
+            for (uint32_t f = 0; f < grids.size(); f++)
+                buildMoves(f);
+
+            for (const FloorConnector& c : options.connectors)
+            {
+                const int64_t a = nodeAt(c.floorA, c.a);
+                const int64_t b = nodeAt(c.floorB, c.b);
+                if (a < 0 || b < 0)
+                    continue;
+
+                // The bucket queue of searchNavGraph() requires non-negative costs
+                const float cost = c.cost > 0.0f ? c.cost : 0.0f;
+                connectorEdges.push_back(ConnectorEdge{ static_cast<uint32_t>(a), static_cast<uint32_t>(b), cost });
+                connectorEdges.push_back(ConnectorEdge{ static_cast<uint32_t>(b), static_cast<uint32_t>(a), cost });
+                moves[a] |= ConnectorBit;
+                moves[b] |= ConnectorBit;
+                if (cost > 0.0f)
+                    minCost = std::min(minCost, cost);
+            }
+            std::stable_sort(connectorEdges.begin(), connectorEdges.end());
+        }
+
+        const Map& map() const { return *navMap; }
+        const DoorStateOverlay& doors() const { return *doorStates; }
+        const std::vector<NavDoor>& navigationDoors() const { return navDoors; }
+
+        size_t nodeCount() const { return nodeBase.back(); }
+        size_t floorCount() const { return grids.size(); }
+        const WalkableGrid& grid(uint32_t floor) const { return grids[floor]; }
+        const WallIndex& wallIndex(uint32_t floor) const { return indices[floor]; }
+
+        // Lower bound of all edge costs, except for connectors without cost
+        float minEdgeCost() const { return minCost; }
+
+        uint32_t floorOf(uint32_t node) const
+        {
+            return static_cast<uint32_t>(std::upper_bound(nodeBase.begin(), nodeBase.end(), node) - nodeBase.begin() - 1);
+        }
+
+        uint32_t cellOf(uint32_t node) const { return node - nodeBase[floorOf(node)]; }
+        uint32_t node(uint32_t floor, size_t cell) const { return nodeBase[floor] + static_cast<uint32_t>(cell); }
+        Point2D position(uint32_t node) const { return grids[floorOf(node)].center(cellOf(node)); }
+
+        // Walkable node closest to p among the cell containing p and its 8 neighbours, or -1
+        int64_t nodeAt(uint32_t floor, const Point2D& p) const
+        {
+            if (floor >= grids.size())
+                return -1;
+
+            const WalkableGrid& g = grids[floor];
+            const float fx = std::floor((p.x - g.origin().x) / g.cellSize());
+            const float fy = std::floor((p.y - g.origin().y) / g.cellSize());
+
+            int64_t best = -1;
+            float bestDist = std::numeric_limits<float>::infinity();
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    const float cx = fx + dx;
+                    const float cy = fy + dy;
+                    if (!(cx >= 0.0f && cy >= 0.0f && cx < g.width() && cy < g.height()))
+                        continue;
+
+                    const size_t cell = g.cellIndex(static_cast<uint32_t>(cx), static_cast<uint32_t>(cy));
+                    const float d = (g.center(cell) - p).length();
+                    if (g.isWalkable(cell) && d < bestDist)
+                    {
+                        bestDist = d;
+                        best = node(floor, cell);
+                    }
+                }
+            }
+            return best;
+        }
+
+        // Cost of the connector between two nodes, infinity if there is none
+        float connectorCost(uint32_t a, uint32_t b) const
+        {
+            float cost = std::numeric_limits<float>::infinity();
+            auto it = std::lower_bound(connectorEdges.begin(), connectorEdges.end(), ConnectorEdge{ a, 0, 0.0f });
+            for (; it != connectorEdges.end() && it->node == a; ++it)
+            {
+                if (it->other == b)
+                    cost = std::min(cost, it->cost);
+            }
+            return cost;
+        }
+
+        // Calls func(next, cost) for all traversable edges of the node
+        template<typename Func>
+        void forEachEdge(uint32_t from, Func func) const
+        {
+            const uint16_t m = moves[from];
+            if (m == 0)
+                return;
+
+            const uint32_t floor = floorOf(from);
+            const WalkableGrid& g = grids[floor];
+            const int64_t w = g.width();
+            const float h = g.cellSize();
+            const float diagonal = h * 1.41421356f;
+
+            for (int k = 0; k < 8; k++)
+            {
+                if (m & (1 << k))
+                    func(static_cast<uint32_t>(from + MoveDx[k] + MoveDy[k] * w), k < 4 ? h : diagonal);
+            }
+
+            if (m & (0xF << DoorMoveShift))
+            {
+                const size_t cell = from - nodeBase[floor];
+                for (int k = 0; k < 4; k++)
+                {
+                    if (!(m & (1 << (DoorMoveShift + k))))
+                        continue;
+
+                    const float extra = doorCost(floor, cell, k);
+                    if (extra != std::numeric_limits<float>::infinity())
+                        func(static_cast<uint32_t>(from + MoveDx[k] + MoveDy[k] * w), h + extra);
+                }
+            }
+
+            if (m & ConnectorBit)
+            {
+                auto it = std::lower_bound(connectorEdges.begin(), connectorEdges.end(), ConnectorEdge{ from, 0, 0.0f });
+                for (; it != connectorEdges.end() && it->node == from; ++it)
+                    func(it->other, it->cost);
+            }
+        }
+
+        // True if the straight line stays on the walkable area and passes no blocking wall or closed door
+        bool lineWalkable(uint32_t floor, const Point2D& a, const Point2D& b) const
+        {
+            const WalkableGrid& g = grids[floor];
+            if (indices[floor].intersects(a, b, DoorStateBlocker{ doorStates, floor }))
+                return false;
+
+            const float length = (b - a).length();
+            const int steps = static_cast<int>(std::ceil(length / (0.5f * g.cellSize())));
+            for (int i = 0; i <= steps; i++)
+            {
+                if (!g.isWalkable(a + (b - a) * (steps == 0 ? 0.0f : static_cast<float>(i) / steps)))
+                    return false;
+            }
+            return true;
+        }
+
+        // Length of the straight line including the costs of the doors it passes
+        float lineCost(uint32_t floor, const Point2D& a, const Point2D& b) const
+        {
+            float cost = (b - a).length();
+            indices[floor].forEachCrossing(a, b, [&](uint32_t i, float)
+            {
+                const int64_t id = doorStates->doorId(floor, indices[floor].segments()[i]);
+                if (id >= 0)
+                    cost += doorStates->cost(static_cast<uint32_t>(id));
+            }, [](const IndexedSegment& s) { return s.type == WallSegmentType::Door; });
+            return cost;
+        }
+    };
+
+    // Reusable state of graph searches. Only touched nodes are reset, thus a search costs O(visited nodes)
+    // and does not allocate once the buffers have grown.
+    class NavSearchWorkspace
+    {
+    public:
+        std::vector<float> dist;
+        std::vector<uint32_t> parent;
+        std::vector<uint32_t> touched;
+
+        // Bucket queue, bucket i holds distances [i * width, (i + 1) * width)
+        std::vector<std::vector<std::pair<float, uint32_t>>> buckets;
+        size_t usedBuckets = 0;
+
+        std::vector<uint32_t> nodes;
+
+        void reset(size_t nodeCount)
+        {
+            for (uint32_t n : touched)
+                dist[n] = std::numeric_limits<float>::infinity();
+            touched.clear();
+
+            for (size_t i = 0; i < usedBuckets; i++)
+                buckets[i].clear();
+            usedBuckets = 0;
+
+            if (dist.size() != nodeCount)
+            {
+                dist.assign(nodeCount, std::numeric_limits<float>::infinity());
+                parent.assign(nodeCount, UINT32_MAX);
+            }
+        }
+
+        void push(uint32_t node, float d, uint32_t from, float bucketWidth)
+        {
+            if (dist[node] == std::numeric_limits<float>::infinity())
+                touched.push_back(node);
+            dist[node] = d;
+            parent[node] = from;
+
+            const size_t b = static_cast<size_t>(d / bucketWidth);
+            if (b >= buckets.size())
+                buckets.resize(b + 1);
+            usedBuckets = std::max(usedBuckets, b + 1);
+            buckets[b].emplace_back(d, node);
+        }
+    };
+
+    // Start node of a search with its initial distance
+    struct NavSource
+    {
+        uint32_t node;
+        float distance;
+    };
+
+    // Multi-source Dijkstra, stops at maxDistance or when visit(node, distance) returns false.
+    // The queue uses buckets of the minimum edge cost. Nodes of a bucket can not improve each other,
+    // thus every node is final when it is visited, without ordering within a bucket.
+    // Distances and parents remain in the workspace until the next search, parent chains end at a source.
+    template<typename Visit>
+    void searchNavGraph(const NavGraph& graph, const NavSource* sources, size_t sourceCount, float maxDistance, NavSearchWorkspace& ws, Visit visit)
+    {
+        ws.reset(graph.nodeCount());
+        const float width = graph.minEdgeCost();
+        for (size_t i = 0; i < sourceCount; i++)
+        {
+            if (sources[i].distance < ws.dist[sources[i].node])
+                ws.push(sources[i].node, sources[i].distance, UINT32_MAX, width);
+        }
+
+        for (size_t b = 0; b < ws.usedBuckets; b++)
+        {
+            // The bucket may grow by connectors without cost
+            for (size_t i = 0; i < ws.buckets[b].size(); i++)
+            {
+                const auto [d, n] = ws.buckets[b][i];
+
+                // Outdated entry
+                if (d > ws.dist[n])
+                    continue;
+                if (!visit(n, d))
+                    return;
+
+                graph.forEachEdge(n, [&](uint32_t next, float cost)
+                {
+                    const float nd = d + cost;
+                    if (nd <= maxDistance && nd < ws.dist[next])
+                        ws.push(next, nd, n, width);
+                });
+            }
+        }
+    }
+
+    template<typename Visit>
+    void searchNavGraph(const NavGraph& graph, uint32_t start, float startDistance, float maxDistance, NavSearchWorkspace& ws, Visit visit)
+    {
+        const NavSource source{ start, startDistance };
+        searchNavGraph(graph, &source, 1, maxDistance, ws, visit);
+    }
+
+    struct NavWaypoint
+    {
+        uint32_t floor;
+        Point2D position;
+    };
+
+    // Shortest walking path, false if the target is not reachable.
+    // The grid path is shortened to straight lines where they are walkable, length includes door and connector costs.
+    inline bool shortestPath(const NavGraph& graph, uint32_t fromFloor, const Point2D& from, uint32_t toFloor, const Point2D& to,
+                             std::vector<NavWaypoint>& path, float& length, NavSearchWorkspace& ws)
+    {
+        path.clear();
+        const int64_t start = graph.nodeAt(fromFloor, from);
+        const int64_t target = graph.nodeAt(toFloor, to);
+        if (start < 0 || target < 0)
+            return false;
+
+        bool found = false;
+        searchNavGraph(graph, static_cast<uint32_t>(start), (graph.position(static_cast<uint32_t>(start)) - from).length(),
+                       std::numeric_limits<float>::infinity(), ws, [&](uint32_t n, float)
+        {
+            found = n == target;
+            return !found;
+        });
+        if (!found)
+            return false;
+
+        ws.nodes.clear();
+        for (uint32_t n = static_cast<uint32_t>(target); n != UINT32_MAX; n = ws.parent[n])
+            ws.nodes.push_back(n);
+        std::reverse(ws.nodes.begin(), ws.nodes.end());
+
+        // Points of the grid path: from, the node centers, to. Index 0 and count - 1 are not nodes.
+        const size_t count = ws.nodes.size() + 2;
+        auto waypoint = [&](size_t i)
+        {
+            if (i == 0)
+                return NavWaypoint{ fromFloor, from };
+            if (i == count - 1)
+                return NavWaypoint{ toFloor, to };
+            return NavWaypoint{ graph.floorOf(ws.nodes[i - 1]), graph.position(ws.nodes[i - 1]) };
+        };
+
+        // Greedy shortening: from every anchor jump to the furthest point still visible on the same floor
+        length = 0.0f;
+        size_t anchor = 0;
+        NavWaypoint a = waypoint(0);
+        path.push_back(a);
+        while (anchor + 1 < count)
+        {
+            size_t next = anchor + 1;
+            NavWaypoint b = waypoint(next);
+            if (b.floor != a.floor)
+            {
+                // Connector between two nodes
+                length += graph.connectorCost(ws.nodes[anchor - 1], ws.nodes[next - 1]);
+            }
+            else
+            {
+                while (next + 1 < count)
+                {
+                    const NavWaypoint c = waypoint(next + 1);
+                    if (c.floor != a.floor || !graph.lineWalkable(a.floor, a.position, c.position))
+                        break;
+                    next++;
+                    b = c;
+                }
+                length += graph.lineCost(a.floor, a.position, b.position);
+            }
+
+            path.push_back(b);
+            anchor = next;
+            a = b;
+        }
+        return true;
+    }
+}
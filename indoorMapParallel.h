@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace Indoor::Map
+{
+    // Number of threads to use if the caller passes 0.
+    inline size_t defaultThreadCount()
+    {
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    // Splits [0, count) into contiguous chunks, one per thread, and calls func(begin, end, threadIndex) for each.
+    // The calling thread processes the first chunk. The first exception thrown by func is rethrown.
+    template<typename Func>
+    void parallelFor(size_t count, size_t threadCount, Func func)
+    {
+        if (threadCount == 0)
+            threadCount = defaultThreadCount();
+        threadCount = std::max<size_t>(1, std::min(threadCount, count));
+
+        if (threadCount == 1)
+        {
+            if (count > 0)
+                func(size_t(0), count, size_t(0));
+            return;
+        }
+
+        std::vector<std::exception_ptr> errors(threadCount);
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount - 1);
+
+        const size_t chunk = (count + threadCount - 1) / threadCount;
+        auto run = [&](size_t t)
+        {
+            const size_t begin = std::min(count, t * chunk);
+            const size_t end = std::min(count, begin + chunk);
+            try
+            {
+                if (begin < end)
+                    func(begin, end, t);
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            }
+        };
+
+        for (size_t t = 1; t < threadCount; t++)
+        {
+            threads.emplace_back(run, t);
+        }
+        run(0);
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (const std::exception_ptr& error : errors)
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    }
+}
@@ -3,16 +3,24 @@
 #include "rapidxml.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <memory>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <functional>
 #include <fstream>
 #include <exception>
+#include <cstdlib>
 
 #include "indoorMap.h"
+#include "indoorMapCompression.h"
+#include "indoorMapParallel.h"
+#include "indoorMapSchema.h"
+#include "indoorMapWallSegments.h"
 
 namespace Indoor::Map
 {
@@ -28,14 +36,161 @@ namespace Indoor::Map
         };
     };
 
+    enum class ParseErrorCode
+    {
+        None,
+        FileNotFound,
+        XmlSyntax,          // rapidxml rejected the document
+        MissingMapElement,  // no <map> root element
+        InvalidAttribute,   // a numeric or boolean attribute could not be decoded
+        UnsupportedCompression, // compressed input, but the library for the format is not enabled (see indoorMapCompression.h)
+        InvalidCompressedData,
+        OutOfMemory,
+        Unknown
+    };
+
+    // Describes why a document could not be parsed.
+    // The position is stored as byte offset into the document, line and column are only computed when requested.
+    class ParseError
+    {
+    public:
+        ParseErrorCode code = ParseErrorCode::None;
+
+        // Byte offset into the document where the error was detected.
+        size_t offset = 0;
+
+        // Static description of the error, never allocated.
+        const char* message = "";
+
+        ParseError() = default;
+
+        ParseError(ParseErrorCode code, size_t offset, const char* message)
+            : code(code), offset(offset), message(message)
+        {}
+
+        bool ok() const { return code == ParseErrorCode::None; }
+
+        // 1-based line of the error position or 0 if the document is not available.
+        size_t line() const
+        {
+            computePosition();
+            return cachedLine;
+        }
+
+        // 1-based column of the error position or 0 if the document is not available.
+        size_t column() const
+        {
+            computePosition();
+            return cachedColumn;
+        }
+
+    private:
+        friend class MapParser;
+
+        // Document the offset refers to. Only kept alive for failed parses.
+        std::shared_ptr<const std::string> source;
+
+        mutable size_t cachedLine = 0;
+        mutable size_t cachedColumn = 0;
+
+        void computePosition() const
+        {
+            if (cachedLine != 0 || !source)
+                return;
+
+            const size_t end = std::min(offset, source->size());
+            size_t line = 1;
+            size_t lineStart = 0;
+            for (size_t i = 0; i < end; i++)
+            {
+                if ((*source)[i] == '\n')
+                {
+                    line++;
+                    lineStart = i + 1;
+                }
+            }
+
+            cachedLine = line;
+            cachedColumn = end - lineStart + 1;
+        }
+    };
+
+    // Result of the exception-free parsing API. Holds either a map or an error.
+    struct ParseResult
+    {
+        std::shared_ptr<Map> map;
+        ParseError error;
+
+        bool ok() const { return error.ok() && map; }
+        explicit operator bool() const { return ok(); }
+    };
+
+    // Affine transformation of the map coordinates: p' = offset + rotate(scale * p), z' = scale * z + zOffset.
+    // Lengths (thickness, widths, radii, heights) are scaled, heights above the floor are not offset.
+    struct CoordinateTransform
+    {
+        Point2D offset;
+
+        // Counter-clockwise, in radians
+        float rotation = 0.0f;
+
+        // E.g. 0.01 for maps in centimeters, must be positive
+        float scale = 1.0f;
+
+        // Added to absolute heights: Floor::atHeight and the heights of the earth registration
+        float zOffset = 0.0f;
+
+        bool isIdentity() const
+        {
+            return offset == Point2D() && rotation == 0.0f && scale == 1.0f && zOffset == 0.0f;
+        }
+    };
+
+    struct ParseOptions
+    {
+        // Fill Wall::segments while parsing.
+        // If disabled, consumers which need segments call generateAllWallSegments() or wallSegments() (see indoorMapWallSegments.h).
+        bool generateWallSegments = true;
+
+        // Applied to every coordinate as it is decoded, including the map positions of the earth registration
+        CoordinateTransform transform;
+
+        // Threads building the XML DOM of the floors of large documents in parallel, 0 for all hardware threads.
+        // The result is the same as with a single thread, documents which cannot be split safely are parsed sequentially.
+        size_t parseThreads = 1;
+    };
+
     // The actual parser.
     // You can use readMapFromFile() to simply obtain a Map object.
     // Or use readFromFile() with any IndoorListener implementation for custom logic. (see indoorSvgListener.h)
+    // The try* methods do not throw and do not print, errors are reported as ParseError instead.
     class MapParser
     {
     private:
         std::shared_ptr<IndoorListener> listener;
 
+        // Start of the document currently parsed, used to compute error offsets.
+        const char* documentBegin = nullptr;
+
+        // First error of the current parse.
+        ParseError error;
+
+        // Pieces of the document which were copied and tokenized separately, used to compute error offsets
+        struct DocumentPart
+        {
+            const char* begin;
+            const char* end;
+            size_t offset;
+        };
+        std::vector<DocumentPart> documentParts;
+
+        ParseOptions options;
+
+        // Rotation of options.transform, computed once
+        bool transformIdentity = true;
+        float transformCos = 1.0f;
+        float transformSin = 0.0f;
+
         using xml_node = rapidxml::xml_node<>;
         using xml_attribute = rapidxml::xml_attribute<>;
 
@@ -45,6 +200,14 @@ namespace Indoor::Map
 
         }
 
+        explicit MapParser(const ParseOptions& options)
+            : options(options)
+        {
+            transformIdentity = options.transform.isIdentity();
+            transformCos = std::cos(options.transform.rotation);
+            transformSin = std::sin(options.transform.rotation);
+        }
+
         std::shared_ptr<Map> readMapFromFile(const std::string& filename)
         {
             auto mapListener = std::make_shared<MapListener>();
@@ -56,30 +219,37 @@ namespace Indoor::Map
 
         void readFromFile(const std::string& filename, std::shared_ptr<IndoorListener> listener)
         {
-            if (!listener)
-                listener = std::make_shared<IndoorListener>(); // create a nop listener
-
-            this->listener = listener;
-
-            std::ifstream fileStream(filename);
-            if (fileStream.is_open())
+            std::string fileContent;
+            const ParseError readError = readFileContent(filename, fileContent);
+            if (readError.ok())
             {
-                std::stringstream fileBuffer;
-                fileBuffer << fileStream.rdbuf();
-                std::string fileContent = fileBuffer.str();
-
                 try
                 {
-                    rapidxml::xml_document xmlDoc;
-                    xmlDoc.parse<0>(fileContent.data());
-                    xml_node* xMap = xmlDoc.first_node("map");
-                    processMap(xMap);
+                    parseDocument(fileContent, listener);
                 }
                 catch (const rapidxml::parse_error& e)
                 {
                     std::cout << "XML Parser error: " << e.what() << std::endl;
                     throw;
                 }
+
+                if (!error.ok())
+                {
+                    attachFileSource(error, filename);
+
+                    std::stringstream msg;
+                    msg << "Indoor map file '" << filename << "': " << error.message
+                        << " at line " << error.line() << ", column " << error.column() << "\n";
+
+                    throw std::invalid_argument(msg.str());
+                }
+            }
+            else if (readError.code != ParseErrorCode::FileNotFound)
+            {
+                std::stringstream msg;
+                msg << "Indoor map file '" << filename << "': " << readError.message << "\n";
+
+                throw std::invalid_argument(msg.str());
             }
             else
             {
@@ -91,66 +261,481 @@ namespace Indoor::Map
                 throw std::runtime_error(msg.str().c_str());
             }
         }
+
+        ParseResult tryReadMapFromFile(const std::string& filename) noexcept
+        {
+            ParseResult result;
+            try
+            {
+                auto mapListener = std::make_shared<MapListener>();
+                result.error = tryReadFromFile(filename, mapListener);
+                result.map = mapListener->map;
+            }
+            catch (...)
+            {
+                result.error = ParseError(ParseErrorCode::OutOfMemory, 0, "Out of memory");
+            }
+            return result;
+        }
+
+        ParseResult tryReadMapFromString(const std::string& content) noexcept
+        {
+            ParseResult result;
+            try
+            {
+                auto mapListener = std::make_shared<MapListener>();
+                result.error = tryReadFromString(content, mapListener);
+                result.map = mapListener->map;
+            }
+            catch (...)
+            {
+                result.error = ParseError(ParseErrorCode::OutOfMemory, 0, "Out of memory");
+            }
+            return result;
+        }
+
+        ParseError tryReadFromFile(const std::string& filename, std::shared_ptr<IndoorListener> listener) noexcept
+        {
+            try
+            {
+                std::string fileContent;
+                const ParseError readError = readFileContent(filename, fileContent);
+                if (!readError.ok())
+                {
+                    return readError;
+                }
+
+                ParseError result = parseContent(fileContent, listener);
+                if (!result.ok())
+                {
+                    attachFileSource(result, filename);
+                }
+                return result;
+            }
+            catch (...)
+            {
+                return ParseError(ParseErrorCode::OutOfMemory, 0, "Out of memory");
+            }
+        }
+
+        // The content is parsed in a working copy, compressed content (gzip, zstd) is decompressed into it.
+        // If parsing fails, the returned error keeps a copy of the content for its line and column.
+        ParseError tryReadFromString(const std::string& content, std::shared_ptr<IndoorListener> listener) noexcept
+        {
+            try
+            {
+                const CompressionFormat format = detectCompression(content.data(), content.size());
+                std::string work;
+                if (format != CompressionFormat::None)
+                {
+                    const ParseError decompressError = decompressionError(decompressBuffer(content.data(), content.size(), format, work));
+                    if (!decompressError.ok())
+                        return decompressError;
+                }
+                else
+                {
+                    work = content;
+                }
+
+                ParseError result = parseContent(work, listener);
+                if (!result.ok())
+                {
+                    attachStringSource(result, content, format);
+                }
+                return result;
+            }
+            catch (const std::bad_alloc&)
+            {
+                return ParseError(ParseErrorCode::OutOfMemory, 0, "Out of memory");
+            }
+        }
         
     private:
-        static bool tryGetAttribute(const xml_node* node, const std::string& attName, char** value)
+        // Parses the content in place. The returned error has no source yet, line and column have to be
+        // computed on the unmodified content.
+        ParseError parseContent(std::string& content, std::shared_ptr<IndoorListener> listener) noexcept
+        {
+            try
+            {
+                try
+                {
+                    parseDocument(content, listener);
+                }
+                catch (const rapidxml::parse_error& e)
+                {
+                    // rapidxml has no recoverable error mode, its parse_error is translated here.
+                    error = ParseError(ParseErrorCode::XmlSyntax, static_cast<size_t>(e.where<char>() - content.data()), e.what());
+                }
+                return error;
+            }
+            catch (const std::bad_alloc&)
+            {
+                return ParseError(ParseErrorCode::OutOfMemory, 0, "Out of memory");
+            }
+            catch (...)
+            {
+                // thrown by a listener
+                return ParseError(ParseErrorCode::Unknown, 0, "Unknown error");
+            }
+        }
+
+        // The parsed content was modified in place, the file is read again to locate the error.
+        // Only failed parses pay for it.
+        static void attachFileSource(ParseError& result, const std::string& filename)
         {
-            xml_attribute* att = node->first_attribute(attName.c_str());
+            try
+            {
+                auto source = std::make_shared<std::string>();
+                if (readFileContent(filename, *source).ok())
+                    result.source = std::move(source);
+            }
+            catch (const std::bad_alloc&)
+            {
+                // line and column stay 0
+            }
+        }
 
-            if (att)
+        // Same for content given as string, compressed content is decompressed again
+        static void attachStringSource(ParseError& result, const std::string& content, CompressionFormat format)
+        {
+            try
             {
-                *value = att->value();
-                return true;
+                if (format == CompressionFormat::None)
+                {
+                    result.source = std::make_shared<const std::string>(content);
+                    return;
+                }
+
+                auto source = std::make_shared<std::string>();
+                if (decompressBuffer(content.data(), content.size(), format, *source) == DecompressStatus::Ok)
+                    result.source = std::move(source);
             }
+            catch (const std::bad_alloc&)
+            {
+                // line and column stay 0
+            }
+        }
 
-            return false;
+        static ParseError decompressionError(DecompressStatus status)
+        {
+            switch (status)
+            {
+            case DecompressStatus::Ok: return ParseError();
+            case DecompressStatus::Unsupported: return ParseError(ParseErrorCode::UnsupportedCompression, 0, "Compression format not supported");
+            case DecompressStatus::ReadError: return ParseError(ParseErrorCode::FileNotFound, 0, "Indoor map file could not be read");
+            default: return ParseError(ParseErrorCode::InvalidCompressedData, 0, "Invalid compressed data");
+            }
+        }
+
+        // Compressed files (gzip, zstd) are detected by their magic bytes and decompressed while they are read
+        static ParseError readFileContent(const std::string& filename, std::string& content)
+        {
+            std::ifstream fileStream(filename, std::ios::binary);
+            if (!fileStream.is_open())
+                return ParseError(ParseErrorCode::FileNotFound, 0, "Indoor map file not found");
+
+            fileStream.seekg(0, std::ios::end);
+            const std::streamoff size = fileStream.tellg();
+            fileStream.seekg(0, std::ios::beg);
+
+            char magic[4] = {};
+            fileStream.read(magic, sizeof(magic));
+            const CompressionFormat format = detectCompression(magic, static_cast<size_t>(fileStream.gcount()));
+            fileStream.clear();
+            fileStream.seekg(0, std::ios::beg);
+
+            if (format != CompressionFormat::None)
+            {
+                // The XML compresses about 10:1
+                return decompressionError(decompressStream(fileStream, format, content, static_cast<size_t>(size) * 12));
+            }
+
+            if (size > 0)
+            {
+                content.resize(static_cast<size_t>(size));
+                fileStream.read(&content[0], size);
+                content.resize(static_cast<size_t>(fileStream.gcount()));
+            }
+
+            return ParseError();
         }
 
-        static float floatAttribute(const xml_node* node, const std::string& attName, float defaultValue = 0.0f)
+        // Parses the document in place. Throws rapidxml::parse_error on malformed XML.
+        void parseDocument(std::string& content, std::shared_ptr<IndoorListener> listener)
         {
-            char* v;
-            if (tryGetAttribute(node, attName, &v))
+            if (!listener)
+                listener = std::make_shared<IndoorListener>(); // create a nop listener
+
+            this->listener = listener;
+            this->error = ParseError();
+
+            // std::string is zero terminated as required by rapidxml
+            this->documentBegin = content.data();
+            this->documentParts.clear();
+
+            const size_t threads = options.parseThreads == 0 ? defaultThreadCount() : options.parseThreads;
+            if (threads > 1 && content.size() >= ParallelParseMinSize)
+            {
+                SplitDocument split;
+                if (tokenizeParallel(content, threads, split))
+                {
+                    processMap(split.map);
+                    documentParts.clear();
+                    return;
+                }
+            }
+
+            rapidxml::xml_document xmlDoc;
+            xmlDoc.parse<0>(&content[0]);
+
+            xml_node* xMap = xmlDoc.first_node("map");
+            if (xMap)
+            {
+                processMap(xMap);
+            }
+            else
             {
-                return std::stof(v);
+                setError(ParseErrorCode::MissingMapElement, content.data() + content.size(), "Missing <map> element");
             }
+        }
+
+        // Smaller documents are not worth splitting
+        static constexpr size_t ParallelParseMinSize = size_t(1) << 20;
+
+        // Byte range [begin, end) of the document
+        struct ElementRange
+        {
+            size_t begin = 0;
+            size_t end = 0;
+        };
 
-            return defaultValue;
+        // Document tokenized as a skeleton without the floors and one DOM per floor, all floors appended to <floors>
+        struct SplitDocument
+        {
+            std::string skeleton;
+            rapidxml::xml_document<> skeletonDoc;
+            std::vector<std::string> fragments;
+            std::vector<std::unique_ptr<rapidxml::xml_document<>>> floorDocs;
+            xml_node* map = nullptr;
+        };
+
+        static bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
         }
 
-        static int intAttribute(const xml_node* node, const std::string& attName, int defaultValue = 0)
+        // Whether the element <name starts at pos
+        static bool isStartTag(std::string_view text, size_t pos, std::string_view name)
         {
-            char* v;
-            if (tryGetAttribute(node, attName, &v))
+            const size_t after = pos + 1 + name.size();
+            if (after >= text.size() || text[pos] != '<' || text.compare(pos + 1, name.size(), name) != 0)
+                return false;
+            const char c = text[after];
+            return c == '>' || c == '/' || isSpace(c);
+        }
+
+        // Position after the '>' of the tag starting at pos, quoted attribute values may contain '>'
+        static size_t endOfTag(std::string_view text, size_t pos)
+        {
+            char quote = 0;
+            for (size_t i = pos; i < text.size(); i++)
             {
-                return std::stoi(v);
+                const char c = text[i];
+                if (quote)
+                    quote = c == quote ? 0 : quote;
+                else if (c == '"' || c == '\'')
+                    quote = c;
+                else if (c == '>')
+                    return i + 1;
             }
+            return std::string_view::npos;
+        }
+
+        // Speculative pre-scan for the <floor> elements of <floors>: the range of the <floors> content and of every floor.
+        // Returns false if the layout is not plain enough to be split safely (comments, CDATA, processing instructions
+        // or other content within <floors>), the document is then parsed sequentially.
+        static bool scanFloors(std::string_view text, size_t& floorsTag, ElementRange& floorsContent, std::vector<ElementRange>& floors)
+        {
+            const size_t npos = std::string_view::npos;
+
+            floorsTag = text.find("<floors");
+            while (floorsTag != npos && !isStartTag(text, floorsTag, "floors"))
+                floorsTag = text.find("<floors", floorsTag + 1);
+            if (floorsTag == npos)
+                return false;
+
+            const size_t open = endOfTag(text, floorsTag);
+            if (open == npos || text[open - 2] == '/')
+                return false;
+
+            floorsContent.begin = open;
+            size_t pos = open;
+            while (true)
+            {
+                while (pos < text.size() && isSpace(text[pos]))
+                    pos++;
+                if (pos >= text.size())
+                    return false;
 
-            return defaultValue;
+                if (text.compare(pos, 9, "</floors>") == 0)
+                {
+                    floorsContent.end = pos;
+                    break;
+                }
+                if (!isStartTag(text, pos, "floor"))
+                    return false;
+
+                ElementRange floor;
+                floor.begin = pos;
+                size_t end = endOfTag(text, pos);
+                if (end == npos)
+                    return false;
+
+                if (text[end - 2] != '/')
+                {
+                    size_t close = text.find("</floor", end);
+                    while (close != npos && close + 7 < text.size() && text[close + 7] != '>' && !isSpace(text[close + 7]))
+                        close = text.find("</floor", close + 1);
+                    if (close == npos || (end = text.find('>', close)) == npos)
+                        return false;
+                    end++;
+                }
+
+                floor.end = end;
+                floors.push_back(floor);
+                pos = end;
+            }
+
+            // Comments and CDATA could contain element-like text
+            return !floors.empty()
+                && text.substr(0, floorsContent.end).find("<!") == npos
+                && text.substr(floorsContent.begin, floorsContent.end - floorsContent.begin).find("<?") == npos;
         }
 
-        static bool boolAttribute(const xml_node* node, const std::string& attName, bool defaultValue = false)
+        // Tokenizes the floors on separate threads and the rest of the document as skeleton, then appends the floor
+        // elements to the skeleton's <floors>. The content is not modified. Returns false if the document
+        // cannot be split or any piece fails to tokenize, the caller then parses sequentially.
+        bool tokenizeParallel(const std::string& content, size_t threads, SplitDocument& split)
         {
-            char* v;
-            if (tryGetAttribute(node, attName, &v))
+            size_t floorsTag;
+            ElementRange floorsContent;
+            std::vector<ElementRange> floors;
+            if (!scanFloors(content, floorsTag, floorsContent, floors))
+                return false;
+
+            // Largest floors first, handed out dynamically
+            std::vector<size_t> order(floors.size());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return floors[a].end - floors[a].begin > floors[b].end - floors[b].begin; });
+
+            split.fragments.resize(floors.size());
+            split.floorDocs.resize(floors.size());
+            std::vector<char> ok(floors.size(), 0);
+            std::atomic<size_t> next{ 0 };
+
+            parallelFor(std::min(threads, floors.size()), threads, [&](size_t, size_t, size_t)
             {
-                bool result;
-                std::istringstream buffer(v);
-                buffer >> std::boolalpha >> result;
-                return result;
+                for (size_t k = next++; k < order.size(); k = next++)
+                {
+                    const size_t i = order[k];
+                    try
+                    {
+                        split.fragments[i].assign(content, floors[i].begin, floors[i].end - floors[i].begin);
+                        split.floorDocs[i] = std::make_unique<rapidxml::xml_document<>>();
+                        split.floorDocs[i]->parse<0>(&split.fragments[i][0]);
+
+                        // Exactly the floor element, otherwise the scan was misled
+                        const xml_node* root = split.floorDocs[i]->first_node();
+                        ok[i] = root && root->type() == rapidxml::node_element && std::strcmp(root->name(), "floor") == 0 && !root->next_sibling();
+                    }
+                    catch (...)
+                    {
+                        ok[i] = 0;
+                    }
+                }
+            });
+
+            if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+                return false;
+
+            split.skeleton.reserve(content.size() - (floorsContent.end - floorsContent.begin));
+            split.skeleton.append(content, 0, floorsContent.begin);
+            split.skeleton.append(content, floorsContent.end, std::string::npos);
+            try
+            {
+                split.skeletonDoc.parse<0>(&split.skeleton[0]);
+            }
+            catch (const rapidxml::parse_error&)
+            {
+                return false;
+            }
+
+            // The <floors> found by the scan must be the one the parser uses
+            split.map = split.skeletonDoc.first_node("map");
+            xml_node* xFloors = split.map ? split.map->first_node("floors") : nullptr;
+            if (!xFloors || xFloors->name() != split.skeleton.data() + floorsTag + 1)
+                return false;
+
+            for (const auto& doc : split.floorDocs)
+            {
+                xml_node* floor = doc->first_node();
+                doc->remove_first_node();
+                xFloors->append_node(floor);
+            }
+
+            const char* skeleton = split.skeleton.data();
+            documentParts.push_back({ skeleton, skeleton + floorsContent.begin, 0 });
+            documentParts.push_back({ skeleton + floorsContent.begin, skeleton + split.skeleton.size() + 1, floorsContent.end });
+            for (size_t i = 0; i < floors.size(); i++)
+            {
+                const char* fragment = split.fragments[i].data();
+                documentParts.push_back({ fragment, fragment + split.fragments[i].size() + 1, floors[i].begin });
             }
+            return true;
+        }
 
-            return defaultValue;
+        bool failed() const
+        {
+            return !error.ok();
+        }
+
+        void setError(ParseErrorCode code, const char* where, const char* message)
+        {
+            if (error.ok())
+            {
+                size_t offset = static_cast<size_t>(where - documentBegin);
+                for (const DocumentPart& part : documentParts)
+                {
+                    if (where >= part.begin && where < part.end)
+                        offset = part.offset + static_cast<size_t>(where - part.begin);
+                }
+                error = ParseError(code, offset, message);
+            }
         }
 
-        static std::string strAttribute(const xml_node* node, const std::string& attName, std::string defaultValue = "")
+        // Units of the schema fields (see indoorMapSchema.h), applies options.transform
+        struct AttributeContext
         {
-            char* v;
-            if (tryGetAttribute(node, attName, &v))
+            MapParser* parser;
+
+            Point2D point(float x, float y) const { return parser->point(x, y); }
+            float length(float value) const { return parser->length(value); }
+            float height(float z) const { return parser->height(z); }
+            float degrees(float angle) const { return angle + parser->options.transform.rotation * 180.0f / 3.14159265f; }
+
+            void error(const char* where, const char* message)
             {
-                return std::string(v);
+                parser->setError(ParseErrorCode::InvalidAttribute, where, message);
             }
+        };
 
-            return defaultValue;
+        // Decodes the attributes of the node into object as described by Schema<T>
+        template<typename T>
+        void decode(const xml_node* node, T& object)
+        {
+            AttributeContext context{ this };
+            decodeAttributes(node, object, context);
         }
 
         static void foreachNode(xml_node* node, const std::function<void(xml_node* e)> action)
@@ -174,8 +759,7 @@ namespace Indoor::Map
         void processMap(xml_node* xMap)
         {
             Map map;
-            map.width = floatAttribute(xMap, "width");
-            map.depth = floatAttribute(xMap, "depth");
+            decode(xMap, map);
 
             listener->enterMap(map);
             
@@ -189,6 +773,9 @@ namespace Indoor::Map
             if (xFloors)
             {
                 foreachNode(xFloors, "floor", [this, &map](xml_node* e) {
+                    if (failed())
+                        return;
+
                     Floor floor;
                     if (processFloor(e, floor))
                     {
@@ -197,7 +784,11 @@ namespace Indoor::Map
                 });
             }
 
-            listener->leaveMap(map);
+            // An incomplete map is not reported to the listener
+            if (!failed())
+            {
+                listener->leaveMap(map);
+            }
         }
 
         EarthRegistration processEarthRegistration(xml_node* xEarthReg)
@@ -212,13 +803,7 @@ namespace Indoor::Map
                 foreachNode(xCorrespondences, "point", [this, &earthReg](xml_node* e)
                 {
                     EarthPosMapPos pos;
-                    pos.lat = floatAttribute(e, "lat");
-                    pos.lon = floatAttribute(e, "lon");
-                    pos.alt = floatAttribute(e, "alt");
-
-                    pos.x = floatAttribute(e, "mx");
-                    pos.y = floatAttribute(e, "my");
-                    pos.z = floatAttribute(e, "mz");
+                    decode(e, pos);
 
                     this->listener->enterEarthPosMapPos(pos);
                     earthReg.correspondences.push_back(pos);
@@ -232,9 +817,7 @@ namespace Indoor::Map
 
         bool processFloor(xml_node* xFloor, Floor& floor)
         {
-            floor.atHeight = floatAttribute(xFloor,"atHeight");
-            floor.height = floatAttribute(xFloor, "height");
-            floor.name = strAttribute(xFloor, "name");
+            decode(xFloor, floor);
 
             if (!listener->enterFloor(floor))
             {
@@ -311,15 +894,12 @@ namespace Indoor::Map
                 foreachNode(xOutline, "polygon", [this, &outline](xml_node* xPolygon)
                 {
                     Polygon2D polygon;
-                    polygon.name = strAttribute(xPolygon, "name");
-                    polygon.method = (PolygonMethod)intAttribute(xPolygon, "method");
-                    polygon.isOutdoor = boolAttribute(xPolygon, "outdoor");
-
-                    foreachNode(xPolygon, "point", [&polygon](xml_node* xPoint) {
-                        float x = floatAttribute(xPoint, "x");
-                        float y = floatAttribute(xPoint, "y");
+                    decode(xPolygon, polygon);
 
-                        polygon.points.push_back(Point2D(x, y));
+                    foreachNode(xPolygon, "point", [this, &polygon](xml_node* xPoint) {
+                        Point2D point;
+                        decode(xPoint, point);
+                        polygon.points.push_back(point);
                     });
 
                     outline.polygons.push_back(polygon);
@@ -333,13 +913,10 @@ namespace Indoor::Map
         void processPointOfInterests(xml_node* xPois, std::vector<PointOfInterest>& pois)
         {
             listener->enterPointOfInterests(pois);
-            foreachNode(xPois, "poi", [&pois](xml_node* xPoi)
+            foreachNode(xPois, "poi", [this, &pois](xml_node* xPoi)
             {
                 PointOfInterest poi;
-                poi.name = strAttribute(xPoi, "name");
-                poi.type = (POIType)intAttribute(xPoi, "type");
-                poi.x = floatAttribute(xPoi, "x");
-                poi.y = floatAttribute(xPoi, "y");
+                decode(xPoi, poi);
 
                 pois.push_back(poi);
             });
@@ -350,13 +927,10 @@ namespace Indoor::Map
         void processGroundtruthPoints(xml_node* xGT, Floor& floor)
         {
             listener->enterGrundtruthPoints(floor.groundtruthPoints);
-            foreachNode(xGT, "gtpoint", [&floor](xml_node* xGTpoint)
+            foreachNode(xGT, "gtpoint", [this, &floor](xml_node* xGTpoint)
             {
                 GroundtruthPoint gtPoint;
-                gtPoint.id = intAttribute(xGTpoint, "id");
-                gtPoint.x = floatAttribute(xGTpoint, "x");
-                gtPoint.y = floatAttribute(xGTpoint, "y");
-                gtPoint.heightAboveFloor = floatAttribute(xGTpoint, "z");
+                decode(xGTpoint, gtPoint);
 
                 gtPoint.z = floor.atHeight + gtPoint.heightAboveFloor;
 
@@ -368,21 +942,13 @@ namespace Indoor::Map
         void processAccessPoints(xml_node* xAP, Floor& floor)
         {
             listener->enterAccessPoints(floor.accessPoints);
-            foreachNode(xAP, "accesspoint", [&floor](xml_node* xAccessPoint)
+            foreachNode(xAP, "accesspoint", [this, &floor](xml_node* xAccessPoint)
             {
                 AccessPoint ap;
-                ap.name = strAttribute(xAccessPoint, "name");
-                ap.macAddress = strAttribute(xAccessPoint, "mac");
-                ap.x = floatAttribute(xAccessPoint, "x");
-                ap.y = floatAttribute(xAccessPoint, "y");
-                ap.heightAboveFloor = floatAttribute(xAccessPoint, "z");
+                decode(xAccessPoint, ap);
 
                 ap.z = floor.atHeight + ap.heightAboveFloor;
 
-                ap.mdl_txp = floatAttribute(xAccessPoint, "mdl_txp");
-                ap.mdl_exp = floatAttribute(xAccessPoint, "mdl_exp");
-                ap.mdl_waf = floatAttribute(xAccessPoint, "mdl_waf");
-
                 floor.accessPoints.push_back(ap);
             });
             listener->leaveAccessPoints(floor.accessPoints);
@@ -391,25 +957,12 @@ namespace Indoor::Map
         void processBeacons(xml_node* xBeacons, Floor& floor)
         {
             listener->enterBeacons(floor.beacons);
-            foreachNode(xBeacons, "beacon", [&floor](xml_node* xBeacon) {
+            foreachNode(xBeacons, "beacon", [this, &floor](xml_node* xBeacon) {
                 Beacon b;
-                b.name = strAttribute(xBeacon, "name");
-                b.macAddress = strAttribute(xBeacon, "mac");
-                b.uuid = strAttribute(xBeacon, "uuid");
-
-                b.major = strAttribute(xBeacon, "major");
-                b.minor = strAttribute(xBeacon, "minor");
-                
-                b.x = floatAttribute(xBeacon, "x");
-                b.y = floatAttribute(xBeacon, "y");
-                b.heightAboveFloor = floatAttribute(xBeacon, "z");
+                decode(xBeacon, b);
 
                 b.z = floor.atHeight + b.heightAboveFloor;
 
-                b.mdl_txp = floatAttribute(xBeacon, "mdl_txp");
-                b.mdl_exp = floatAttribute(xBeacon, "mdl_exp");
-                b.mdl_waf = floatAttribute(xBeacon, "mdl_waf");
-
                 floor.beacons.push_back(b);
             });
             listener->leaveBeacons(floor.beacons);
@@ -418,13 +971,9 @@ namespace Indoor::Map
         void processFingerprints(xml_node* xFingerprints, Floor& floor)
         {
             listener->enterFingerprintLocations(floor.fingerprintLocations);
-            foreachNode(xFingerprints, "location", [&floor](xml_node* xLocation) {
+            foreachNode(xFingerprints, "location", [this, &floor](xml_node* xLocation) {
                 FingerprintLocation fl;
-                fl.name = strAttribute(xLocation, "name");
-
-                fl.x = floatAttribute(xLocation, "x");
-                fl.y = floatAttribute(xLocation, "y");
-                fl.heightAboveFloor = floatAttribute(xLocation, "dz");
+                decode(xLocation, fl);
 
                 fl.z = floor.atHeight + fl.heightAboveFloor;
 
@@ -434,110 +983,15 @@ namespace Indoor::Map
             listener->leaveFingerprintLocations(floor.fingerprintLocations);
         }
 
-        // Converts Walls to wall segments.
-        // This method assumes that doors and windows do not overlap!
-        void generateWallSegments(Wall& wall)
-        {
-            if (wall.doors.size() == 0 && wall.windows.size() == 0)
-            {
-                wall.segments.push_back(WallSegment2D(WallSegmentType::Wall, -1, wall.start(), wall.end()));
-                return;
-            }
-
-            std::vector<WallSegment2D> segments;
-
-            // Generate door segments
-            for (size_t i = 0; i < wall.doors.size(); i++)
-            {
-                const WallDoor& door = wall.doors[i];
-
-                WallSegment2D segDoor(WallSegmentType::Door, static_cast<int>(i));
-
-                const Point2D dir = wall.end() - wall.start();
-
-                segDoor.start = wall.start() + dir * door.atLinePos;
-                segDoor.end = segDoor.start + dir.normalized() * (door.leftRight ? -door.width : +door.width);
-
-                if (door.leftRight)
-                    std::swap(segDoor.start, segDoor.end);
-
-                segments.push_back(segDoor);
-            }
-
-            // Generate window segments
-            for (size_t i = 0; i < wall.windows.size(); i++)
-            {
-                const WallWindow& window = wall.windows[i];
-
-                WallSegment2D segWindow(WallSegmentType::Window, static_cast<int>(i));
-
-                const Point2D dir = wall.end() - wall.start();
-                const Point2D center = wall.start() + dir * window.atLinePos;
-
-                segWindow.start = center - dir.normalized() * window.width/2.0f;
-                segWindow.end   = center + dir.normalized() * window.width/2.0f;
-
-                segments.push_back(segWindow);
-            }
-
-            // Order by relative position
-            std::sort(segments.begin(), segments.end(), [&wall](WallSegment2D& a, WallSegment2D& b) {
-                return (a.start-wall.start()).length() < (b.start-wall.start()).length();
-            });
-
-
-            Point2D wStart = wall.start();
-            Point2D wEnd = wall.end();
-
-            // Connect door/window segments with wall segments
-            for (size_t i = 0; i < segments.size(); i++)
-            {
-                if (i == 0)
-                {
-                    // First wall segment
-                    wall.segments.push_back(WallSegment2D(WallSegmentType::Wall, -1, wStart, segments[i].start));
-                }
-
-                // Door or window
-                wall.segments.push_back(segments[i]);
-
-                if (i < segments.size()-1)
-                {
-                    // Connection wall
-                    wall.segments.push_back(WallSegment2D(WallSegmentType::Wall, -1, segments[i].end, segments[i+1].start));
-                }
-                else
-                {
-                    // Last wall segment
-                    wall.segments.push_back(WallSegment2D(WallSegmentType::Wall, -1, segments[i].end, wEnd));
-                }
-            }
-        }
-
         void processObstacles(xml_node* xObstacles, Floor& floor)
         {
-            // Other obstacles: line, circle, door, object
-            // atm only walls are parsed.
-
+            // Walls first, then the other obstacles: line, circle, door, object
             listener->enterWalls(floor.walls);
             foreachNode(xObstacles, "wall", [this, &floor](xml_node* xWall) {
                 Wall wall;
+                decode(xWall, wall);
 
-                wall.material = (WallMaterial)intAttribute(xWall, "material");
-                wall.type = (ObstacleType)intAttribute(xWall, "type");
-
-                wall.x1 = floatAttribute(xWall, "x1");
-                wall.y1 = floatAttribute(xWall, "y1");
-                wall.x2 = floatAttribute(xWall, "x2");
-                wall.y2 = floatAttribute(xWall, "y2");
-
-                wall.height = floatAttribute(xWall, "height", NAN);
-                if (std::isnan(wall.height) || wall.height == 0.0f)
-                {
-                    wall.height = floor.height;
-                }
-
-                wall.thickness = floatAttribute(xWall, "thickness", NAN);
+                wall.height = obstacleHeight(wall.height, floor);
                 if (std::isnan(wall.thickness))
                 {
                     wall.thickness = 0.15f;
@@ -545,19 +999,10 @@ namespace Indoor::Map
 
                 if (this->listener->enterWall(wall))
                 {
-                    floor.walls.push_back(wall);
-
                     // Doors
                     foreachNode(xWall, "door", [this, &wall](xml_node* xDoor) {
                         WallDoor door;
-
-                        door.type = (DoorType)intAttribute(xDoor, "type");
-                        door.material = (WallMaterial)intAttribute(xDoor, "material");
-                        door.atLinePos = floatAttribute(xDoor, "x01");
-                        door.width = floatAttribute(xDoor, "width");
-                        door.height = floatAttribute(xDoor, "heigth");
-                        door.leftRight = boolAttribute(xDoor, "lr");
-                        door.inOut = boolAttribute(xDoor, "io");
+                        decode(xDoor, door);
 
                         if (this->listener->enterWallDoor(door))
                         {
@@ -569,14 +1014,7 @@ namespace Indoor::Map
                     // Windows
                     foreachNode(xWall, "window", [this, &wall](xml_node* xWindow) {
                         WallWindow window;
-
-                        // window.type = xWindow->IntAttribute("type");
-                        window.material = (WallMaterial)intAttribute(xWindow, "material");
-                        window.atLinePos = floatAttribute(xWindow, "x01");
-                        window.atHeigth = floatAttribute(xWindow, "y");
-                        window.width = floatAttribute(xWindow, "width");
-                        window.height = floatAttribute(xWindow, "height");
-                        window.inOut = boolAttribute(xWindow, "io");
+                        decode(xWindow, window);
 
                         if (this->listener->enterWallWindow(window))
                         {
@@ -585,11 +1023,117 @@ namespace Indoor::Map
                         }
                     });
 
-                    this->generateWallSegments(wall);
+                    if (options.generateWallSegments)
+                        generateWallSegments(wall);
+
+                    floor.walls.push_back(wall);
                     this->listener->leaveWall(wall);
                 }
             });
             listener->leaveWalls(floor.walls);
+
+            foreachNode(xObstacles, "line", [this, &floor](xml_node* xLine) {
+                LineObstacle line;
+                decode(xLine, line);
+
+                line.height = obstacleHeight(line.height, floor);
+                if (std::isnan(line.thickness))
+                {
+                    line.thickness = 0.15f;
+                }
+
+                if (this->listener->enterLineObstacle(line))
+                {
+                    floor.lineObstacles.push_back(line);
+                    this->listener->leaveLineObstacle(line);
+                }
+            });
+
+            foreachNode(xObstacles, "circle", [this, &floor](xml_node* xCircle) {
+                CircleObstacle circle;
+                decode(xCircle, circle);
+
+                circle.height = obstacleHeight(circle.height, floor);
+
+                if (this->listener->enterCircleObstacle(circle))
+                {
+                    floor.circleObstacles.push_back(circle);
+                    this->listener->leaveCircleObstacle(circle);
+                }
+            });
+
+            foreachNode(xObstacles, "door", [this, &floor](xml_node* xDoor) {
+                DoorObstacle door;
+                decode(xDoor, door);
+
+                door.height = obstacleHeight(door.height, floor);
+
+                if (this->listener->enterDoorObstacle(door))
+                {
+                    floor.doorObstacles.push_back(door);
+                    this->listener->leaveDoorObstacle(door);
+                }
+            });
+
+            foreachNode(xObstacles, "object", [this, &floor](xml_node* xObject) {
+                ObjectObstacle object;
+                decode(xObject, object);
+
+                foreachNode(xObject, "point", [this, &object](xml_node* xPoint) {
+                    Point2D point;
+                    decode(xPoint, point);
+                    object.footprint.push_back(point);
+                });
+
+                if (object.footprint.empty())
+                {
+                    // The model is not loaded, assume a unit square centered at the position
+                    const float angle = object.rz * 3.14159265f / 180.0f;
+                    const float c = std::cos(angle), s = std::sin(angle);
+                    for (const Point2D& corner : { Point2D(-0.5f, -0.5f), Point2D(0.5f, -0.5f), Point2D(0.5f, 0.5f), Point2D(-0.5f, 0.5f) })
+                    {
+                        const float x = corner.x * object.sx;
+                        const float y = corner.y * object.sy;
+                        object.footprint.push_back(Point2D(object.x + c * x - s * y, object.y + s * x + c * y));
+                    }
+                }
+
+                if (this->listener->enterObjectObstacle(object))
+                {
+                    floor.objectObstacles.push_back(object);
+                    this->listener->leaveObjectObstacle(object);
+                }
+            });
+        }
+
+        // Decoded height of an obstacle, the floor's height is used if it is missing or zero
+        static float obstacleHeight(float height, const Floor& floor)
+        {
+            return (std::isnan(height) || height == 0.0f) ? floor.height : height;
+        }
+
+        // Position in map coordinates, see ParseOptions::transform
+        Point2D point(float x, float y) const
+        {
+            if (transformIdentity)
+                return Point2D(x, y);
+
+            const CoordinateTransform& t = options.transform;
+            x *= t.scale;
+            y *= t.scale;
+            return Point2D(t.offset.x + transformCos * x - transformSin * y, t.offset.y + transformSin * x + transformCos * y);
+        }
+
+        // Distances and heights relative to the floor
+        float length(float value) const
+        {
+            return transformIdentity ? value : value * options.transform.scale;
+        }
+
+        // Absolute heights
+        float height(float z) const
+        {
+            return transformIdentity ? z : z * options.transform.scale + options.transform.zOffset;
         }
     };
 
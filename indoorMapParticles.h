@@ -0,0 +1,398 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapParallel.h"
+#include "indoorMapWallIndex.h"
+
+namespace Indoor::Map
+{
+    // Particles in structure-of-arrays layout, all vectors have the same size.
+    struct ParticleSet
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+
+        // Radians, counter-clockwise from the x axis
+        std::vector<float> heading;
+        std::vector<float> weight;
+        std::vector<uint32_t> floor;
+
+        size_t size() const { return x.size(); }
+
+        void resize(size_t count)
+        {
+            x.resize(count);
+            y.resize(count);
+            heading.resize(count);
+            weight.resize(count);
+            floor.resize(count);
+        }
+    };
+
+    // Step of a pedestrian dead reckoning, applied to all particles with individual noise.
+    struct ParticleMotion
+    {
+        float stepLength = 0.0f;
+        float headingChange = 0.0f;
+
+        // Standard deviations of the noise added per particle
+        float stepSigma = 0.1f;
+        float headingSigma = 0.05f;
+    };
+
+    enum class ParticleCollision
+    {
+        // The particle keeps its previous state and its weight is multiplied by rejectedWeight
+        Reject,
+
+        // The particle is mirrored at the blocking segment, it stops at the segment if the mirrored move is blocked as well
+        Reflect
+    };
+
+    struct ParticleMotionOptions
+    {
+        ParticleCollision collision = ParticleCollision::Reject;
+        float rejectedWeight = 0.0f;
+
+        // Walls and windows block, doors are open. Moves crossing the outline (leaving it or entering a hole) block as well.
+        bool blockAtOutline = true;
+
+        uint64_t seed = 0;
+        size_t threadCount = 0;
+    };
+
+    namespace detail
+    {
+        inline uint64_t mix64(uint64_t z)
+        {
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        // Counter-based random numbers: every (key, index) has its own value,
+        // thus results do not depend on the number of threads or the chunking.
+        inline uint32_t particleRandom(uint64_t key, uint32_t index)
+        {
+            return static_cast<uint32_t>(mix64(key + (static_cast<uint64_t>(index) + 1) * 0x9E3779B97F4A7C15ull) >> 32);
+        }
+
+        // Key of one propagate() or resample() call
+        inline uint64_t particleKey(uint64_t seed, uint64_t update)
+        {
+            return mix64(seed ^ mix64(update + 0x632BE59BD9B4E019ull));
+        }
+
+        // (0, 1]
+        inline float unitOpen(uint32_t r) { return (static_cast<float>(r >> 8) + 1.0f) * (1.0f / 16777216.0f); }
+
+        // [0, 1)
+        inline float unit(uint32_t r) { return static_cast<float>(r >> 8) * (1.0f / 16777216.0f); }
+
+        // 32 bit counterpart of particleRandom() for the noise loop, vector units have 32 bit but no 64 bit multiplications
+        inline uint32_t mix32(uint32_t z)
+        {
+            z = (z ^ (z >> 16)) * 0x7FEB352Du;
+            z = (z ^ (z >> 15)) * 0x846CA68Bu;
+            return z ^ (z >> 16);
+        }
+
+        inline uint32_t particleRandom32(uint64_t key, uint32_t index)
+        {
+            return mix32(mix32(index ^ static_cast<uint32_t>(key)) + static_cast<uint32_t>(key >> 32));
+        }
+
+        // The math below is branch-free and without library calls, std::log, std::sin and std::cos are
+        // calls the vectorizer cannot inline and std::sqrt is one as well unless errno is disabled.
+        inline uint32_t floatBits(float f)
+        {
+            uint32_t u;
+            std::memcpy(&u, &f, sizeof(u));
+            return u;
+        }
+
+        inline float bitsFloat(uint32_t u)
+        {
+            float f;
+            std::memcpy(&f, &u, sizeof(f));
+            return f;
+        }
+
+        // Natural logarithm of a positive normal float, Cephes polynomial
+        inline float fastLog(float x)
+        {
+            // x = 2^e * (1 + m) with 1 + m in [sqrt(1/2), sqrt(2)). The range is chosen on the bits, float
+            // comparisons let GCC move float operations into branches which it then does not vectorize.
+            const uint32_t bits = floatBits(x);
+            const uint32_t low = (bits & 0x007FFFFFu) < 0x003504F3u ? 1u : 0u;
+            const float e = static_cast<float>(static_cast<int32_t>(bits >> 23) - 126 - static_cast<int32_t>(low));
+            const float m = bitsFloat((bits & 0x007FFFFFu) | (0x3F000000u + (low << 23))) - 1.0f;
+
+            const float z = m * m;
+            float y = 7.0376836292e-2f;
+            y = y * m - 1.1514610310e-1f;
+            y = y * m + 1.1676998740e-1f;
+            y = y * m - 1.2420140846e-1f;
+            y = y * m + 1.4249322787e-1f;
+            y = y * m - 1.6668057665e-1f;
+            y = y * m + 2.0000714765e-1f;
+            y = y * m - 2.4999993993e-1f;
+            y = y * m + 3.3333331174e-1f;
+            y = y * m * z;
+            y += -2.12194440e-4f * e;
+            y += -0.5f * z;
+            return m + y + 0.693359375f * e;
+        }
+
+        // Square root of a non-negative float by Newton iterations of the reciprocal square root
+        inline float fastSqrt(float x)
+        {
+            float r = bitsFloat(0x5F3759DFu - (floatBits(x) >> 1));
+            r = r * (1.5f - 0.5f * x * r * r);
+            r = r * (1.5f - 0.5f * x * r * r);
+            r = r * (1.5f - 0.5f * x * r * r);
+            return x * r;
+        }
+
+        // Sine and cosine of an angle in turns (1 = 2 pi), |turns| < 2^31. Cephes polynomials on [-pi/4, pi/4].
+        inline void fastSinCosTurns(float turns, float& s, float& c)
+        {
+            // Quarter turns in (-4, 4), q is the nearest one shifted by 4
+            const float quarters = 4.0f * (turns - static_cast<float>(static_cast<int32_t>(turns)));
+            const int32_t q = static_cast<int32_t>(quarters + 4.5f);
+            const float a = (quarters - static_cast<float>(q - 4)) * 1.57079632679489662f;
+
+            const float z = a * a;
+            const float ps = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * a + a;
+            const float pc = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+
+            // Quadrant by swapping and flipping sign bits
+            const bool swap = (q & 1) != 0;
+            const float rs = swap ? pc : ps;
+            const float rc = swap ? ps : pc;
+            s = bitsFloat(floatBits(rs) ^ (static_cast<uint32_t>(q & 2) << 30));
+            c = bitsFloat(floatBits(rc) ^ (static_cast<uint32_t>((q + 1) & 2) << 30));
+        }
+    }
+
+    // Particle propagation against the walls, obstacles and outlines of a map.
+    // Every floor has a WallIndex over its blocking segments, particles only move within their floor.
+    // Noise is generated in blocks by a branch-free loop over contiguous arrays without library calls, which
+    // GCC vectorizes at -O3 (SSE2 and AVX2, no -ffast-math needed), collisions are resolved per particle.
+    // Chunks of particles are processed in parallel.
+    class ParticleMotionModel
+    {
+    private:
+        static constexpr size_t Block = 256;
+
+        std::vector<WallIndex> indices;
+        ParticleMotionOptions options;
+        uint64_t updates = 0;
+
+        // Resampling scratch
+        std::vector<double> cumulative;
+        ParticleSet resampled;
+
+        // Resolves a collision of the move a-b, returns the new position and heading
+        void collide(const WallIndex& index, const Point2D& a, const Point2D& b, int hit, float t, Point2D& pos, float& heading) const
+        {
+            const Point2D v = b - a;
+            const float len = v.length();
+
+            // Stay slightly in front of the segment, the end point must not lie on it
+            const float back = std::max(0.0f, t - 1e-3f / std::max(len, 1e-6f));
+            const Point2D h = a + v * back;
+
+            const IndexedSegment& s = index.segments()[hit];
+            const Point2D d = s.end - s.start;
+            const float dl = d.length();
+            if (dl <= 0.0f)
+            {
+                pos = h;
+                return;
+            }
+
+            const Point2D dir = d / dl;
+            const Point2D r = v * (1.0f - back);
+            const float along = r.x * dir.x + r.y * dir.y;
+            const Point2D mirrored = dir * (2.0f * along) - r;
+            const Point2D target = h + mirrored;
+
+            pos = index.intersects(h, target, DefaultBlocker()) ? h : target;
+            if (mirrored.length() > 0.0f)
+                heading = std::atan2(mirrored.y, mirrored.x);
+        }
+
+        void propagateRange(ParticleSet& p, const ParticleMotion& motion, uint64_t key, size_t begin, size_t end) const
+        {
+            alignas(32) float nx[Block];
+            alignas(32) float ny[Block];
+            alignas(32) float nh[Block];
+
+            for (size_t first = begin; first < end; first += Block)
+            {
+                const size_t n = std::min(Block, end - first);
+                const float* __restrict px = p.x.data() + first;
+                const float* __restrict py = p.y.data() + first;
+                const float* __restrict ph = p.heading.data() + first;
+                const float headingChange = motion.headingChange, headingSigma = motion.headingSigma;
+                const float stepLength = motion.stepLength, stepSigma = motion.stepSigma;
+
+                // Noise and unconstrained move, Box-Muller gives both normal deviates of a particle
+                for (size_t i = 0; i < n; i++)
+                {
+                    const uint32_t index = static_cast<uint32_t>(first + i);
+                    const float u1 = detail::unitOpen(detail::particleRandom32(key, 2 * index));
+                    const float u2 = detail::unit(detail::particleRandom32(key, 2 * index + 1));
+                    const float radius = detail::fastSqrt(-2.0f * detail::fastLog(u1));
+
+                    float ns, nc;
+                    detail::fastSinCosTurns(u2, ns, nc);
+                    const float h = ph[i] + headingChange + headingSigma * radius * nc;
+                    const float step = std::max(0.0f, stepLength + stepSigma * radius * ns);
+
+                    float hs, hc;
+                    detail::fastSinCosTurns(h * 0.159154943091895336f, hs, hc);
+                    nh[i] = h;
+                    nx[i] = px[i] + step * hc;
+                    ny[i] = py[i] + step * hs;
+                }
+
+                for (size_t i = 0; i < n; i++)
+                {
+                    const size_t k = first + i;
+                    const uint32_t f = p.floor[k];
+                    if (f >= indices.size())
+                        continue;
+
+                    const WallIndex& index = indices[f];
+                    const Point2D a(p.x[k], p.y[k]);
+                    const Point2D b(nx[i], ny[i]);
+
+                    float t;
+                    const int hit = index.firstHit(a, b, t, DefaultBlocker());
+                    if (hit < 0)
+                    {
+                        p.x[k] = b.x;
+                        p.y[k] = b.y;
+                        p.heading[k] = nh[i];
+                    }
+                    else if (options.collision == ParticleCollision::Reject)
+                    {
+                        p.weight[k] *= options.rejectedWeight;
+                    }
+                    else
+                    {
+                        Point2D pos;
+                        float heading = nh[i];
+                        collide(index, a, b, hit, t, pos, heading);
+                        p.x[k] = pos.x;
+                        p.y[k] = pos.y;
+                        p.heading[k] = heading;
+                    }
+                }
+            }
+        }
+
+    public:
+        explicit ParticleMotionModel(const Map& map, const ParticleMotionOptions& options = ParticleMotionOptions())
+            : options(options)
+        {
+            indices.reserve(map.floors.size());
+            for (const Floor& floor : map.floors)
+            {
+                std::vector<IndexedSegment> segs;
+                forEachFloorSegment(floor, [&](const IndexedSegment& seg) { segs.push_back(seg); });
+                if (options.blockAtOutline)
+                    forEachOutlineSegment(floor, [&](const IndexedSegment& seg) { segs.push_back(seg); });
+                indices.emplace_back(std::move(segs));
+            }
+        }
+
+        const WallIndex& wallIndex(size_t floor) const { return indices[floor]; }
+
+        // Number of propagate() and resample() calls so far, part of the random number keys
+        uint64_t updateCount() const { return updates; }
+
+        // Moves all particles by the step. Particles on floors not in the map are left unchanged.
+        void propagate(ParticleSet& particles, const ParticleMotion& motion)
+        {
+            const uint64_t key = detail::particleKey(options.seed, updates++);
+
+            // Chunks are multiples of the block size
+            const size_t blocks = (particles.size() + Block - 1) / Block;
+            parallelFor(blocks, options.threadCount, [&](size_t begin, size_t end, size_t)
+            {
+                propagateRange(particles, motion, key, begin * Block, std::min(particles.size(), end * Block));
+            });
+        }
+
+        // Systematic resampling, all weights are 1/n afterwards. If all weights are 0 the particles are kept.
+        void resample(ParticleSet& particles)
+        {
+            const size_t n = particles.size();
+            const uint64_t key = detail::particleKey(options.seed, updates++);
+            if (n == 0)
+                return;
+
+            cumulative.resize(n);
+            double total = 0.0;
+            for (size_t i = 0; i < n; i++)
+            {
+                total += particles.weight[i];
+                cumulative[i] = total;
+            }
+
+            const bool uniform = !(total > 0.0);
+            const double step = uniform ? 1.0 : total / static_cast<double>(n);
+            const double offset = detail::unit(detail::particleRandom(key, 0)) * step;
+
+            resampled.resize(n);
+            parallelFor(n, options.threadCount, [&](size_t begin, size_t end, size_t)
+            {
+                // Source of the first output of the chunk, then a linear merge
+                const double first = offset + step * static_cast<double>(begin);
+                size_t src = uniform ? begin : static_cast<size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), first) - cumulative.begin());
+                for (size_t j = begin; j < end; j++)
+                {
+                    if (uniform)
+                    {
+                        src = j;
+                    }
+                    else
+                    {
+                        const double u = offset + step * static_cast<double>(j);
+                        while (src < n - 1 && cumulative[src] <= u)
+                            src++;
+                    }
+
+                    resampled.x[j] = particles.x[src];
+                    resampled.y[j] = particles.y[src];
+                    resampled.heading[j] = particles.heading[src];
+                    resampled.floor[j] = particles.floor[src];
+                    resampled.weight[j] = 1.0f / static_cast<float>(n);
+                }
+            });
+
+            std::swap(particles, resampled);
+        }
+    };
+
+    // 1 / sum(w^2) of the normalized weights, 0 if all weights are 0.
+    inline float effectiveSampleSize(const ParticleSet& particles)
+    {
+        double sum = 0.0, sum2 = 0.0;
+        for (float w : particles.weight)
+        {
+            sum += w;
+            sum2 += static_cast<double>(w) * w;
+        }
+        return sum2 > 0.0 ? static_cast<float>(sum * sum / sum2) : 0.0f;
+    }
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapDistanceField.h"
+#include "indoorMapParallel.h"
+#include "indoorMapQuery.h"
+#include "indoorMapWallIndex.h"
+
+namespace Indoor::Map
+{
+    struct ProjectionOptions
+    {
+        // Distance kept to blocking segments beyond half their thickness
+        float clearance = 0.05f;
+
+        // Cells of the WalkableGrid used to find a first walkable point, see WalkableGridOptions
+        float cellSize = 0.25f;
+
+        size_t threadCount = 0;
+    };
+
+    // Nearest walkable point of a floor, e.g. for position estimates inside walls or outside the outline.
+    // Walkable points are within the outline (outside PolygonMethod::Remove holes) and at least
+    // thickness / 2 + clearance away from every blocking segment, as for a WalkableGrid with the same clearance.
+    // The nearest walkable grid cell bounds the search, the exact point is the nearest valid candidate
+    // among the projections onto the nearby wall bands and outline edges and their intersections.
+    // The filter is applied when the projector is built.
+    class WalkableProjector
+    {
+    private:
+        const Floor* floor = nullptr;
+        bool hasOutline = false;
+        float clearance = 0.0f;
+
+        // Largest thickness / 2 + clearance of all segments
+        float maxReach = 0.0f;
+
+        // Blocking segments and outline edges
+        WallIndex index;
+        WalkableGrid grid;
+
+        // Minimum distance a walkable point keeps to the segment, outline edges only separate inside and outside
+        float reach(const IndexedSegment& s) const
+        {
+            return s.source == SegmentSource::Outline ? 0.0f : s.thickness / 2.0f + clearance;
+        }
+
+        // Nearest walkable cell center by rings around p, false if no cell is walkable
+        bool nearestCell(const Point2D& p, Point2D& result) const
+        {
+            if (grid.cellCount() == 0)
+                return false;
+
+            const float cs = grid.cellSize();
+            const int64_t w = grid.width();
+            const int64_t h = grid.height();
+            const int64_t px = std::clamp<int64_t>(static_cast<int64_t>(std::floor((p.x - grid.origin().x) / cs)), 0, w - 1);
+            const int64_t py = std::clamp<int64_t>(static_cast<int64_t>(std::floor((p.y - grid.origin().y) / cs)), 0, h - 1);
+
+            // Distance of p to the clamped cell, rings closer than the best hit may still contain a better cell
+            const float offset = (grid.center(static_cast<uint32_t>(px), static_cast<uint32_t>(py)) - p).length();
+            float best = std::numeric_limits<float>::infinity();
+            const int64_t maxRing = std::max(w, h);
+
+            for (int64_t ring = 0; ring <= maxRing; ring++)
+            {
+                if ((ring - 1) * cs - offset > best)
+                    break;
+
+                auto check = [&](int64_t x, int64_t y)
+                {
+                    if (x < 0 || y < 0 || x >= w || y >= h)
+                        return;
+                    const size_t cell = grid.cellIndex(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+                    if (!grid.isWalkable(cell))
+                        return;
+                    const float d = (grid.center(cell) - p).length();
+                    if (d < best)
+                    {
+                        best = d;
+                        result = grid.center(cell);
+                    }
+                };
+
+                for (int64_t x = px - ring; x <= px + ring; x++)
+                {
+                    check(x, py - ring);
+                    if (ring > 0)
+                        check(x, py + ring);
+                }
+                for (int64_t y = py - ring + 1; y <= py + ring - 1; y++)
+                {
+                    check(px - ring, y);
+                    check(px + ring, y);
+                }
+            }
+            return best < std::numeric_limits<float>::infinity();
+        }
+
+    public:
+        WalkableProjector() = default;
+
+        template<typename Filter = DefaultBlocker>
+        explicit WalkableProjector(const Floor& floor, const ProjectionOptions& options = ProjectionOptions(), Filter filter = Filter())
+            : floor(&floor), clearance(options.clearance)
+        {
+            std::vector<IndexedSegment> segs;
+            forEachFloorSegment(floor, [&](const IndexedSegment& seg)
+            {
+                if (filter(seg))
+                    segs.push_back(seg);
+            });
+            forEachOutlineSegment(floor, [&](const IndexedSegment& seg) { segs.push_back(seg); });
+            for (const IndexedSegment& s : segs)
+                maxReach = std::max(maxReach, reach(s));
+            index = WallIndex(std::move(segs));
+
+            for (const Polygon2D& polygon : floor.outline.polygons)
+                hasOutline = hasOutline || polygon.method == PolygonMethod::Add;
+
+            WalkableGridOptions gridOptions;
+            gridOptions.cellSize = options.cellSize;
+            gridOptions.clearance = options.clearance;
+            gridOptions.threadCount = options.threadCount;
+            grid = WalkableGrid(floor, gridOptions, filter);
+        }
+
+        bool isWalkable(const Point2D& p) const
+        {
+            if (hasOutline && !isInOutline(*floor, p))
+                return false;
+
+            bool blocked = false;
+            index.forEachInBox(p - Point2D(maxReach, maxReach), p + Point2D(maxReach, maxReach), [&](uint32_t i)
+            {
+                const IndexedSegment& s = index.segments()[i];
+                if (!blocked && s.source != SegmentSource::Outline)
+                    blocked = (p - closestPointOnSegment(p, s.start, s.end)).length() < reach(s);
+            });
+            return !blocked;
+        }
+
+        // Nearest walkable point to p, false if the floor has no walkable area
+        bool project(const Point2D& p, Point2D& result) const
+        {
+            if (isWalkable(p))
+            {
+                result = p;
+                return true;
+            }
+
+            Point2D fallback;
+            if (!nearestCell(p, fallback))
+                return false;
+            const float bound = (fallback - p).length();
+
+            // Candidates are placed slightly beyond the boundary, thus rounding does not make them invalid
+            const float eps = 1e-4f;
+            thread_local std::vector<std::pair<Point2D, Point2D>> lines;
+            thread_local std::vector<std::pair<float, Point2D>> candidates;
+            lines.clear();
+            candidates.clear();
+
+            auto add = [&](const Point2D& c)
+            {
+                const float d = (c - p).length();
+                if (d < bound)
+                    candidates.push_back({ d, c });
+            };
+
+            const Point2D range(bound + maxReach, bound + maxReach);
+            index.forEachInBox(p - range, p + range, [&](uint32_t i)
+            {
+                const IndexedSegment& s = index.segments()[i];
+                const float r = reach(s) + eps;
+                const Point2D d = s.end - s.start;
+                const float len = d.length();
+                if (len <= 0.0f)
+                    return;
+
+                // Pushed out of the band around the segment, this also covers the round caps
+                const Point2D c = closestPointOnSegment(p, s.start, s.end);
+                const float dist = (p - c).length();
+                if (dist > 0.0f)
+                    add(c + (p - c) * (r / dist));
+
+                // Both borders of the band
+                const Point2D n = d.orthogonal() * (r / len);
+                for (const Point2D& o : { n, n * -1.0f })
+                {
+                    lines.push_back({ s.start + o, s.end + o });
+                    add(closestPointOnSegment(p, s.start + o, s.end + o));
+                }
+            });
+
+            // Corners where two borders meet
+            for (size_t i = 0; i < lines.size(); i++)
+            {
+                for (size_t j = i + 1; j < lines.size(); j++)
+                {
+                    const float t = WallIndex::intersect(lines[i].first, lines[i].second, lines[j].first, lines[j].second);
+                    if (t >= 0.0f)
+                        add(lines[i].first + (lines[i].second - lines[i].first) * t);
+                }
+            }
+
+            std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (const auto& c : candidates)
+            {
+                if (isWalkable(c.second))
+                {
+                    result = c.second;
+                    return true;
+                }
+            }
+
+            result = fallback;
+            return true;
+        }
+
+        // Projects the points in place, returns the number of points which could not be projected
+        size_t project(Point2D* points, size_t count, size_t threadCount = 0) const
+        {
+            std::vector<size_t> failed(threadCount == 0 ? defaultThreadCount() : threadCount, 0);
+            parallelFor(count, threadCount, [&](size_t begin, size_t end, size_t thread)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    if (!project(points[i], points[i]))
+                        failed[thread]++;
+                }
+            });
+
+            size_t total = 0;
+            for (size_t f : failed)
+                total += f;
+            return total;
+        }
+    };
+
+    // WalkableProjector for every floor of a map.
+    class MapProjector
+    {
+    private:
+        std::vector<WalkableProjector> floors;
+
+    public:
+        template<typename Filter = DefaultBlocker>
+        explicit MapProjector(const Map& map, const ProjectionOptions& options = ProjectionOptions(), Filter filter = Filter())
+        {
+            floors.resize(map.floors.size());
+            parallelFor(map.floors.size(), options.threadCount, [&](size_t begin, size_t end, size_t)
+            {
+                ProjectionOptions single = options;
+                single.threadCount = 1;
+                for (size_t f = begin; f < end; f++)
+                    floors[f] = WalkableProjector(map.floors[f], single, filter);
+            });
+        }
+
+        const WalkableProjector& floor(size_t floor) const { return floors[floor]; }
+
+        bool project(uint32_t floor, const Point2D& p, Point2D& result) const
+        {
+            return floor < floors.size() && floors[floor].project(p, result);
+        }
+
+        // Projects points[i] on floor floorIndices[i] in place, returns the number of points which could not be projected
+        size_t project(const uint32_t* floorIndices, Point2D* points, size_t count, size_t threadCount = 0) const
+        {
+            std::vector<size_t> failed(threadCount == 0 ? defaultThreadCount() : threadCount, 0);
+            parallelFor(count, threadCount, [&](size_t begin, size_t end, size_t thread)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    if (!project(floorIndices[i], points[i], points[i]))
+                        failed[thread]++;
+                }
+            });
+
+            size_t total = 0;
+            for (size_t f : failed)
+                total += f;
+            return total;
+        }
+    };
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "indoorMap.h"
+
+namespace Indoor::Map
+{
+    // Even-odd rule, points on the border may be inside or outside.
+    inline bool pointInPolygon(const std::vector<Point2D>& polygon, const Point2D& p)
+    {
+        bool inside = false;
+        for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+        {
+            const Point2D& a = polygon[i];
+            const Point2D& b = polygon[j];
+
+            if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x)
+            {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+
+    // True if the position is within the floor's outline, i.e. within a PolygonMethod::Add polygon
+    // and not within a PolygonMethod::Remove polygon.
+    inline bool isInOutline(const Floor& floor, const Point2D& p)
+    {
+        bool added = false;
+        for (const Polygon2D& polygon : floor.outline.polygons)
+        {
+            if (polygon.method == PolygonMethod::Add && !added)
+            {
+                added = pointInPolygon(polygon.points, p);
+            }
+            else if (polygon.method == PolygonMethod::Remove && pointInPolygon(polygon.points, p))
+            {
+                return false;
+            }
+        }
+        return added;
+    }
+
+    // Index of the floor containing the given height or -1.
+    // A floor contains the heights [atHeight, atHeight + height).
+    inline int floorIndexAt(const Map& map, float z)
+    {
+        for (size_t i = 0; i < map.floors.size(); i++)
+        {
+            const Floor& floor = map.floors[i];
+            if (z >= floor.atHeight && z < floor.atHeight + floor.height)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // Index of the nearest POI of the floor or -1 if the floor has no POIs.
+    inline int nearestPointOfInterest(const Floor& floor, const Point2D& p)
+    {
+        int best = -1;
+        float bestDist = std::numeric_limits<float>::infinity();
+        for (size_t i = 0; i < floor.pois.size(); i++)
+        {
+            const float dx = floor.pois[i].x - p.x;
+            const float dy = floor.pois[i].y - p.y;
+            const float dist = dx * dx + dy * dy;
+            if (dist < bestDist)
+            {
+                bestDist = dist;
+                best = static_cast<int>(i);
+            }
+        }
+        return best;
+    }
+
+    // Finds a POI by its exact name. Returns false if no POI has this name.
+    inline bool findPointOfInterest(const Map& map, const std::string& name, int& floorIndex, int& poiIndex)
+    {
+        for (size_t f = 0; f < map.floors.size(); f++)
+        {
+            const std::vector<PointOfInterest>& pois = map.floors[f].pois;
+            for (size_t i = 0; i < pois.size(); i++)
+            {
+                if (pois[i].name == name)
+                {
+                    floorIndex = static_cast<int>(f);
+                    poiIndex = static_cast<int>(i);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Number of ceilings between two heights.
+    inline int ceilingsBetween(const Map& map, float z1, float z2)
+    {
+        const float lo = std::min(z1, z2);
+        const float hi = std::max(z1, z2);
+
+        int count = 0;
+        for (const Floor& floor : map.floors)
+        {
+            if (floor.atHeight > lo && floor.atHeight <= hi)
+                count++;
+        }
+        return count;
+    }
+
+    // Log-distance path loss model with a constant attenuation per ceiling:
+    // rssi = txp - 10 * exp * log10(d) + waf * ceilings
+    // The transmitter position is absolute, i.e. z includes the floor's atHeight. mdl_waf is expected to be negative.
+    // see: Ebner et al., On Wi-Fi Model Optimizations for Smartphone-Based Indoor Localization (indoorMap.h)
+    inline float predictRssi(const Map& map, float txp, float exp, float waf,
+                             float txX, float txY, float txZ, float x, float y, float z)
+    {
+        const float dx = x - txX;
+        const float dy = y - txY;
+        const float dz = z - txZ;
+        const float dist = std::max(std::sqrt(dx * dx + dy * dy + dz * dz), 0.1f);
+
+        return txp - 10.0f * exp * std::log10(dist) + waf * static_cast<float>(ceilingsBetween(map, txZ, z));
+    }
+
+    inline float predictRssi(const Map& map, const AccessPoint& ap, float x, float y, float z)
+    {
+        return predictRssi(map, ap.mdl_txp, ap.mdl_exp, ap.mdl_waf, ap.x, ap.y, ap.z, x, y, z);
+    }
+
+    inline float predictRssi(const Map& map, const Beacon& beacon, float x, float y, float z)
+    {
+        return predictRssi(map, beacon.mdl_txp, beacon.mdl_exp, beacon.mdl_waf, beacon.x, beacon.y, beacon.z, x, y, z);
+    }
+}
@@ -0,0 +1,688 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapParallel.h"
+#include "indoorMapWallIndex.h"
+#include "indoorMapWallSegments.h"
+
+namespace Indoor::Map
+{
+    // Losses in dB of a single interaction with a material.
+    struct MaterialLoss
+    {
+        float transmission;
+        float reflection;
+    };
+
+    // Rough values for 2.4 GHz, indexed by WallMaterial.
+    inline std::array<MaterialLoss, 7> defaultMaterialLosses()
+    {
+        return {{
+            { 6.0f, 8.0f },   // Unknown
+            { 12.0f, 6.0f },  // Concrete
+            { 4.0f, 10.0f },  // Wood
+            { 3.0f, 10.0f },  // Drywall
+            { 2.0f, 8.0f },   // Glass
+            { 30.0f, 1.0f },  // Metal
+            { 20.0f, 3.0f }   // Metalized_Glas
+        }};
+    }
+
+    struct RayTracerOptions
+    {
+        // Rays launched per transmitter, evenly distributed over the sphere
+        size_t rayCount = 200000;
+
+        // Rays are traced in bundles of this size, bundles of all transmitters are distributed over the threads
+        size_t bundleSize = 4096;
+
+        // Threads to use, 0 uses all hardware threads
+        size_t threadCount = 0;
+
+        // Maximum number of reflections along a path and of interactions (reflections and transmissions)
+        int maxBounces = 3;
+        int maxInteractions = 10;
+
+        float frequencyMHz = 2437.0f;
+
+        // Used for transmitters without model parameters
+        float txPowerDbm = 20.0f;
+
+        std::array<MaterialLoss, 7> materials = defaultMaterialLosses();
+        MaterialLoss slab = { 15.0f, 8.0f };
+
+        // Doors are open, i.e. have no panel
+        bool doorsOpen = true;
+
+        // Radio map resolution. The receivers are located within a layer of the given thickness above each floor.
+        float cellSize = 1.0f;
+        float receiverHeight = 1.0f;
+        float layerThickness = 1.0f;
+
+        // Paths weaker than this are not followed and cells without paths receive this value
+        float minRssi = -120.0f;
+    };
+
+    struct RadioTransmitter
+    {
+        std::string macAddress;
+        float x, y, z;
+        float txPowerDbm;
+    };
+
+    // Received power in dBm per transmitter, floor and grid cell.
+    struct RadioMap
+    {
+        Point2D origin;
+        float cellSize = 1.0f;
+        int width = 0;
+        int height = 0;
+        size_t floorCount = 0;
+
+        std::vector<std::string> transmitters;
+
+        // rssi[((tx * floorCount) + floor) * width * height + y * width + x]
+        std::vector<float> rssi;
+
+        float at(size_t tx, size_t floor, const Point2D& p) const
+        {
+            const int x = std::clamp(static_cast<int>((p.x - origin.x) / cellSize), 0, width - 1);
+            const int y = std::clamp(static_cast<int>((p.y - origin.y) / cellSize), 0, height - 1);
+            return rssi[(tx * floorCount + floor) * static_cast<size_t>(width) * height + static_cast<size_t>(y) * width + x];
+        }
+    };
+
+    // Vertical quad between the 2D line a-b and the heights z0 and z1.
+    struct RayPanel
+    {
+        Point2D a, b;
+        float z0, z1;
+        WallMaterial material;
+    };
+
+    // 2.5D scene of a map: wall panels in a BVH plus horizontal slabs at the floor heights.
+    class RayScene
+    {
+    public:
+        struct Hit
+        {
+            float t;
+
+            // Index of the panel, or -2 - slab index
+            int id;
+        };
+
+    private:
+        struct Node
+        {
+            float bmin[3];
+            float bmax[3];
+
+            // Leaf: panels[start .. start + count), inner node: left child follows, right child is start
+            uint32_t start;
+            uint32_t count;
+        };
+
+        std::vector<RayPanel> panels;
+        std::vector<Node> nodes;
+        std::vector<float> slabs;
+
+        float bmin[3] = { 0, 0, 0 };
+        float bmax[3] = { 0, 0, 0 };
+
+        void addPanel(const Point2D& a, const Point2D& b, float z0, float z1, WallMaterial material)
+        {
+            if (z1 > z0 && a != b)
+                panels.push_back(RayPanel{ a, b, z0, z1, material });
+        }
+
+        void addWallPiece(const Wall& wall, const Point2D& a, const Point2D& b, WallSegmentType type, int listIndex,
+                          float base, float wallHeight, bool doorsOpen)
+        {
+            const float top = base + wallHeight;
+            if (type == WallSegmentType::Door)
+            {
+                const WallDoor& door = wall.doors[listIndex];
+                const float doorTop = std::min(top, base + door.height);
+                if (!doorsOpen)
+                    addPanel(a, b, base, doorTop, door.material);
+                addPanel(a, b, doorTop, top, wall.material);
+            }
+            else if (type == WallSegmentType::Window)
+            {
+                const WallWindow& window = wall.windows[listIndex];
+                const float lo = std::min(top, base + window.atHeigth);
+                const float hi = std::min(top, lo + window.height);
+                addPanel(a, b, base, lo, wall.material);
+                addPanel(a, b, lo, hi, window.material);
+                addPanel(a, b, hi, top, wall.material);
+            }
+            else
+            {
+                addPanel(a, b, base, top, wall.material);
+            }
+        }
+
+        uint32_t build(uint32_t start, uint32_t count)
+        {
+            const uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node());
+
+            Node node;
+            for (int i = 0; i < 3; i++)
+            {
+                node.bmin[i] = std::numeric_limits<float>::infinity();
+                node.bmax[i] = -std::numeric_limits<float>::infinity();
+            }
+            for (uint32_t i = start; i < start + count; i++)
+            {
+                const RayPanel& p = panels[i];
+                node.bmin[0] = std::min({ node.bmin[0], p.a.x, p.b.x });
+                node.bmin[1] = std::min({ node.bmin[1], p.a.y, p.b.y });
+                node.bmin[2] = std::min(node.bmin[2], p.z0);
+                node.bmax[0] = std::max({ node.bmax[0], p.a.x, p.b.x });
+                node.bmax[1] = std::max({ node.bmax[1], p.a.y, p.b.y });
+                node.bmax[2] = std::max(node.bmax[2], p.z1);
+            }
+
+            if (count <= 4)
+            {
+                node.start = start;
+                node.count = count;
+                nodes[nodeIndex] = node;
+                return nodeIndex;
+            }
+
+            // Median split along the widest axis of the centroids
+            int axis = 0;
+            float extent = -1.0f;
+            for (int i = 0; i < 3; i++)
+            {
+                if (node.bmax[i] - node.bmin[i] > extent)
+                {
+                    extent = node.bmax[i] - node.bmin[i];
+                    axis = i;
+                }
+            }
+
+            auto centroid = [axis](const RayPanel& p)
+            {
+                return axis == 0 ? p.a.x + p.b.x : (axis == 1 ? p.a.y + p.b.y : p.z0 + p.z1);
+            };
+
+            const uint32_t mid = start + count / 2;
+            std::nth_element(panels.begin() + start, panels.begin() + mid, panels.begin() + start + count,
+                             [&](const RayPanel& a, const RayPanel& b) { return centroid(a) < centroid(b); });
+
+            build(start, mid - start);
+            node.start = build(mid, start + count - mid);
+            node.count = 0;
+            nodes[nodeIndex] = node;
+            return nodeIndex;
+        }
+
+        static bool hitsBox(const Node& node, const float o[3], const float inv[3], float tMax)
+        {
+            float t0 = 0.0f, t1 = tMax;
+            for (int i = 0; i < 3; i++)
+            {
+                float tNear = (node.bmin[i] - o[i]) * inv[i];
+                float tFar = (node.bmax[i] - o[i]) * inv[i];
+                if (tNear > tFar)
+                    std::swap(tNear, tFar);
+                t0 = std::max(t0, tNear);
+                t1 = std::min(t1, tFar);
+            }
+            return t0 <= t1;
+        }
+
+    public:
+        RayScene() = default;
+
+        RayScene(const Map& map, bool doorsOpen)
+        {
+            std::vector<WallSegment2D> scratch;
+            for (const Floor& floor : map.floors)
+            {
+                for (const Wall& wall : floor.walls)
+                {
+                    const float wallHeight = wall.height > 0 ? wall.height : floor.height;
+
+                    for (const WallSegment2D& seg : wallSegments(wall, scratch))
+                        addWallPiece(wall, seg.start, seg.end, seg.type, seg.listIndex, floor.atHeight, wallHeight, doorsOpen);
+                }
+
+                for (const LineObstacle& line : floor.lineObstacles)
+                    addPanel(line.start(), line.end(), floor.atHeight, floor.atHeight + line.height, line.material);
+
+                for (const CircleObstacle& circle : floor.circleObstacles)
+                {
+                    const Point2D center(circle.cx, circle.cy);
+                    for (int k = 0; k < CircleObstacleSides; k++)
+                    {
+                        addPanel(Point2D::fromPolar(center, circle.radius, 6.28318530718f * k / CircleObstacleSides),
+                                 Point2D::fromPolar(center, circle.radius, 6.28318530718f * (k + 1) / CircleObstacleSides),
+                                 floor.atHeight, floor.atHeight + circle.height, circle.material);
+                    }
+                }
+
+                if (!doorsOpen)
+                {
+                    for (const DoorObstacle& door : floor.doorObstacles)
+                        addPanel(door.start(), door.end(), floor.atHeight, floor.atHeight + door.height, door.material);
+                }
+
+                // Objects are unit models scaled by sz
+                for (const ObjectObstacle& object : floor.objectObstacles)
+                {
+                    const std::vector<Point2D>& fp = object.footprint;
+                    for (size_t k = 0; k < fp.size(); k++)
+                    {
+                        addPanel(fp[k], fp[(k + 1) % fp.size()], floor.atHeight + object.z, floor.atHeight + object.z + object.sz,
+                                 WallMaterial::Unknown);
+                    }
+                }
+
+                slabs.push_back(floor.atHeight);
+                slabs.push_back(floor.atHeight + floor.height);
+            }
+
+            std::sort(slabs.begin(), slabs.end());
+            slabs.erase(std::unique(slabs.begin(), slabs.end()), slabs.end());
+
+            // Scene bounds: the map area, all panels and all slabs
+            bmin[0] = 0; bmin[1] = 0;
+            bmax[0] = map.width; bmax[1] = map.depth;
+            for (const RayPanel& p : panels)
+            {
+                bmin[0] = std::min({ bmin[0], p.a.x, p.b.x });
+                bmin[1] = std::min({ bmin[1], p.a.y, p.b.y });
+                bmax[0] = std::max({ bmax[0], p.a.x, p.b.x });
+                bmax[1] = std::max({ bmax[1], p.a.y, p.b.y });
+            }
+            bmin[2] = slabs.empty() ? 0.0f : slabs.front();
+            bmax[2] = slabs.empty() ? 0.0f : slabs.back();
+
+            if (!panels.empty())
+            {
+                nodes.reserve(panels.size() / 2 + 1);
+                build(0, static_cast<uint32_t>(panels.size()));
+            }
+        }
+
+        const std::vector<RayPanel>& getPanels() const { return panels; }
+        const std::vector<float>& getSlabs() const { return slabs; }
+        Point2D boundsMin() const { return Point2D(bmin[0], bmin[1]); }
+        Point2D boundsMax() const { return Point2D(bmax[0], bmax[1]); }
+
+        // Nearest panel or slab hit along o + t * d with t in (0, tMax]. ignore is skipped (the element the ray starts on).
+        Hit intersect(const float o[3], const float d[3], float tMax, int ignore) const
+        {
+            const float eps = 1e-5f;
+            Hit best{ tMax, -1 };
+
+            // Slabs
+            if (d[2] > 0)
+            {
+                for (size_t i = std::upper_bound(slabs.begin(), slabs.end(), o[2] - eps) - slabs.begin(); i < slabs.size(); i++)
+                {
+                    if (ignore == -2 - static_cast<int>(i))
+                        continue;
+                    const float t = (slabs[i] - o[2]) / d[2];
+                    if (t > eps && t < best.t)
+                        best = Hit{ t, -2 - static_cast<int>(i) };
+                    break;
+                }
+            }
+            else if (d[2] < 0)
+            {
+                for (size_t i = std::lower_bound(slabs.begin(), slabs.end(), o[2] + eps) - slabs.begin(); i-- > 0;)
+                {
+                    if (ignore == -2 - static_cast<int>(i))
+                        continue;
+                    const float t = (slabs[i] - o[2]) / d[2];
+                    if (t > eps && t < best.t)
+                        best = Hit{ t, -2 - static_cast<int>(i) };
+                    break;
+                }
+            }
+
+            if (nodes.empty())
+                return best;
+
+            // Panels
+            float inv[3];
+            for (int i = 0; i < 3; i++)
+                inv[i] = 1.0f / d[i];
+
+            uint32_t stack[64];
+            int top = 0;
+            stack[top++] = 0;
+
+            while (top > 0)
+            {
+                const Node& node = nodes[stack[--top]];
+                if (!hitsBox(node, o, inv, best.t))
+                    continue;
+
+                if (node.count == 0)
+                {
+                    stack[top++] = node.start;
+                    stack[top++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+                    continue;
+                }
+
+                for (uint32_t i = node.start; i < node.start + node.count; i++)
+                {
+                    if (static_cast<int>(i) == ignore)
+                        continue;
+
+                    const RayPanel& p = panels[i];
+                    const float sx = p.b.x - p.a.x, sy = p.b.y - p.a.y;
+                    const float denom = d[0] * sy - d[1] * sx;
+                    if (std::abs(denom) < 1e-12f)
+                        continue;
+
+                    const float qx = p.a.x - o[0], qy = p.a.y - o[1];
+                    const float t = (qx * sy - qy * sx) / denom;
+                    const float u = (qx * d[1] - qy * d[0]) / denom;
+                    if (t <= eps || t >= best.t || u < 0.0f || u > 1.0f)
+                        continue;
+
+                    const float z = o[2] + t * d[2];
+                    if (z >= p.z0 && z <= p.z1)
+                        best = Hit{ t, static_cast<int>(i) };
+                }
+            }
+
+            return best;
+        }
+
+        // Distance along o + t * d until the scene bounds are left
+        float exitDistance(const float o[3], const float d[3]) const
+        {
+            float t = std::numeric_limits<float>::infinity();
+            for (int i = 0; i < 3; i++)
+            {
+                if (d[i] > 0)
+                    t = std::min(t, (bmax[i] - o[i]) / d[i]);
+                else if (d[i] < 0)
+                    t = std::min(t, (bmin[i] - o[i]) / d[i]);
+            }
+            return std::max(t, 0.0f);
+        }
+    };
+
+    // Shoot-and-bounce ray tracer for radio propagation.
+    // Every transmitter launches rays evenly over the sphere. At every panel or slab a ray continues with the
+    // transmission loss and spawns a specular reflection with the reflection loss of the material.
+    // The received power is estimated from the ray density: every ray adds its power times its path length within
+    // a receiver cell, divided by the cell volume this gives the power flux density which is converted to the power
+    // received by an isotropic antenna. In free space this equals the Friis equation.
+    // Diffraction is not modelled, cells without any path receive minRssi.
+    class RayTracer
+    {
+    private:
+        struct Ray
+        {
+            float o[3];
+            float d[3];
+            float power;
+            int bounces;
+            int interactions;
+            int ignore;
+        };
+
+        const Map& map;
+        RayTracerOptions options;
+        RayScene scene;
+
+        Point2D origin;
+        int width = 0;
+        int height = 0;
+
+        static float dbToLinear(float db) { return std::pow(10.0f, db / 10.0f); }
+
+        float wavelength() const { return 299.792458f / options.frequencyMHz; }
+
+        // Adds power * length to the cells the ray passes within every receiver layer
+        void deposit(const Ray& ray, float tEnd, std::vector<double>& acc) const
+        {
+            const size_t cells = static_cast<size_t>(width) * height;
+            const float cs = options.cellSize;
+
+            for (size_t f = 0; f < map.floors.size(); f++)
+            {
+                const float z0 = map.floors[f].atHeight + options.receiverHeight - options.layerThickness / 2;
+                const float z1 = z0 + options.layerThickness;
+
+                float t0 = 0.0f, t1 = tEnd;
+                if (ray.d[2] != 0)
+                {
+                    float ta = (z0 - ray.o[2]) / ray.d[2];
+                    float tb = (z1 - ray.o[2]) / ray.d[2];
+                    if (ta > tb)
+                        std::swap(ta, tb);
+                    t0 = std::max(t0, ta);
+                    t1 = std::min(t1, tb);
+                }
+                else if (ray.o[2] < z0 || ray.o[2] > z1)
+                {
+                    continue;
+                }
+
+                if (t0 >= t1)
+                    continue;
+
+                double* layer = acc.data() + f * cells;
+
+                // Walk the cells between t0 and t1
+                const float px = ray.o[0] + ray.d[0] * t0 - origin.x;
+                const float py = ray.o[1] + ray.d[1] * t0 - origin.y;
+                int cx = static_cast<int>(std::floor(px / cs));
+                int cy = static_cast<int>(std::floor(py / cs));
+
+                const int stepX = ray.d[0] > 0 ? 1 : -1;
+                const int stepY = ray.d[1] > 0 ? 1 : -1;
+                const float inf = std::numeric_limits<float>::infinity();
+                float tMaxX = ray.d[0] != 0 ? t0 + ((cx + (stepX > 0 ? 1 : 0)) * cs - px) / ray.d[0] : inf;
+                float tMaxY = ray.d[1] != 0 ? t0 + ((cy + (stepY > 0 ? 1 : 0)) * cs - py) / ray.d[1] : inf;
+                const float tDeltaX = ray.d[0] != 0 ? cs / std::abs(ray.d[0]) : inf;
+                const float tDeltaY = ray.d[1] != 0 ? cs / std::abs(ray.d[1]) : inf;
+
+                float t = t0;
+                while (t < t1)
+                {
+                    const float tNext = std::min({ tMaxX, tMaxY, t1 });
+                    if (cx >= 0 && cy >= 0 && cx < width && cy < height)
+                        layer[static_cast<size_t>(cy) * width + cx] += static_cast<double>(ray.power) * (tNext - t);
+
+                    t = tNext;
+                    if (tMaxX < tMaxY)
+                    {
+                        cx += stepX;
+                        tMaxX += tDeltaX;
+                    }
+                    else
+                    {
+                        cy += stepY;
+                        tMaxY += tDeltaY;
+                    }
+                }
+            }
+        }
+
+        void trace(const RadioTransmitter& tx, size_t rayBegin, size_t rayEnd, std::vector<double>& acc, std::vector<Ray>& stack) const
+        {
+            const float goldenAngle = 2.39996323f;
+            const float n = static_cast<float>(options.rayCount);
+            const float rayPower = dbToLinear(tx.txPowerDbm) / n;
+            const float minPower = dbToLinear(options.minRssi) / n;
+
+            for (size_t i = rayBegin; i < rayEnd; i++)
+            {
+                // Fibonacci sphere
+                const float z = 1.0f - (2.0f * static_cast<float>(i) + 1.0f) / n;
+                const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+                const float phi = goldenAngle * static_cast<float>(i);
+
+                stack.clear();
+                stack.push_back(Ray{ { tx.x, tx.y, tx.z }, { r * std::cos(phi), r * std::sin(phi), z }, rayPower, 0, 0, -1 });
+
+                while (!stack.empty())
+                {
+                    const Ray ray = stack.back();
+                    stack.pop_back();
+
+                    const float tExit = scene.exitDistance(ray.o, ray.d);
+                    const RayScene::Hit hit = scene.intersect(ray.o, ray.d, tExit, ray.ignore);
+                    deposit(ray, hit.t, acc);
+
+                    if (hit.id == -1 || ray.interactions >= options.maxInteractions)
+                        continue;
+
+                    MaterialLoss loss = options.slab;
+                    float normal[3] = { 0, 0, 1 };
+                    if (hit.id >= 0)
+                    {
+                        const RayPanel& p = scene.getPanels()[hit.id];
+                        loss = options.materials[static_cast<size_t>(p.material)];
+                        const Point2D nrm = (p.b - p.a).orthogonal().normalized();
+                        normal[0] = nrm.x;
+                        normal[1] = nrm.y;
+                        normal[2] = 0;
+                    }
+
+                    Ray next = ray;
+                    for (int k = 0; k < 3; k++)
+                        next.o[k] = ray.o[k] + ray.d[k] * hit.t;
+                    next.interactions++;
+                    next.ignore = hit.id;
+
+                    next.power = ray.power / dbToLinear(loss.transmission);
+                    if (next.power > minPower)
+                        stack.push_back(next);
+
+                    if (ray.bounces < options.maxBounces)
+                    {
+                        const float dn = ray.d[0] * normal[0] + ray.d[1] * normal[1] + ray.d[2] * normal[2];
+                        for (int k = 0; k < 3; k++)
+                            next.d[k] = ray.d[k] - 2.0f * dn * normal[k];
+                        next.bounces++;
+                        next.power = ray.power / dbToLinear(loss.reflection);
+                        if (next.power > minPower)
+                            stack.push_back(next);
+                    }
+                }
+            }
+        }
+
+    public:
+        // The map must outlive the tracer.
+        RayTracer(const Map& map, const RayTracerOptions& options = RayTracerOptions())
+            : map(map), options(options), scene(map, options.doorsOpen)
+        {
+            origin = scene.boundsMin();
+            const Point2D extent = scene.boundsMax() - origin;
+            width = std::max(1, static_cast<int>(std::ceil(extent.x / options.cellSize)));
+            height = std::max(1, static_cast<int>(std::ceil(extent.y / options.cellSize)));
+        }
+
+        const RayScene& getScene() const { return scene; }
+
+        // The access points of all floors. The transmit power is derived from the model parameter mdl_txp
+        // (RSSI at 1 m) by adding the free space loss of 1 m, if it is not set options.txPowerDbm is used.
+        std::vector<RadioTransmitter> accessPoints() const
+        {
+            const float loss1m = 20.0f * std::log10(4.0f * 3.14159265f / wavelength());
+
+            std::vector<RadioTransmitter> result;
+            for (const Floor& floor : map.floors)
+            {
+                for (const AccessPoint& ap : floor.accessPoints)
+                {
+                    const float txp = ap.mdl_txp != 0 ? ap.mdl_txp + loss1m : options.txPowerDbm;
+                    result.push_back(RadioTransmitter{ ap.macAddress, ap.x, ap.y, ap.z, txp });
+                }
+            }
+            return result;
+        }
+
+        RadioMap trace(const std::vector<RadioTransmitter>& transmitters) const
+        {
+            const size_t cells = static_cast<size_t>(width) * height;
+            const size_t perTx = map.floors.size() * cells;
+            const size_t bundleSize = std::max<size_t>(1, options.bundleSize);
+            const size_t bundles = (options.rayCount + bundleSize - 1) / bundleSize;
+
+            std::vector<double> total(transmitters.size() * perTx, 0.0);
+            std::mutex mutex;
+
+            // Tasks are ordered by transmitter, every thread accumulates locally and flushes when the transmitter changes
+            parallelFor(transmitters.size() * bundles, options.threadCount, [&](size_t begin, size_t end, size_t)
+            {
+                std::vector<double> acc(perTx, 0.0);
+                std::vector<Ray> stack;
+                size_t current = begin / bundles;
+
+                auto flush = [&]()
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    double* dst = total.data() + current * perTx;
+                    for (size_t i = 0; i < perTx; i++)
+                        dst[i] += acc[i];
+                    std::fill(acc.begin(), acc.end(), 0.0);
+                };
+
+                for (size_t task = begin; task < end; task++)
+                {
+                    if (task / bundles != current)
+                    {
+                        flush();
+                        current = task / bundles;
+                    }
+
+                    const size_t rayBegin = (task % bundles) * bundleSize;
+                    trace(transmitters[current], rayBegin, std::min(options.rayCount, rayBegin + bundleSize), acc, stack);
+                }
+                flush();
+            });
+
+            RadioMap result;
+            result.origin = origin;
+            result.cellSize = options.cellSize;
+            result.width = width;
+            result.height = height;
+            result.floorCount = map.floors.size();
+            for (const RadioTransmitter& tx : transmitters)
+                result.transmitters.push_back(tx.macAddress);
+
+            // Flux density times the effective aperture of an isotropic antenna
+            const double lambda = wavelength();
+            const double volume = static_cast<double>(options.cellSize) * options.cellSize * options.layerThickness;
+            const double scale = lambda * lambda / (4.0 * 3.14159265358979 * volume);
+
+            result.rssi.resize(total.size());
+            for (size_t i = 0; i < total.size(); i++)
+            {
+                const double p = total[i] * scale;
+                result.rssi[i] = p > 0 ? std::max(options.minRssi, static_cast<float>(10.0 * std::log10(p))) : options.minRssi;
+            }
+            return result;
+        }
+
+        RadioMap traceAccessPoints() const
+        {
+            return trace(accessPoints());
+        }
+    };
+}
@@ -0,0 +1,673 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "indoorMap.h"
+
+namespace Indoor::Map
+{
+    // Conversion of a decoded attribute to map coordinates, see CoordinateTransform in indoorMapParser.h
+    enum class FieldUnit : uint8_t
+    {
+        None,
+
+        // Distances and heights relative to the floor, scaled
+        Length,
+
+        // Absolute heights, scaled and offset
+        Height,
+
+        // Rotations in degrees, turned by the transform's rotation
+        Degrees
+    };
+
+    // Number, bool or enum attribute
+    template<typename T, typename M>
+    struct ValueField
+    {
+        const char* name;
+        M T::* member;
+        M defaultValue;
+        FieldUnit unit;
+
+        // Stored by the binary codec only, e.g. values derived while parsing
+        bool binaryOnly;
+    };
+
+    // String attribute, the empty string if missing
+    template<typename T>
+    struct StringField
+    {
+        const char* name;
+        std::string T::* member;
+    };
+
+    // Two attributes forming a position, transformed together. Missing coordinates are 0.
+    template<typename T>
+    struct PointField
+    {
+        const char* xName;
+        const char* yName;
+        float T::* x;
+        float T::* y;
+    };
+
+    // Items of a vector member, written as child elements named Schema<Item>::element
+    template<typename T, typename Item>
+    struct ListChild
+    {
+        // Element grouping the items, e.g. "obstacles", nullptr if the items are direct children.
+        // Consecutive lists with the same container share one element.
+        const char* container;
+        std::vector<Item> T::* member;
+    };
+
+    // Struct member written as a single child element
+    template<typename T, typename M>
+    struct ObjectChild
+    {
+        M T::* member;
+    };
+
+    namespace detail
+    {
+        template<typename M>
+        struct Identity
+        {
+            using type = M;
+        };
+    }
+
+    template<typename T, typename M>
+    constexpr ValueField<T, M> field(const char* name, M T::* member, typename detail::Identity<M>::type defaultValue = M(), FieldUnit unit = FieldUnit::None)
+    {
+        return ValueField<T, M>{ name, member, defaultValue, unit, false };
+    }
+
+    template<typename T, typename M>
+    constexpr ValueField<T, M> binaryField(const char* name, M T::* member)
+    {
+        return ValueField<T, M>{ name, member, M(), FieldUnit::None, true };
+    }
+
+    template<typename T>
+    constexpr StringField<T> stringField(const char* name, std::string T::* member)
+    {
+        return StringField<T>{ name, member };
+    }
+
+    template<typename T>
+    constexpr PointField<T> pointField(const char* xName, const char* yName, float T::* x, float T::* y)
+    {
+        return PointField<T>{ xName, yName, x, y };
+    }
+
+    template<typename T, typename Item>
+    constexpr ListChild<T, Item> listChild(const char* container, std::vector<Item> T::* member)
+    {
+        return ListChild<T, Item>{ container, member };
+    }
+
+    template<typename T, typename M>
+    constexpr ObjectChild<T, M> objectChild(M T::* member)
+    {
+        return ObjectChild<T, M>{ member };
+    }
+
+    // Single description of the file format: the element name, the attributes and the children of every struct.
+    // The parser's attribute decoding (decodeAttributes()), the XML writer (indoorMapWriter.h) and the
+    // binary codec (indoorMapBinary.h) are generated from it, thus a new attribute is added in one place.
+    template<typename T>
+    struct Schema;
+
+    template<>
+    struct Schema<Point2D>
+    {
+        static constexpr const char* element = "point";
+        static constexpr auto attributes = std::make_tuple(pointField("x", "y", &Point2D::x, &Point2D::y));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<EarthPosMapPos>
+    {
+        static constexpr const char* element = "point";
+        static constexpr auto attributes = std::make_tuple(
+            field("lat", &EarthPosMapPos::lat),
+            field("lon", &EarthPosMapPos::lon),
+            field("alt", &EarthPosMapPos::alt),
+            pointField("mx", "my", &EarthPosMapPos::x, &EarthPosMapPos::y),
+            field("mz", &EarthPosMapPos::z, 0.0f, FieldUnit::Height));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<EarthRegistration>
+    {
+        static constexpr const char* element = "earthReg";
+        static constexpr auto attributes = std::make_tuple();
+        static constexpr auto children = std::make_tuple(listChild("correspondences", &EarthRegistration::correspondences));
+    };
+
+    template<>
+    struct Schema<Polygon2D>
+    {
+        static constexpr const char* element = "polygon";
+        static constexpr auto attributes = std::make_tuple(
+            stringField("name", &Polygon2D::name),
+            field("method", &Polygon2D::method),
+            field("outdoor", &Polygon2D::isOutdoor));
+        static constexpr auto children = std::make_tuple(listChild(nullptr, &Polygon2D::points));
+    };
+
+    template<>
+    struct Schema<Outline>
+    {
+        static constexpr const char* element = "outline";
+        static constexpr auto attributes = std::make_tuple();
+        static constexpr auto children = std::make_tuple(listChild(nullptr, &Outline::polygons));
+    };
+
+    template<>
+    struct Schema<WallDoor>
+    {
+        static constexpr const char* element = "door";
+        static constexpr auto attributes = std::make_tuple(
+            field<WallDoor, DoorType>("type", &WallDoor::type),
+            field<WallDoor, WallMaterial>("material", &WallDoor::material),
+            field<WallDoor, float>("x01", &WallDoor::atLinePos),
+            field<WallDoor, float>("width", &WallDoor::width, 0.0f, FieldUnit::Length),
+            field<WallDoor, float>("heigth", &WallDoor::height, 0.0f, FieldUnit::Length),
+            field<WallDoor, bool>("lr", &WallDoor::leftRight),
+            field<WallDoor, bool>("io", &WallDoor::inOut));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<WallWindow>
+    {
+        static constexpr const char* element = "window";
+        static constexpr auto attributes = std::make_tuple(
+            field<WallWindow, WallMaterial>("material", &WallWindow::material),
+            field<WallWindow, float>("x01", &WallWindow::atLinePos),
+            field<WallWindow, float>("y", &WallWindow::atHeigth, 0.0f, FieldUnit::Length),
+            field<WallWindow, float>("width", &WallWindow::width, 0.0f, FieldUnit::Length),
+            field<WallWindow, float>("height", &WallWindow::height, 0.0f, FieldUnit::Length),
+            field<WallWindow, bool>("io", &WallWindow::inOut));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    // Missing thickness and height attributes decode to NaN, the parser replaces them by the defaults
+    template<>
+    struct Schema<Wall>
+    {
+        static constexpr const char* element = "wall";
+        static constexpr auto attributes = std::make_tuple(
+            field("material", &Wall::material),
+            field("type", &Wall::type),
+            pointField("x1", "y1", &Wall::x1, &Wall::y1),
+            pointField("x2", "y2", &Wall::x2, &Wall::y2),
+            field("thickness", &Wall::thickness, std::numeric_limits<float>::quiet_NaN(), FieldUnit::Length),
+            field("height", &Wall::height, std::numeric_limits<float>::quiet_NaN(), FieldUnit::Length));
+        static constexpr auto children = std::make_tuple(listChild(nullptr, &Wall::doors), listChild(nullptr, &Wall::windows));
+    };
+
+    template<>
+    struct Schema<LineObstacle>
+    {
+        static constexpr const char* element = "line";
+        static constexpr auto attributes = std::make_tuple(
+            field("material", &LineObstacle::material),
+            field("type", &LineObstacle::type),
+            pointField("x1", "y1", &LineObstacle::x1, &LineObstacle::y1),
+            pointField("x2", "y2", &LineObstacle::x2, &LineObstacle::y2),
+            field("thickness", &LineObstacle::thickness, std::numeric_limits<float>::quiet_NaN(), FieldUnit::Length),
+            field("height", &LineObstacle::height, std::numeric_limits<float>::quiet_NaN(), FieldUnit::Length));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<CircleObstacle>
+    {
+        static constexpr const char* element = "circle";
+        static constexpr auto attributes = std::make_tuple(
+            field("material", &CircleObstacle::material),
+            pointField("cx", "cy", &CircleObstacle::cx, &CircleObstacle::cy),
+            field("radius", &CircleObstacle::radius, 0.0f, FieldUnit::Length),
+            field("height", &CircleObstacle::height, std::numeric_limits<float>::quiet_NaN(), FieldUnit::Length));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<DoorObstacle>
+    {
+        static constexpr const char* element = "door";
+        static constexpr auto attributes = std::make_tuple(
+            field("type", &DoorObstacle::type),
+            field("material", &DoorObstacle::material),
+            pointField("x1", "y1", &DoorObstacle::x1, &DoorObstacle::y1),
+            pointField("x2", "y2", &DoorObstacle::x2, &DoorObstacle::y2),
+            field("height", &DoorObstacle::height, std::numeric_limits<float>::quiet_NaN(), FieldUnit::Length),
+            field("swap", &DoorObstacle::swap));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<ObjectObstacle>
+    {
+        static constexpr const char* element = "object";
+        static constexpr auto attributes = std::make_tuple(
+            stringField("file", &ObjectObstacle::file),
+            pointField("x", "y", &ObjectObstacle::x, &ObjectObstacle::y),
+            field("z", &ObjectObstacle::z, 0.0f, FieldUnit::Length),
+            field("rx", &ObjectObstacle::rx),
+            field("ry", &ObjectObstacle::ry),
+            field("rz", &ObjectObstacle::rz, 0.0f, FieldUnit::Degrees),
+            field("sx", &ObjectObstacle::sx, 1.0f, FieldUnit::Length),
+            field("sy", &ObjectObstacle::sy, 1.0f, FieldUnit::Length),
+            field("sz", &ObjectObstacle::sz, 1.0f, FieldUnit::Length));
+        static constexpr auto children = std::make_tuple(listChild(nullptr, &ObjectObstacle::footprint));
+    };
+
+    template<>
+    struct Schema<PointOfInterest>
+    {
+        static constexpr const char* element = "poi";
+        static constexpr auto attributes = std::make_tuple(
+            stringField("name", &PointOfInterest::name),
+            field("type", &PointOfInterest::type),
+            pointField("x", "y", &PointOfInterest::x, &PointOfInterest::y));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<GroundtruthPoint>
+    {
+        static constexpr const char* element = "gtpoint";
+        static constexpr auto attributes = std::make_tuple(
+            field("id", &GroundtruthPoint::id),
+            pointField("x", "y", &GroundtruthPoint::x, &GroundtruthPoint::y),
+            field("z", &GroundtruthPoint::heightAboveFloor, 0.0f, FieldUnit::Length),
+            binaryField("z", &GroundtruthPoint::z));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<AccessPoint>
+    {
+        static constexpr const char* element = "accesspoint";
+        static constexpr auto attributes = std::make_tuple(
+            stringField("name", &AccessPoint::name),
+            stringField("mac", &AccessPoint::macAddress),
+            pointField("x", "y", &AccessPoint::x, &AccessPoint::y),
+            field("z", &AccessPoint::heightAboveFloor, 0.0f, FieldUnit::Length),
+            field("mdl_txp", &AccessPoint::mdl_txp),
+            field("mdl_exp", &AccessPoint::mdl_exp),
+            field("mdl_waf", &AccessPoint::mdl_waf),
+            binaryField("z", &AccessPoint::z));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<Beacon>
+    {
+        static constexpr const char* element = "beacon";
+        static constexpr auto attributes = std::make_tuple(
+            stringField("name", &Beacon::name),
+            stringField("mac", &Beacon::macAddress),
+            stringField("uuid", &Beacon::uuid),
+            stringField("major", &Beacon::major),
+            stringField("minor", &Beacon::minor),
+            pointField("x", "y", &Beacon::x, &Beacon::y),
+            field("z", &Beacon::heightAboveFloor, 0.0f, FieldUnit::Length),
+            field("mdl_txp", &Beacon::mdl_txp),
+            field("mdl_exp", &Beacon::mdl_exp),
+            field("mdl_waf", &Beacon::mdl_waf),
+            binaryField("z", &Beacon::z));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<FingerprintLocation>
+    {
+        static constexpr const char* element = "location";
+        static constexpr auto attributes = std::make_tuple(
+            stringField("name", &FingerprintLocation::name),
+            pointField("x", "y", &FingerprintLocation::x, &FingerprintLocation::y),
+            field("dz", &FingerprintLocation::heightAboveFloor, 0.0f, FieldUnit::Length),
+            binaryField("z", &FingerprintLocation::z));
+        static constexpr auto children = std::make_tuple();
+    };
+
+    template<>
+    struct Schema<Floor>
+    {
+        static constexpr const char* element = "floor";
+        static constexpr auto attributes = std::make_tuple(
+            field("atHeight", &Floor::atHeight, 0.0f, FieldUnit::Height),
+            field("height", &Floor::height, 0.0f, FieldUnit::Length),
+            stringField("name", &Floor::name));
+        static constexpr auto children = std::make_tuple(
+            objectChild(&Floor::outline),
+            listChild("obstacles", &Floor::walls),
+            listChild("obstacles", &Floor::lineObstacles),
+            listChild("obstacles", &Floor::circleObstacles),
+            listChild("obstacles", &Floor::doorObstacles),
+            listChild("obstacles", &Floor::objectObstacles),
+            listChild("pois", &Floor::pois),
+            listChild("gtpoints", &Floor::groundtruthPoints),
+            listChild("accesspoints", &Floor::accessPoints),
+            listChild("beacons", &Floor::beacons),
+            listChild("fingerprints", &Floor::fingerprintLocations));
+    };
+
+    template<>
+    struct Schema<Map>
+    {
+        static constexpr const char* element = "map";
+        static constexpr auto attributes = std::make_tuple(
+            field("width", &Map::width, 0.0f, FieldUnit::Length),
+            field("depth", &Map::depth, 0.0f, FieldUnit::Length));
+        static constexpr auto children = std::make_tuple(
+            objectChild(&Map::earthRegistration),
+            listChild("floors", &Map::floors));
+    };
+
+    // XML attribute name of a field
+    struct AttributeName
+    {
+        const char* name;
+        uint32_t length;
+
+        // Index within Schema<T>::attributes and the coordinate for PointFields
+        uint8_t field;
+        uint8_t component;
+    };
+
+    // Perfect hash table over the attribute names of an element, built at compile time.
+    // A name is looked up by one hash, one table access and one comparison.
+    template<size_t NameCount, size_t FieldCount>
+    struct AttributeTable
+    {
+        static constexpr size_t Count = NameCount;
+
+        // Power of two of at least twice the number of names
+        static constexpr size_t Size = []() { size_t s = 1; while (s < 2 * NameCount) s *= 2; return s; }();
+        static constexpr uint8_t Empty = 0xFF;
+
+        std::array<AttributeName, NameCount> names{};
+        std::array<uint8_t, Size> slots{};
+
+        // Index of the first name of every field
+        std::array<uint8_t, FieldCount> first{};
+
+        uint32_t seed = 0;
+    };
+
+    namespace detail
+    {
+        constexpr uint32_t nameLength(const char* s)
+        {
+            uint32_t n = 0;
+            while (s[n])
+                n++;
+            return n;
+        }
+
+        // FNV-1a with a seed
+        constexpr uint32_t nameHash(const char* s, size_t length, uint32_t seed)
+        {
+            uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+            for (size_t i = 0; i < length; i++)
+            {
+                h ^= static_cast<uint8_t>(s[i]);
+                h *= 16777619u;
+            }
+            return h ^ (h >> 16);
+        }
+
+        template<typename T, typename M>
+        constexpr size_t nameCount(const ValueField<T, M>& f) { return f.binaryOnly ? 0 : 1; }
+
+        template<typename T>
+        constexpr size_t nameCount(const StringField<T>&) { return 1; }
+
+        template<typename T>
+        constexpr size_t nameCount(const PointField<T>&) { return 2; }
+
+        template<typename Tuple, size_t... I>
+        constexpr size_t totalNameCount(const Tuple& fields, std::index_sequence<I...>)
+        {
+            return (size_t(0) + ... + nameCount(std::get<I>(fields)));
+        }
+
+        template<typename Table, typename T, typename M>
+        constexpr void addNames(Table& table, size_t& n, size_t field, const ValueField<T, M>& f)
+        {
+            if (!f.binaryOnly)
+                table.names[n++] = AttributeName{ f.name, nameLength(f.name), static_cast<uint8_t>(field), 0 };
+        }
+
+        template<typename Table, typename T>
+        constexpr void addNames(Table& table, size_t& n, size_t field, const StringField<T>& f)
+        {
+            table.names[n++] = AttributeName{ f.name, nameLength(f.name), static_cast<uint8_t>(field), 0 };
+        }
+
+        template<typename Table, typename T>
+        constexpr void addNames(Table& table, size_t& n, size_t field, const PointField<T>& f)
+        {
+            table.names[n++] = AttributeName{ f.xName, nameLength(f.xName), static_cast<uint8_t>(field), 0 };
+            table.names[n++] = AttributeName{ f.yName, nameLength(f.yName), static_cast<uint8_t>(field), 1 };
+        }
+
+        template<typename T>
+        constexpr size_t attributeNameCount()
+        {
+            constexpr auto& fields = Schema<T>::attributes;
+            return totalNameCount(fields, std::make_index_sequence<std::tuple_size_v<std::decay_t<decltype(fields)>>>());
+        }
+
+        template<typename T>
+        constexpr size_t attributeFieldCount()
+        {
+            return std::tuple_size_v<std::decay_t<decltype(Schema<T>::attributes)>>;
+        }
+
+        template<typename Table, typename Tuple, size_t... I>
+        constexpr void addAllNames(Table& table, const Tuple& fields, std::index_sequence<I...>)
+        {
+            size_t n = 0;
+            ((table.first[I] = static_cast<uint8_t>(n), addNames(table, n, I, std::get<I>(fields))), ...);
+        }
+
+        template<typename T>
+        constexpr auto makeAttributeTable()
+        {
+            using Table = AttributeTable<attributeNameCount<T>(), attributeFieldCount<T>()>;
+            Table table;
+            addAllNames(table, Schema<T>::attributes, std::make_index_sequence<attributeFieldCount<T>()>());
+
+            for (uint32_t seed = 0; ; seed++)
+            {
+                if (seed > 100000)
+                    throw "duplicate attribute names";
+
+                for (size_t s = 0; s < Table::Size; s++)
+                    table.slots[s] = Table::Empty;
+
+                bool unique = true;
+                for (size_t i = 0; i < Table::Count && unique; i++)
+                {
+                    const size_t s = nameHash(table.names[i].name, table.names[i].length, seed) & (Table::Size - 1);
+                    unique = table.slots[s] == Table::Empty;
+                    table.slots[s] = static_cast<uint8_t>(i);
+                }
+
+                if (unique)
+                {
+                    table.seed = seed;
+                    return table;
+                }
+            }
+        }
+    }
+
+    template<typename T>
+    inline constexpr auto attributeTable = detail::makeAttributeTable<T>();
+
+    // Index of the attribute name within attributeTable<T>.names or -1
+    template<typename T>
+    int findAttribute(const char* name, size_t length)
+    {
+        constexpr auto& table = attributeTable<T>;
+        const uint8_t i = table.slots[detail::nameHash(name, length, table.seed) & (table.Size - 1)];
+        if (i == table.Empty)
+            return -1;
+
+        const AttributeName& n = table.names[i];
+        return n.length == length && std::memcmp(n.name, name, length) == 0 ? i : -1;
+    }
+
+    namespace detail
+    {
+        // Parses an attribute value. On error the value is kept and context.error(where, message) is called.
+        template<typename M, typename Context>
+        void parseValue(const char* v, M& value, Context& context)
+        {
+            if constexpr (std::is_same_v<M, float>)
+            {
+                char* end;
+                errno = 0;
+                const float parsed = std::strtof(v, &end);
+                if (end == v || (errno == ERANGE && std::isinf(parsed)))
+                    context.error(v, "Invalid float attribute");
+                else
+                    value = parsed;
+            }
+            else if constexpr (std::is_same_v<M, bool>)
+            {
+                if (std::strcmp(v, "true") == 0)
+                    value = true;
+                else if (std::strcmp(v, "false") == 0)
+                    value = false;
+                else
+                    context.error(v, "Invalid boolean attribute");
+            }
+            else
+            {
+                static_assert(std::is_same_v<M, int> || std::is_enum_v<M>, "unsupported attribute type");
+                char* end;
+                errno = 0;
+                const long parsed = std::strtol(v, &end, 10);
+                if (end == v || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX)
+                    context.error(v, "Invalid integer attribute");
+                else
+                    value = static_cast<M>(parsed);
+            }
+        }
+
+        template<typename Context>
+        float applyUnit(float value, FieldUnit unit, Context& context)
+        {
+            switch (unit)
+            {
+            case FieldUnit::Length: return context.length(value);
+            case FieldUnit::Height: return context.height(value);
+            case FieldUnit::Degrees: return context.degrees(value);
+            default: return value;
+            }
+        }
+
+        template<typename T, typename M, typename Values, typename Context>
+        void decodeField(const ValueField<T, M>& f, size_t first, const Values& values, T& object, Context& context)
+        {
+            if (f.binaryOnly)
+                return;
+
+            M value = f.defaultValue;
+            if (values[first])
+                parseValue(values[first], value, context);
+
+            if constexpr (std::is_same_v<M, float>)
+                value = applyUnit(value, f.unit, context);
+            object.*f.member = value;
+        }
+
+        template<typename T, typename Values, typename Context>
+        void decodeField(const StringField<T>& f, size_t first, const Values& values, T& object, Context&)
+        {
+            if (values[first])
+                object.*f.member = values[first];
+            else
+                (object.*f.member).clear();
+        }
+
+        template<typename T, typename Values, typename Context>
+        void decodeField(const PointField<T>& f, size_t first, const Values& values, T& object, Context& context)
+        {
+            float x = 0.0f, y = 0.0f;
+            if (values[first])
+                parseValue(values[first], x, context);
+            if (values[first + 1])
+                parseValue(values[first + 1], y, context);
+
+            const Point2D p = context.point(x, y);
+            object.*f.x = p.x;
+            object.*f.y = p.y;
+        }
+
+        template<typename T, typename Values, typename Context, size_t... I>
+        void decodeFields(const Values& values, T& object, Context& context, std::index_sequence<I...>)
+        {
+            constexpr auto& table = attributeTable<T>;
+            (decodeField(std::get<I>(Schema<T>::attributes), table.first[I], values, object, context), ...);
+        }
+    }
+
+    // Decodes the attributes of an XML element (rapidxml node) into object, missing attributes get their defaults.
+    // The attributes are scanned once, each name is dispatched by the perfect hash. Unknown attributes are ignored,
+    // for repeated attributes the first one counts.
+    // Context provides point(x, y), length(v), height(z), degrees(a) for the units and error(where, message).
+    template<typename T, typename Node, typename Context>
+    void decodeAttributes(const Node* node, T& object, Context& context)
+    {
+        constexpr auto& table = attributeTable<T>;
+        std::array<const char*, table.Count + 1> values{};
+
+        for (auto* a = node->first_attribute(); a; a = a->next_attribute())
+        {
+            const int i = findAttribute<T>(a->name(), a->name_size());
+            if (i >= 0 && !values[i])
+                values[i] = a->value();
+        }
+
+        detail::decodeFields(values, object, context, std::make_index_sequence<detail::attributeFieldCount<T>()>());
+    }
+
+    // Calls func(field) for every attribute field of T in schema order
+    template<typename T, typename Func>
+    void forEachSchemaAttribute(Func func)
+    {
+        std::apply([&](const auto&... fields) { (func(fields), ...); }, Schema<T>::attributes);
+    }
+
+    // Calls func(child) for every child description of T in schema order
+    template<typename T, typename Func>
+    void forEachSchemaChild(Func func)
+    {
+        std::apply([&](const auto&... children) { (func(children), ...); }, Schema<T>::children);
+    }
+}
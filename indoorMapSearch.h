@@ -0,0 +1,428 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "indoorMap.h"
+
+namespace Indoor::Map
+{
+    enum class SearchSource
+    {
+        PointOfInterest,
+        Polygon
+    };
+
+    struct SearchHit
+    {
+        // Id passed to PoiSearchIndex::addMap()
+        uint32_t map;
+        uint32_t floor;
+
+        SearchSource source;
+
+        // Index within Floor::pois or Floor::outline.polygons
+        uint32_t index;
+
+        // Copy of the name, hits stay valid when the index changes or is destroyed
+        std::string name;
+
+        // POI position or polygon centroid
+        Point2D position;
+
+        // Number of edits needed to match the query, 0 for prefix matches
+        int edits;
+
+        // Distance to SearchOptions::position if given, otherwise 0
+        float distance;
+    };
+
+    struct SearchOptions
+    {
+        // Hits on this floor of this map are ranked first, -1 to disable
+        int map = -1;
+        int floor = -1;
+
+        // Hits are ranked by their distance to this position
+        bool hasPosition = false;
+        Point2D position;
+
+        size_t maxResults = 10;
+
+        // Maximum edit distance of fuzzy matches, -1 chooses by query length
+        int maxEdits = -1;
+    };
+
+    // Search index over the names of POIs and outline polygons of one or many maps.
+    // Prefix search runs on a sorted key table: every word of a name is a key, thus "hall" finds "Lecture Hall".
+    // Fuzzy search collects candidates sharing trigrams with the query and verifies them with a bounded Levenshtein distance.
+    // Names are compared case insensitive (ASCII only).
+    class PoiSearchIndex
+    {
+    private:
+        struct Entry
+        {
+            uint32_t map;
+            uint32_t floor;
+            SearchSource source;
+            uint32_t index;
+            std::string name;
+            std::string normalized;
+            Point2D position;
+        };
+
+        struct Key
+        {
+            // Range of keyBlob
+            uint32_t offset;
+            uint32_t length;
+            uint32_t entry;
+        };
+
+        std::vector<Entry> entries;
+
+        // All keys are stored in one blob, keys are sorted for binary search
+        std::string keyBlob;
+        std::vector<Key> keys;
+        bool sorted = true;
+
+        // Trigram -> entries containing it (sorted, unique)
+        std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams;
+
+        // Hit before ranking, names are copied only into the returned hits
+        struct Match
+        {
+            uint32_t entry;
+            int edits;
+            float distance;
+        };
+
+        static std::string normalize(std::string_view str)
+        {
+            std::string result;
+            result.reserve(str.size());
+            bool space = true;
+            for (char c : str)
+            {
+                if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '_' || c == '-')
+                {
+                    if (!space)
+                        result.push_back(' ');
+                    space = true;
+                    continue;
+                }
+
+                result.push_back((c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c);
+                space = false;
+            }
+
+            if (!result.empty() && result.back() == ' ')
+                result.pop_back();
+            return result;
+        }
+
+        static uint32_t trigram(const std::string& s, size_t i)
+        {
+            return (static_cast<uint32_t>(static_cast<unsigned char>(s[i])) << 16)
+                 | (static_cast<uint32_t>(static_cast<unsigned char>(s[i + 1])) << 8)
+                 | static_cast<uint32_t>(static_cast<unsigned char>(s[i + 2]));
+        }
+
+        // Sorted, unique trigrams of the string
+        static std::vector<uint32_t> trigramsOf(const std::string& str)
+        {
+            std::vector<uint32_t> result;
+            for (size_t i = 0; i + 3 <= str.size(); i++)
+                result.push_back(trigram(str, i));
+
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+            return result;
+        }
+
+        // Names are indexed padded, e.g. "  ab " for "ab", thus short names have trigrams, too.
+        static std::string padded(const std::string& normalized)
+        {
+            return "  " + normalized + " ";
+        }
+
+        std::string_view keyString(const Key& key) const
+        {
+            return std::string_view(keyBlob.data() + key.offset, key.length);
+        }
+
+        void ensureSorted()
+        {
+            if (sorted)
+                return;
+
+            std::sort(keys.begin(), keys.end(), [this](const Key& a, const Key& b)
+            {
+                return keyString(a) < keyString(b);
+            });
+            sorted = true;
+        }
+
+        void addEntry(Entry entry)
+        {
+            entry.normalized = normalize(entry.name);
+            if (entry.normalized.empty())
+                return;
+
+            const uint32_t id = static_cast<uint32_t>(entries.size());
+
+            // One key per word, referencing the rest of the name
+            const uint32_t offset = static_cast<uint32_t>(keyBlob.size());
+            keyBlob += entry.normalized;
+            for (size_t i = 0; i < entry.normalized.size(); i++)
+            {
+                if (i == 0 || entry.normalized[i - 1] == ' ')
+                {
+                    keys.push_back(Key{ offset + static_cast<uint32_t>(i), static_cast<uint32_t>(entry.normalized.size() - i), id });
+                }
+            }
+            sorted = false;
+
+            for (uint32_t t : trigramsOf(padded(entry.normalized)))
+                trigrams[t].push_back(id);
+
+            entries.push_back(std::move(entry));
+        }
+
+        // Levenshtein distance, returns maxEdits + 1 if the distance exceeds maxEdits.
+        static int boundedLevenshtein(std::string_view a, std::string_view b, int maxEdits)
+        {
+            const int la = static_cast<int>(a.size());
+            const int lb = static_cast<int>(b.size());
+            if (std::abs(la - lb) > maxEdits)
+                return maxEdits + 1;
+
+            // Rows are reused by the queries of a thread
+            thread_local std::vector<int> prev, cur;
+            prev.resize(lb + 1);
+            cur.resize(lb + 1);
+            for (int j = 0; j <= lb; j++)
+                prev[j] = j;
+
+            for (int i = 1; i <= la; i++)
+            {
+                cur[0] = i;
+                int rowMin = cur[0];
+                for (int j = 1; j <= lb; j++)
+                {
+                    const int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+                    cur[j] = std::min({ prev[j] + 1, cur[j - 1] + 1, prev[j - 1] + cost });
+                    rowMin = std::min(rowMin, cur[j]);
+                }
+
+                if (rowMin > maxEdits)
+                    return maxEdits + 1;
+                std::swap(prev, cur);
+            }
+
+            return std::min(prev[lb], maxEdits + 1);
+        }
+
+        // Smallest edit distance of the query to the whole name, a word or a prefix of a word sequence.
+        static int matchEdits(const std::string& query, const std::string& name, int maxEdits)
+        {
+            int best = boundedLevenshtein(query, name, maxEdits);
+            for (size_t i = 0; i < name.size() && best > 0; i++)
+            {
+                if (i != 0 && name[i - 1] != ' ')
+                    continue;
+
+                const std::string_view rest = std::string_view(name).substr(i);
+                const size_t wordEnd = std::min(rest.find(' '), rest.size());
+                best = std::min(best, boundedLevenshtein(query, rest.substr(0, wordEnd), maxEdits));
+                best = std::min(best, boundedLevenshtein(query, rest.substr(0, std::min(rest.size(), query.size())), maxEdits));
+            }
+            return best;
+        }
+
+        Match makeMatch(uint32_t id, int edits, const SearchOptions& options) const
+        {
+            const Entry& e = entries[id];
+            const float distance = options.hasPosition ? (e.position - options.position).length() : 0.0f;
+            return Match{ id, edits, distance };
+        }
+
+        // Sorts the matches and returns the best ones as hits
+        std::vector<SearchHit> rank(std::vector<Match>& matches, const SearchOptions& options) const
+        {
+            auto onFloor = [&](const Match& m)
+            {
+                const Entry& e = entries[m.entry];
+                return (options.map < 0 || e.map == static_cast<uint32_t>(options.map))
+                    && (options.floor < 0 || e.floor == static_cast<uint32_t>(options.floor));
+            };
+
+            std::stable_sort(matches.begin(), matches.end(), [&](const Match& a, const Match& b)
+            {
+                if (a.edits != b.edits) return a.edits < b.edits;
+                const bool fa = onFloor(a), fb = onFloor(b);
+                if (fa != fb) return fa;
+                if (a.distance != b.distance) return a.distance < b.distance;
+                return entries[a.entry].name < entries[b.entry].name;
+            });
+
+            std::vector<SearchHit> hits;
+            hits.reserve(std::min(matches.size(), options.maxResults));
+            for (size_t i = 0; i < matches.size() && i < options.maxResults; i++)
+            {
+                const Entry& e = entries[matches[i].entry];
+                hits.push_back(SearchHit{ e.map, e.floor, e.source, e.index, e.name, e.position, matches[i].edits, matches[i].distance });
+            }
+            return hits;
+        }
+
+    public:
+        PoiSearchIndex() = default;
+
+        explicit PoiSearchIndex(const Map& map)
+        {
+            addMap(map, 0);
+        }
+
+        // Adds all named POIs and outline polygons of the map.
+        void addMap(const Map& map, uint32_t mapId)
+        {
+            for (size_t f = 0; f < map.floors.size(); f++)
+            {
+                const Floor& floor = map.floors[f];
+                for (size_t i = 0; i < floor.pois.size(); i++)
+                {
+                    const PointOfInterest& poi = floor.pois[i];
+                    addEntry(Entry{ mapId, static_cast<uint32_t>(f), SearchSource::PointOfInterest, static_cast<uint32_t>(i),
+                                    poi.name, std::string(), Point2D(poi.x, poi.y) });
+                }
+
+                for (size_t i = 0; i < floor.outline.polygons.size(); i++)
+                {
+                    const Polygon2D& polygon = floor.outline.polygons[i];
+
+                    Point2D centroid;
+                    for (const Point2D& p : polygon.points)
+                        centroid = centroid + p;
+                    if (!polygon.points.empty())
+                        centroid = centroid / static_cast<float>(polygon.points.size());
+
+                    addEntry(Entry{ mapId, static_cast<uint32_t>(f), SearchSource::Polygon, static_cast<uint32_t>(i),
+                                    polygon.name, std::string(), centroid });
+                }
+            }
+
+            ensureSorted();
+        }
+
+        size_t size() const { return entries.size(); }
+
+        // Names containing a word starting with the query.
+        std::vector<SearchHit> prefix(const std::string& query, const SearchOptions& options = SearchOptions()) const
+        {
+            const std::string q = normalize(query);
+            if (q.empty())
+                return std::vector<SearchHit>();
+
+            auto it = std::lower_bound(keys.begin(), keys.end(), q, [this](const Key& key, const std::string& value)
+            {
+                return keyString(key) < value;
+            });
+
+            // Scratch buffers are reused by the queries of a thread
+            thread_local std::vector<uint32_t> found;
+            thread_local std::vector<Match> matches;
+            found.clear();
+            matches.clear();
+            for (; it != keys.end(); ++it)
+            {
+                const std::string_view key = keyString(*it);
+                if (key.compare(0, q.size(), q) != 0)
+                    break;
+                found.push_back(it->entry);
+            }
+
+            // A name matches once even if several words start with the query
+            std::sort(found.begin(), found.end());
+            found.erase(std::unique(found.begin(), found.end()), found.end());
+
+            for (uint32_t id : found)
+                matches.push_back(makeMatch(id, 0, options));
+
+            return rank(matches, options);
+        }
+
+        // Names within maxEdits of the query, a word of the name or a prefix of the name's words.
+        std::vector<SearchHit> fuzzy(const std::string& query, const SearchOptions& options = SearchOptions()) const
+        {
+            const std::string q = normalize(query);
+            if (q.empty())
+                return std::vector<SearchHit>();
+
+            const int maxEdits = options.maxEdits >= 0 ? options.maxEdits : (q.size() <= 3 ? 0 : (q.size() <= 6 ? 1 : 2));
+
+            // The query may match any part of a name, thus only its inner trigrams are used.
+            // Every edit destroys at most 3 of them.
+            const std::vector<uint32_t> queryTrigrams = trigramsOf(q.size() >= 3 ? q : padded(q));
+            const int minShared = std::max(1, static_cast<int>(queryTrigrams.size()) - 3 * maxEdits);
+
+            // Scratch buffers are reused by the queries of a thread
+            thread_local std::vector<uint32_t> candidates;
+            thread_local std::vector<Match> matches;
+            candidates.clear();
+            matches.clear();
+            for (uint32_t t : queryTrigrams)
+            {
+                auto it = trigrams.find(t);
+                if (it != trigrams.end())
+                    candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+            }
+            std::sort(candidates.begin(), candidates.end());
+
+            for (size_t i = 0; i < candidates.size();)
+            {
+                size_t j = i;
+                while (j < candidates.size() && candidates[j] == candidates[i])
+                    j++;
+
+                const Entry& e = entries[candidates[i]];
+                if (static_cast<int>(j - i) >= minShared)
+                {
+                    const int edits = matchEdits(q, e.normalized, maxEdits);
+                    if (edits <= maxEdits)
+                        matches.push_back(makeMatch(candidates[i], edits, options));
+                }
+                i = j;
+            }
+
+            return rank(matches, options);
+        }
+
+        // Prefix matches first, filled up with fuzzy matches.
+        std::vector<SearchHit> search(const std::string& query, const SearchOptions& options = SearchOptions()) const
+        {
+            std::vector<SearchHit> hits = prefix(query, options);
+            if (hits.size() >= options.maxResults)
+                return hits;
+
+            for (const SearchHit& hit : fuzzy(query, options))
+            {
+                const bool known = std::any_of(hits.begin(), hits.end(), [&hit](const SearchHit& h)
+                {
+                    return h.map == hit.map && h.floor == hit.floor && h.source == hit.source && h.index == hit.index;
+                });
+
+                if (!known)
+                    hits.push_back(hit);
+                if (hits.size() >= options.maxResults)
+                    break;
+            }
+            return hits;
+        }
+    };
+}
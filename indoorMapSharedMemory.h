@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "indoorMap.h"
+#include "indoorMapFlat.h"
+
+namespace Indoor::Map
+{
+    // Read-only mapping of a flat map published by another process.
+    // Attaching does not copy the map, all processes share the same physical pages.
+    class SharedMap
+    {
+    private:
+        void* memory = MAP_FAILED;
+        size_t size = 0;
+        FlatMapView mapView;
+
+        static std::runtime_error systemError(const std::string& what)
+        {
+            return std::runtime_error(what + ": " + std::strerror(errno));
+        }
+
+        void unmap()
+        {
+            if (memory != MAP_FAILED)
+                munmap(memory, size);
+
+            memory = MAP_FAILED;
+            size = 0;
+            mapView = FlatMapView();
+        }
+
+        static SharedMap mapFd(int fd, const std::string& what)
+        {
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+                throw systemError(what);
+
+            SharedMap result;
+            result.size = static_cast<size_t>(st.st_size);
+            result.memory = mmap(nullptr, result.size, PROT_READ, MAP_SHARED, fd, 0);
+            if (result.memory == MAP_FAILED)
+                throw systemError(what);
+
+            result.mapView = FlatMapView(result.memory, result.size);
+            if (!result.mapView.valid())
+                throw std::runtime_error(what + ": not a flat map of version " + std::to_string(FlatMapVersion));
+
+            return result;
+        }
+
+        static void writeFd(int fd, const FlatMapBuilder& builder, const std::string& what)
+        {
+            if (ftruncate(fd, static_cast<off_t>(builder.size())) != 0)
+                throw systemError(what);
+
+            void* memory = mmap(nullptr, builder.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (memory == MAP_FAILED)
+                throw systemError(what);
+
+            builder.writeTo(memory);
+            munmap(memory, builder.size());
+        }
+
+    public:
+        SharedMap() = default;
+
+        SharedMap(const SharedMap&) = delete;
+        SharedMap& operator=(const SharedMap&) = delete;
+
+        SharedMap(SharedMap&& other) noexcept
+            : memory(other.memory), size(other.size), mapView(other.mapView)
+        {
+            other.memory = MAP_FAILED;
+            other.size = 0;
+            other.mapView = FlatMapView();
+        }
+
+        SharedMap& operator=(SharedMap&& other) noexcept
+        {
+            if (this != &other)
+            {
+                unmap();
+                std::swap(memory, other.memory);
+                std::swap(size, other.size);
+                std::swap(mapView, other.mapView);
+            }
+            return *this;
+        }
+
+        ~SharedMap()
+        {
+            unmap();
+        }
+
+        bool valid() const { return mapView.valid(); }
+
+        const FlatMapView& view() const { return mapView; }
+
+        // Publishes the map under a POSIX shared memory name like "/building42".
+        // A previously published segment of the same name is unlinked first. Processes which are attached to it
+        // keep their mapping until they detach, new processes attach to the new segment.
+        // Compare the header's generation or content hash to detect updates.
+        static void publish(const std::string& name, const Map& map, uint64_t generation = 0)
+        {
+            const std::string what = "Publishing indoor map '" + name + "'";
+            FlatMapBuilder builder(map, generation);
+
+            // POSIX shared memory can not be renamed atomically. The header is written last, thus attach() rejects
+            // the segment until it is complete and callers can simply retry.
+            shm_unlink(name.c_str());
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+            if (fd < 0)
+                throw systemError(what);
+
+            try
+            {
+                writeFd(fd, builder, what);
+            }
+            catch (...)
+            {
+                close(fd);
+                shm_unlink(name.c_str());
+                throw;
+            }
+
+            close(fd);
+        }
+
+        // Removes the name, attached processes keep their mapping.
+        static void unpublish(const std::string& name)
+        {
+            shm_unlink(name.c_str());
+        }
+
+        // Maps a segment published with publish() read-only.
+        static SharedMap attach(const std::string& name)
+        {
+            const std::string what = "Attaching indoor map '" + name + "'";
+
+            int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                throw systemError(what);
+
+            try
+            {
+                SharedMap result = mapFd(fd, what);
+                close(fd);
+                return result;
+            }
+            catch (...)
+            {
+                close(fd);
+                throw;
+            }
+        }
+
+#if defined(__linux__)
+        // Writes the map into an anonymous, sealed memory file and returns its descriptor.
+        // The descriptor can be passed to other processes, e.g. via fork or a unix domain socket (SCM_RIGHTS).
+        // The caller owns the descriptor.
+        static int publishMemfd(const Map& map, uint64_t generation = 0)
+        {
+            const std::string what = "Publishing indoor map memfd";
+            FlatMapBuilder builder(map, generation);
+
+            int fd = memfd_create("indoor-map", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+            if (fd < 0)
+                throw systemError(what);
+
+            try
+            {
+                writeFd(fd, builder, what);
+
+                // Receivers can rely on the content never changing
+                if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+                    throw systemError(what);
+            }
+            catch (...)
+            {
+                close(fd);
+                throw;
+            }
+
+            return fd;
+        }
+#endif
+
+        // Maps a descriptor returned by publishMemfd() read-only. The descriptor can be closed afterwards.
+        static SharedMap attachFd(int fd)
+        {
+            return mapFd(fd, "Attaching indoor map descriptor");
+        }
+    };
+}
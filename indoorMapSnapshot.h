@@ -0,0 +1,293 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapDiff.h"
+#include "indoorMapHash.h"
+
+namespace Indoor::Map
+{
+    // Immutable version of Floor.
+    // The element lists are reference counted and shared between snapshots, i.e. a new snapshot only
+    // allocates the lists which actually changed.
+    struct FloorSnapshot
+    {
+        float atHeight = 0.0f;
+        float height = 0.0f;
+        std::string name;
+
+        std::shared_ptr<const Outline> outline;
+        std::shared_ptr<const std::vector<Wall>> walls;
+        std::shared_ptr<const std::vector<LineObstacle>> lineObstacles;
+        std::shared_ptr<const std::vector<CircleObstacle>> circleObstacles;
+        std::shared_ptr<const std::vector<DoorObstacle>> doorObstacles;
+        std::shared_ptr<const std::vector<ObjectObstacle>> objectObstacles;
+        std::shared_ptr<const std::vector<AccessPoint>> accessPoints;
+        std::shared_ptr<const std::vector<Beacon>> beacons;
+        std::shared_ptr<const std::vector<GroundtruthPoint>> groundtruthPoints;
+        std::shared_ptr<const std::vector<FingerprintLocation>> fingerprintLocations;
+        std::shared_ptr<const std::vector<PointOfInterest>> pois;
+
+        // Creates a mutable copy
+        Floor toFloor() const
+        {
+            Floor floor;
+            floor.atHeight = atHeight;
+            floor.height = height;
+            floor.name = name;
+            floor.outline = *outline;
+            floor.walls = *walls;
+            floor.lineObstacles = *lineObstacles;
+            floor.circleObstacles = *circleObstacles;
+            floor.doorObstacles = *doorObstacles;
+            floor.objectObstacles = *objectObstacles;
+            floor.accessPoints = *accessPoints;
+            floor.beacons = *beacons;
+            floor.groundtruthPoints = *groundtruthPoints;
+            floor.fingerprintLocations = *fingerprintLocations;
+            floor.pois = *pois;
+            return floor;
+        }
+    };
+
+    using FloorSnapshotPtr = std::shared_ptr<const FloorSnapshot>;
+
+    // Immutable version of Map. Floors are shared between snapshots.
+    struct MapSnapshot
+    {
+        // Incremented by every published update, see MapSnapshotStore
+        uint64_t version = 0;
+
+        // MapHash::all of the content, patches are only applied to the snapshot they were computed from
+        Hash128 contentHash;
+
+        float width = 0.0f;
+        float depth = 0.0f;
+
+        std::shared_ptr<const EarthRegistration> earthRegistration;
+        std::vector<FloorSnapshotPtr> floors;
+
+        // Creates a mutable copy
+        Map toMap() const
+        {
+            Map map;
+            map.width = width;
+            map.depth = depth;
+            map.earthRegistration = *earthRegistration;
+
+            map.floors.reserve(floors.size());
+            for (const FloorSnapshotPtr& floor : floors)
+            {
+                map.floors.push_back(floor->toFloor());
+            }
+
+            return map;
+        }
+    };
+
+    using MapSnapshotPtr = std::shared_ptr<const MapSnapshot>;
+
+    inline FloorSnapshotPtr makeFloorSnapshot(Floor floor)
+    {
+        auto snapshot = std::make_shared<FloorSnapshot>();
+        snapshot->atHeight = floor.atHeight;
+        snapshot->height = floor.height;
+        snapshot->name = std::move(floor.name);
+        snapshot->outline = std::make_shared<const Outline>(std::move(floor.outline));
+        snapshot->walls = std::make_shared<const std::vector<Wall>>(std::move(floor.walls));
+        snapshot->lineObstacles = std::make_shared<const std::vector<LineObstacle>>(std::move(floor.lineObstacles));
+        snapshot->circleObstacles = std::make_shared<const std::vector<CircleObstacle>>(std::move(floor.circleObstacles));
+        snapshot->doorObstacles = std::make_shared<const std::vector<DoorObstacle>>(std::move(floor.doorObstacles));
+        snapshot->objectObstacles = std::make_shared<const std::vector<ObjectObstacle>>(std::move(floor.objectObstacles));
+        snapshot->accessPoints = std::make_shared<const std::vector<AccessPoint>>(std::move(floor.accessPoints));
+        snapshot->beacons = std::make_shared<const std::vector<Beacon>>(std::move(floor.beacons));
+        snapshot->groundtruthPoints = std::make_shared<const std::vector<GroundtruthPoint>>(std::move(floor.groundtruthPoints));
+        snapshot->fingerprintLocations = std::make_shared<const std::vector<FingerprintLocation>>(std::move(floor.fingerprintLocations));
+        snapshot->pois = std::make_shared<const std::vector<PointOfInterest>>(std::move(floor.pois));
+        return snapshot;
+    }
+
+    // Pass an rvalue to avoid copying the map.
+    inline MapSnapshotPtr makeSnapshot(Map map)
+    {
+        auto snapshot = std::make_shared<MapSnapshot>();
+        snapshot->contentHash = contentHash(map).all;
+        snapshot->width = map.width;
+        snapshot->depth = map.depth;
+        snapshot->earthRegistration = std::make_shared<const EarthRegistration>(std::move(map.earthRegistration));
+
+        snapshot->floors.reserve(map.floors.size());
+        for (Floor& floor : map.floors)
+        {
+            snapshot->floors.push_back(makeFloorSnapshot(std::move(floor)));
+        }
+
+        return snapshot;
+    }
+
+    namespace detail
+    {
+        // Returns the shared list if nothing changed, otherwise a patched copy.
+        template<typename T>
+        std::shared_ptr<const std::vector<T>> applyShared(const std::shared_ptr<const std::vector<T>>& elements, const ElementChanges<T>& changes)
+        {
+            if (changes.empty())
+                return elements;
+
+            auto result = std::make_shared<std::vector<T>>(*elements);
+            applyChanges(*result, changes);
+            return result;
+        }
+    }
+
+    // Applies the changes to a floor. Unchanged element lists are shared with the given floor.
+    inline FloorSnapshotPtr apply(const FloorSnapshotPtr& floor, const FloorPatch& patch)
+    {
+        if (patch.empty())
+            return floor;
+
+        auto result = std::make_shared<FloorSnapshot>(*floor);
+
+        if (patch.attributesChanged)
+        {
+            result->atHeight = patch.atHeight;
+            result->height = patch.height;
+            result->name = patch.name;
+        }
+
+        if (!patch.outline.empty())
+        {
+            auto outline = std::make_shared<Outline>(*floor->outline);
+            detail::applyChanges(outline->polygons, patch.outline);
+            result->outline = outline;
+        }
+
+        result->walls = detail::applyShared(floor->walls, patch.walls);
+        result->lineObstacles = detail::applyShared(floor->lineObstacles, patch.lineObstacles);
+        result->circleObstacles = detail::applyShared(floor->circleObstacles, patch.circleObstacles);
+        result->doorObstacles = detail::applyShared(floor->doorObstacles, patch.doorObstacles);
+        result->objectObstacles = detail::applyShared(floor->objectObstacles, patch.objectObstacles);
+        result->accessPoints = detail::applyShared(floor->accessPoints, patch.accessPoints);
+        result->beacons = detail::applyShared(floor->beacons, patch.beacons);
+        result->groundtruthPoints = detail::applyShared(floor->groundtruthPoints, patch.groundtruthPoints);
+        result->fingerprintLocations = detail::applyShared(floor->fingerprintLocations, patch.fingerprintLocations);
+        result->pois = detail::applyShared(floor->pois, patch.pois);
+
+        return result;
+    }
+
+    // Creates a new snapshot by applying the patch. Unchanged floors and element lists are shared.
+    // The version is taken over from the given snapshot. Returns nullptr if the patch was not computed
+    // from a map with the content of the snapshot (MapPatch::baseHash).
+    inline MapSnapshotPtr apply(const MapSnapshotPtr& map, const MapPatch& patch)
+    {
+        if (map->contentHash != patch.baseHash)
+            return nullptr;
+
+        auto result = std::make_shared<MapSnapshot>();
+        result->version = map->version;
+        result->contentHash = patch.targetHash;
+        result->width = patch.attributesChanged ? patch.width : map->width;
+        result->depth = patch.attributesChanged ? patch.depth : map->depth;
+        result->earthRegistration = patch.earthRegistrationChanged
+            ? std::make_shared<const EarthRegistration>(patch.earthRegistration)
+            : map->earthRegistration;
+
+        result->floors = detail::applyFloors(map->floors, patch,
+            [](const FloorSnapshotPtr& floor, const FloorPatch& fp) { return apply(floor, fp); },
+            [](const Floor& floor) { return makeFloorSnapshot(floor); });
+
+        return result;
+    }
+
+    // Holds the current snapshot of a map.
+    // Readers obtain the current snapshot with load() and keep using it as long as they hold the pointer,
+    // even if a writer publishes a new version in the meantime (RCU style).
+    // Old versions are freed when the last reader drops its pointer.
+    // Only the pointer exchange is synchronized, readers never wait for a writer computing a new snapshot.
+    // The exchange itself is not necessarily lock-free, libstdc++ implements atomic shared_ptr with a lock pool.
+    class MapSnapshotStore
+    {
+    private:
+#if defined(__cpp_lib_atomic_shared_ptr)
+        std::atomic<MapSnapshotPtr> current;
+#else
+        // std::atomic_load/std::atomic_store overloads for shared_ptr
+        MapSnapshotPtr current;
+#endif
+
+        MapSnapshotPtr atomicLoad() const
+        {
+#if defined(__cpp_lib_atomic_shared_ptr)
+            return current.load(std::memory_order_acquire);
+#else
+            return std::atomic_load_explicit(&current, std::memory_order_acquire);
+#endif
+        }
+
+        bool atomicCompareExchange(MapSnapshotPtr& expected, MapSnapshotPtr desired)
+        {
+#if defined(__cpp_lib_atomic_shared_ptr)
+            return current.compare_exchange_strong(expected, std::move(desired), std::memory_order_acq_rel);
+#else
+            return std::atomic_compare_exchange_strong_explicit(&current, &expected, std::move(desired),
+                                                                std::memory_order_acq_rel, std::memory_order_acquire);
+#endif
+        }
+
+    public:
+        MapSnapshotStore()
+            : current(makeSnapshot(Map()))
+        {}
+
+        explicit MapSnapshotStore(MapSnapshotPtr snapshot)
+            : current(std::move(snapshot))
+        {}
+
+        MapSnapshotPtr load() const
+        {
+            return atomicLoad();
+        }
+
+        // Replaces the current snapshot. The version is incremented.
+        MapSnapshotPtr publish(const MapSnapshotPtr& snapshot)
+        {
+            return update([&snapshot](const MapSnapshotPtr&) { return snapshot; });
+        }
+
+        // Applies the patch to the current snapshot. If the current snapshot is not the map the patch was computed
+        // from, e.g. because another writer published first, nothing is published and nullptr is returned.
+        // Compute the patch against load() again then.
+        MapSnapshotPtr publish(const MapPatch& patch)
+        {
+            return update([&patch](const MapSnapshotPtr& map) { return apply(map, patch); });
+        }
+
+        // Computes a new snapshot from the current one and publishes it.
+        // If another writer published in the meantime, the update function is called again with the newer snapshot.
+        // If the update function returns nullptr, nothing is published and nullptr is returned.
+        MapSnapshotPtr update(const std::function<MapSnapshotPtr(const MapSnapshotPtr&)>& updateFunc)
+        {
+            MapSnapshotPtr expected = atomicLoad();
+            while (true)
+            {
+                MapSnapshotPtr computed = updateFunc(expected);
+                if (!computed)
+                    return nullptr;
+
+                auto next = std::make_shared<MapSnapshot>(*computed);
+                next->version = expected->version + 1;
+
+                MapSnapshotPtr desired = next;
+                if (atomicCompareExchange(expected, desired))
+                    return desired;
+            }
+        }
+    };
+}
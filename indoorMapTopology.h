@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapWallIndex.h"
+
+namespace Indoor::Map
+{
+    // Wall (or piece of a wall) between two shared vertices.
+    struct TopologyEdge
+    {
+        uint32_t a;
+        uint32_t b;
+
+        WallMaterial material;
+        float thickness;
+        float height;
+
+        // Walls the edge was made of: edgeWalls[wallsBegin .. wallsBegin + wallsCount)
+        uint32_t wallsBegin;
+        uint32_t wallsCount;
+    };
+
+    struct TopologyOptions
+    {
+        // End points closer than this are merged into one vertex
+        float epsilon = 0.01f;
+
+        // Split walls where another wall ends on them (T-junctions)
+        bool splitTJunctions = true;
+    };
+
+    // Wall adjacency graph of a floor.
+    // Vertices are snapped wall end points, edges are walls. The adjacency is stored in CSR layout.
+    class FloorTopology
+    {
+    private:
+        std::vector<Point2D> verts;
+        std::vector<TopologyEdge> edgeList;
+        std::vector<uint32_t> edgeWalls;
+
+        // Edges of vertex v are adjacency[adjacencyStart[v] .. adjacencyStart[v + 1])
+        std::vector<uint32_t> adjacencyStart;
+        std::vector<uint32_t> adjacency;
+
+        class UnionFind
+        {
+        private:
+            std::vector<uint32_t> parent;
+
+        public:
+            explicit UnionFind(size_t n) : parent(n) { std::iota(parent.begin(), parent.end(), 0u); }
+
+            uint32_t find(uint32_t x)
+            {
+                while (parent[x] != x)
+                {
+                    parent[x] = parent[parent[x]];
+                    x = parent[x];
+                }
+                return x;
+            }
+
+            void unite(uint32_t a, uint32_t b)
+            {
+                a = find(a);
+                b = find(b);
+                if (a != b)
+                    parent[std::max(a, b)] = std::min(a, b);
+            }
+        };
+
+        static uint64_t cellKey(int64_t cx, int64_t cy)
+        {
+            return (static_cast<uint64_t>(cx) << 32) ^ static_cast<uint64_t>(cy & 0xFFFFFFFF);
+        }
+
+        void buildAdjacency()
+        {
+            adjacencyStart.assign(verts.size() + 1, 0);
+            for (const TopologyEdge& e : edgeList)
+            {
+                adjacencyStart[e.a + 1]++;
+                adjacencyStart[e.b + 1]++;
+            }
+            for (size_t i = 1; i < adjacencyStart.size(); i++)
+                adjacencyStart[i] += adjacencyStart[i - 1];
+
+            adjacency.resize(adjacencyStart.back());
+            std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (uint32_t i = 0; i < edgeList.size(); i++)
+            {
+                adjacency[fill[edgeList[i].a]++] = i;
+                adjacency[fill[edgeList[i].b]++] = i;
+            }
+        }
+
+    public:
+        struct Range
+        {
+            const uint32_t* first;
+            const uint32_t* last;
+
+            const uint32_t* begin() const { return first; }
+            const uint32_t* end() const { return last; }
+            size_t size() const { return static_cast<size_t>(last - first); }
+        };
+
+        FloorTopology() = default;
+
+        // Snaps the end points of all walls with an epsilon hash grid and union-find, O(n) expected.
+        explicit FloorTopology(const Floor& floor, const TopologyOptions& options = TopologyOptions())
+        {
+            const size_t n = floor.walls.size();
+            const float eps = options.epsilon;
+            const float eps2 = eps * eps;
+
+            std::vector<Point2D> points(2 * n);
+            for (size_t i = 0; i < n; i++)
+            {
+                points[2 * i] = floor.walls[i].start();
+                points[2 * i + 1] = floor.walls[i].end();
+            }
+
+            // Hash grid with cell size epsilon, close points are in the same or a neighbouring cell
+            std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+            grid.reserve(points.size());
+            UnionFind uf(points.size());
+
+            for (uint32_t i = 0; i < points.size(); i++)
+            {
+                const int64_t cx = static_cast<int64_t>(std::floor(points[i].x / eps));
+                const int64_t cy = static_cast<int64_t>(std::floor(points[i].y / eps));
+
+                for (int64_t dy = -1; dy <= 1; dy++)
+                {
+                    for (int64_t dx = -1; dx <= 1; dx++)
+                    {
+                        auto it = grid.find(cellKey(cx + dx, cy + dy));
+                        if (it == grid.end())
+                            continue;
+
+                        for (uint32_t j : it->second)
+                        {
+                            const Point2D d = points[i] - points[j];
+                            if (d.x * d.x + d.y * d.y <= eps2)
+                                uf.unite(i, j);
+                        }
+                    }
+                }
+
+                grid[cellKey(cx, cy)].push_back(i);
+            }
+
+            // One vertex per cluster at the mean position
+            std::vector<uint32_t> vertexOf(points.size(), UINT32_MAX);
+            std::vector<uint32_t> clusterSize;
+            for (uint32_t i = 0; i < points.size(); i++)
+            {
+                const uint32_t root = uf.find(i);
+                if (vertexOf[root] == UINT32_MAX)
+                {
+                    vertexOf[root] = static_cast<uint32_t>(verts.size());
+                    verts.push_back(Point2D());
+                    clusterSize.push_back(0);
+                }
+                vertexOf[i] = vertexOf[root];
+                verts[vertexOf[i]] = verts[vertexOf[i]] + points[i];
+                clusterSize[vertexOf[i]]++;
+            }
+            for (size_t v = 0; v < verts.size(); v++)
+                verts[v] = verts[v] / static_cast<float>(clusterSize[v]);
+
+            // Vertices lying on the interior of another wall split that wall
+            std::vector<std::vector<std::pair<float, uint32_t>>> splits(n);
+            if (options.splitTJunctions && n > 0)
+            {
+                std::vector<IndexedSegment> segs;
+                segs.reserve(n);
+                for (uint32_t w = 0; w < n; w++)
+                {
+                    const Wall& wall = floor.walls[w];
+                    segs.push_back(IndexedSegment{ verts[vertexOf[2 * w]], verts[vertexOf[2 * w + 1]], SegmentSource::Wall, w, 0,
+                                                   WallSegmentType::Wall, wall.material, wall.thickness });
+                }
+                const WallIndex index(segs);
+
+                std::vector<uint32_t> stamp(n, UINT32_MAX);
+                for (uint32_t v = 0; v < verts.size(); v++)
+                {
+                    const Point2D& p = verts[v];
+                    index.forEachInBox(p - Point2D(eps, eps), p + Point2D(eps, eps), [&](uint32_t w)
+                    {
+                        if (stamp[w] == v || vertexOf[2 * w] == v || vertexOf[2 * w + 1] == v)
+                            return;
+                        stamp[w] = v;
+
+                        const Point2D ab = segs[w].end - segs[w].start;
+                        const float len2 = ab.x * ab.x + ab.y * ab.y;
+                        if (len2 <= eps2)
+                            return;
+
+                        const Point2D ap = p - segs[w].start;
+                        const float t = (ap.x * ab.x + ap.y * ab.y) / len2;
+                        const Point2D closest = segs[w].start + ab * t;
+                        const Point2D d = p - closest;
+                        const float tEps = eps / std::sqrt(len2);
+                        if (t > tEps && t < 1.0f - tEps && d.x * d.x + d.y * d.y <= eps2)
+                            splits[w].emplace_back(t, v);
+                    });
+                }
+            }
+
+            // Edges
+            for (uint32_t w = 0; w < n; w++)
+            {
+                const Wall& wall = floor.walls[w];
+                std::vector<std::pair<float, uint32_t>>& s = splits[w];
+                std::sort(s.begin(), s.end());
+
+                uint32_t prev = vertexOf[2 * w];
+                auto addEdge = [&](uint32_t next)
+                {
+                    if (prev == next)
+                        return;
+                    edgeList.push_back(TopologyEdge{ prev, next, wall.material, wall.thickness, wall.height,
+                                                     static_cast<uint32_t>(edgeWalls.size()), 1 });
+                    edgeWalls.push_back(w);
+                    prev = next;
+                };
+
+                for (const auto& split : s)
+                    addEdge(split.second);
+                addEdge(vertexOf[2 * w + 1]);
+            }
+
+            buildAdjacency();
+        }
+
+        const std::vector<Point2D>& vertices() const { return verts; }
+        const std::vector<TopologyEdge>& edges() const { return edgeList; }
+
+        // Indices within Floor::walls the edge was made of
+        Range walls(const TopologyEdge& e) const
+        {
+            return Range{ edgeWalls.data() + e.wallsBegin, edgeWalls.data() + e.wallsBegin + e.wallsCount };
+        }
+
+        // Indices of the edges connected to the vertex
+        Range edgesOf(uint32_t v) const
+        {
+            return Range{ adjacency.data() + adjacencyStart[v], adjacency.data() + adjacencyStart[v + 1] };
+        }
+
+        size_t degree(uint32_t v) const { return adjacencyStart[v + 1] - adjacencyStart[v]; }
+
+        uint32_t opposite(const TopologyEdge& e, uint32_t v) const { return e.a == v ? e.b : e.a; }
+
+        // Merges chains of collinear edges with equal material and thickness into single edges.
+        // A vertex is removed if it has degree 2 and the angle between its edges deviates less than maxAngle (radians) from 180 degrees.
+        FloorTopology mergeCollinear(float maxAngle = 0.01f) const
+        {
+            const float maxSin = std::sin(maxAngle);
+
+            auto mergeable = [&](uint32_t v)
+            {
+                if (degree(v) != 2)
+                    return false;
+
+                const TopologyEdge& e0 = edgeList[adjacency[adjacencyStart[v]]];
+                const TopologyEdge& e1 = edgeList[adjacency[adjacencyStart[v] + 1]];
+                if (&e0 == &e1 || e0.material != e1.material || e0.thickness != e1.thickness || e0.height != e1.height)
+                    return false;
+
+                const Point2D d0 = (verts[opposite(e0, v)] - verts[v]).normalized();
+                const Point2D d1 = (verts[opposite(e1, v)] - verts[v]).normalized();
+
+                // Opposite directions
+                return std::abs(d0.x * d1.y - d0.y * d1.x) <= maxSin && d0.x * d1.x + d0.y * d1.y < 0;
+            };
+
+            FloorTopology result;
+            std::vector<uint32_t> newVertex(verts.size(), UINT32_MAX);
+            auto mapVertex = [&](uint32_t v)
+            {
+                if (newVertex[v] == UINT32_MAX)
+                {
+                    newVertex[v] = static_cast<uint32_t>(result.verts.size());
+                    result.verts.push_back(verts[v]);
+                }
+                return newVertex[v];
+            };
+
+            std::vector<bool> visited(edgeList.size(), false);
+
+            // Walks from vertex v away from edge e until a non mergeable vertex is reached
+            auto walk = [&](uint32_t e, uint32_t v, std::vector<uint32_t>& chain)
+            {
+                while (mergeable(v))
+                {
+                    const uint32_t e0 = adjacency[adjacencyStart[v]];
+                    const uint32_t next = e0 == e ? adjacency[adjacencyStart[v] + 1] : e0;
+                    if (visited[next])
+                        break; // closed ring
+                    visited[next] = true;
+                    chain.push_back(next);
+                    e = next;
+                    v = opposite(edgeList[e], v);
+                }
+                return v;
+            };
+
+            std::vector<uint32_t> back, front;
+            for (uint32_t e = 0; e < edgeList.size(); e++)
+            {
+                if (visited[e])
+                    continue;
+                visited[e] = true;
+
+                back.clear();
+                front.clear();
+                const uint32_t start = walk(e, edgeList[e].a, back);
+                const uint32_t end = walk(e, edgeList[e].b, front);
+
+                const TopologyEdge& src = edgeList[e];
+                TopologyEdge merged{ mapVertex(start), mapVertex(end), src.material, src.thickness, src.height,
+                                     static_cast<uint32_t>(result.edgeWalls.size()), 0 };
+
+                // Walls in chain order from start to end, without repetitions
+                auto addWalls = [&](uint32_t edge)
+                {
+                    for (uint32_t w : walls(edgeList[edge]))
+                    {
+                        if (merged.wallsCount == 0 || result.edgeWalls.back() != w)
+                        {
+                            result.edgeWalls.push_back(w);
+                            merged.wallsCount++;
+                        }
+                    }
+                };
+                for (size_t i = back.size(); i-- > 0;)
+                    addWalls(back[i]);
+                addWalls(e);
+                for (uint32_t edge : front)
+                    addWalls(edge);
+
+                if (merged.a != merged.b)
+                    result.edgeList.push_back(merged);
+                else
+                    result.edgeWalls.resize(merged.wallsBegin);
+            }
+
+            result.buildAdjacency();
+            return result;
+        }
+    };
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapParallel.h"
+#include "indoorMapQuery.h"
+#include "indoorMapWallIndex.h"
+
+namespace Indoor::Map
+{
+    enum class ValidationIssueType
+    {
+        OverlappingWallElements,    // doors/windows of a wall overlap, index: wall
+        WallElementOutsideWall,     // door/window exceeds the wall's ends, index: wall
+        CrossingWalls,              // the interiors of two walls cross, index and other: walls
+        OverlappingWalls,           // two collinear walls overlap, index and other: walls
+        DuplicateWalls,             // two walls have the same end points, index and other: walls
+        // Outline polygons are closed implicitly, the last point connects to the first one, thus a polygon
+        // can not be open. What remains to report is a polygon without area: less than 3 distinct points.
+        DegeneratePolygon,          // outline polygon with less than 3 distinct points, index: polygon
+        AccessPointOutsideOutline   // index: access point
+    };
+
+    struct ValidationIssue
+    {
+        ValidationIssueType type;
+        uint32_t floor;
+
+        // Element indices within the floor, see ValidationIssueType. other is -1 if not used.
+        uint32_t index;
+        int64_t other;
+
+        // Location of the issue in map coordinates
+        Point2D position;
+
+        // Static description, never allocated.
+        const char* message;
+    };
+
+    struct ValidationOptions
+    {
+        // Distance in meters below which end points are considered equal.
+        // Walls touching within this distance (corners, T-junctions) are not reported as crossing.
+        float epsilon = 0.01f;
+
+        // Threads used for the wall pair checks, 0 uses all hardware threads
+        size_t threadCount = 0;
+    };
+
+    namespace detail
+    {
+        // Relative [from, to] interval of a door or window along the wall, consistent with computeWallSegments()
+        struct WallInterval
+        {
+            float from;
+            float to;
+        };
+
+        inline void validateWallElements(const Wall& wall, uint32_t floorIndex, uint32_t wallIndex, float epsilon,
+                                         std::vector<WallInterval>& intervals, std::vector<ValidationIssue>& issues)
+        {
+            if (wall.doors.size() + wall.windows.size() == 0)
+                return;
+
+            const float length = (wall.end() - wall.start()).length();
+            if (length <= 0.0f)
+                return;
+
+            intervals.clear();
+            for (const WallDoor& door : wall.doors)
+            {
+                const float from = door.leftRight ? door.atLinePos - door.width / length : door.atLinePos;
+                intervals.push_back(WallInterval{ from, from + door.width / length });
+            }
+            for (const WallWindow& window : wall.windows)
+            {
+                const float half = window.width / (2.0f * length);
+                intervals.push_back(WallInterval{ window.atLinePos - half, window.atLinePos + half });
+            }
+
+            const float eps = epsilon / length;
+            auto at = [&wall](float t) { return wall.start() + (wall.end() - wall.start()) * t; };
+
+            // Sort and scan, an interval overlaps if it starts before the furthest end seen so far
+            std::sort(intervals.begin(), intervals.end(), [](const WallInterval& a, const WallInterval& b) { return a.from < b.from; });
+
+            float maxTo = -1e30f;
+            for (const WallInterval& iv : intervals)
+            {
+                if (iv.from < -eps || iv.to > 1.0f + eps)
+                {
+                    issues.push_back(ValidationIssue{ ValidationIssueType::WallElementOutsideWall, floorIndex, wallIndex, -1,
+                                                      at(std::clamp(iv.from, 0.0f, 1.0f)), "Door or window exceeds the wall" });
+                }
+
+                if (iv.from < maxTo - eps)
+                {
+                    issues.push_back(ValidationIssue{ ValidationIssueType::OverlappingWallElements, floorIndex, wallIndex, -1,
+                                                      at(iv.from), "Doors or windows overlap" });
+                }
+                maxTo = std::max(maxTo, iv.to);
+            }
+        }
+
+        inline float cross(const Point2D& a, const Point2D& b) { return a.x * b.y - a.y * b.x; }
+        inline float dot(const Point2D& a, const Point2D& b) { return a.x * b.x + a.y * b.y; }
+
+        // Checks a pair of walls, the interior must be crossed, touching within epsilon is fine.
+        inline void validateWallPair(const IndexedSegment& a, const IndexedSegment& b, uint32_t floorIndex, float epsilon,
+                                     std::vector<ValidationIssue>& issues)
+        {
+            auto near = [epsilon](const Point2D& p, const Point2D& q) { return (p - q).length() <= epsilon; };
+
+            if ((near(a.start, b.start) && near(a.end, b.end)) || (near(a.start, b.end) && near(a.end, b.start)))
+            {
+                issues.push_back(ValidationIssue{ ValidationIssueType::DuplicateWalls, floorIndex, a.element, b.element,
+                                                  a.start, "Duplicate wall" });
+                return;
+            }
+
+            const Point2D r = a.end - a.start;
+            const Point2D s = b.end - b.start;
+            const float lenA = r.length();
+            const float lenB = s.length();
+            if (lenA <= epsilon || lenB <= epsilon)
+                return;
+
+            const Point2D qp = b.start - a.start;
+            const float denom = cross(r, s);
+
+            // Parallel: collinear overlap if b's end points are on a's line and the projections overlap
+            if (std::abs(denom) <= 1e-6f * lenA * lenB)
+            {
+                if (std::abs(cross(r, qp)) / lenA > epsilon)
+                    return;
+
+                const float t0 = dot(qp, r) / (lenA * lenA);
+                const float t1 = dot(b.end - a.start, r) / (lenA * lenA);
+                const float lo = std::max(0.0f, std::min(t0, t1));
+                const float hi = std::min(1.0f, std::max(t0, t1));
+                if ((hi - lo) * lenA > epsilon)
+                {
+                    issues.push_back(ValidationIssue{ ValidationIssueType::OverlappingWalls, floorIndex, a.element, b.element,
+                                                      a.start + r * lo, "Collinear walls overlap" });
+                }
+                return;
+            }
+
+            const float t = cross(qp, s) / denom;
+            const float u = cross(qp, r) / denom;
+
+            // Both intersection parameters must be inside the walls by more than epsilon
+            const float epsA = epsilon / lenA;
+            const float epsB = epsilon / lenB;
+            if (t > epsA && t < 1.0f - epsA && u > epsB && u < 1.0f - epsB)
+            {
+                issues.push_back(ValidationIssue{ ValidationIssueType::CrossingWalls, floorIndex, a.element, b.element,
+                                                  a.start + r * t, "Walls cross" });
+            }
+        }
+    }
+
+    // Validates a single floor and appends the issues.
+    inline void validateFloor(const Floor& floor, uint32_t floorIndex, std::vector<ValidationIssue>& issues,
+                              const ValidationOptions& options = ValidationOptions())
+    {
+        // Doors and windows per wall, O(k log k) each
+        std::vector<detail::WallInterval> intervals;
+        for (uint32_t w = 0; w < floor.walls.size(); w++)
+        {
+            detail::validateWallElements(floor.walls[w], floorIndex, w, options.epsilon, intervals, issues);
+        }
+
+        // Wall pairs: only walls sharing a grid cell are compared
+        std::vector<IndexedSegment> walls;
+        walls.reserve(floor.walls.size());
+        for (uint32_t w = 0; w < floor.walls.size(); w++)
+        {
+            const Wall& wall = floor.walls[w];
+            walls.push_back(IndexedSegment{ wall.start(), wall.end(), SegmentSource::Wall, w, 0, WallSegmentType::Wall, wall.material, wall.thickness });
+        }
+        const WallIndex index(walls);
+
+        const size_t threadCount = options.threadCount == 0 ? defaultThreadCount() : options.threadCount;
+        std::vector<std::vector<ValidationIssue>> threadIssues(threadCount);
+
+        parallelFor(walls.size(), threadCount, [&](size_t begin, size_t end, size_t thread)
+        {
+            // Walls spanning several cells are reported once per cell, the stamp filters repetitions
+            std::vector<uint32_t> stamp(walls.size(), UINT32_MAX);
+            const Point2D eps(options.epsilon, options.epsilon);
+
+            for (size_t i = begin; i < end; i++)
+            {
+                const IndexedSegment& a = walls[i];
+                const Point2D minP(std::min(a.start.x, a.end.x), std::min(a.start.y, a.end.y));
+                const Point2D maxP(std::max(a.start.x, a.end.x), std::max(a.start.y, a.end.y));
+
+                index.forEachInBox(minP - eps, maxP + eps, [&](uint32_t j)
+                {
+                    if (j <= i || stamp[j] == i)
+                        return;
+                    stamp[j] = static_cast<uint32_t>(i);
+                    detail::validateWallPair(a, walls[j], floorIndex, options.epsilon, threadIssues[thread]);
+                });
+            }
+        });
+
+        for (const std::vector<ValidationIssue>& ti : threadIssues)
+        {
+            issues.insert(issues.end(), ti.begin(), ti.end());
+        }
+
+        // Outline polygons
+        for (uint32_t p = 0; p < floor.outline.polygons.size(); p++)
+        {
+            const std::vector<Point2D>& points = floor.outline.polygons[p].points;
+
+            // An explicitly closed polygon repeats its first point, the repetition is not counted
+            size_t end = points.size();
+            while (end > 1 && (points[end - 1] - points.front()).length() <= options.epsilon)
+                end--;
+
+            size_t distinct = 0;
+            for (size_t i = 0; i < end && distinct < 3; i++)
+            {
+                if (i == 0 || (points[i] - points[i - 1]).length() > options.epsilon)
+                    distinct++;
+            }
+
+            if (distinct < 3)
+            {
+                issues.push_back(ValidationIssue{ ValidationIssueType::DegeneratePolygon, floorIndex, p, -1,
+                                                  points.empty() ? Point2D() : points.front(), "Outline polygon has less than 3 distinct points" });
+            }
+        }
+
+        // Access points, only if the floor has an outline at all
+        if (!floor.outline.polygons.empty())
+        {
+            for (uint32_t i = 0; i < floor.accessPoints.size(); i++)
+            {
+                const AccessPoint& ap = floor.accessPoints[i];
+                if (!isInOutline(floor, Point2D(ap.x, ap.y)))
+                {
+                    issues.push_back(ValidationIssue{ ValidationIssueType::AccessPointOutsideOutline, floorIndex, i, -1,
+                                                      Point2D(ap.x, ap.y), "Access point outside of the outline" });
+                }
+            }
+        }
+    }
+
+    // Validates all floors. The issues are ordered by floor and type.
+    inline std::vector<ValidationIssue> validate(const Map& map, const ValidationOptions& options = ValidationOptions())
+    {
+        std::vector<ValidationIssue> issues;
+        for (uint32_t f = 0; f < map.floors.size(); f++)
+        {
+            validateFloor(map.floors[f], f, issues, options);
+        }
+
+        std::stable_sort(issues.begin(), issues.end(), [](const ValidationIssue& a, const ValidationIssue& b)
+        {
+            return a.floor < b.floor || (a.floor == b.floor && a.type < b.type);
+        });
+        return issues;
+    }
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapParallel.h"
+#include "indoorMapWallIndex.h"
+
+namespace Indoor::Map
+{
+    // Line of sight between a and b. Walls and windows block, doors are open.
+    template<typename Filter = DefaultBlocker>
+    bool visible(const Point2D& a, const Point2D& b, const WallIndex& index, Filter filter = Filter())
+    {
+        return !index.intersects(a, b, filter);
+    }
+
+    // Line of sight without an index, checks all walls and obstacles of the floor.
+    // Prefer the WallIndex overload if more than a few queries are done on the same floor.
+    inline bool visible(const Point2D& a, const Point2D& b, const Floor& floor)
+    {
+        bool blocked = false;
+        forEachFloorSegment(floor, [&](const IndexedSegment& seg)
+        {
+            blocked = blocked || (DefaultBlocker()(seg) && WallIndex::intersect(a, b, seg.start, seg.end) >= 0.0f);
+        });
+        return !blocked;
+    }
+
+    // Reusable buffers of visibilityPolygon, one per thread avoids allocations in batches.
+    struct VisibilityWorkspace
+    {
+        std::vector<uint32_t> segments;
+        std::vector<float> angles;
+        std::vector<std::pair<float, Point2D>> rays;
+    };
+
+    // The area visible from origin up to maxRadius as polygon in counter-clockwise order.
+    // Rays are cast towards every segment endpoint within the radius (and slightly left and right of it to look past corners)
+    // plus arcSteps evenly spaced rays approximating the boundary circle.
+    template<typename Filter = DefaultBlocker>
+    void visibilityPolygon(const Point2D& origin, float maxRadius, const WallIndex& index, std::vector<Point2D>& result,
+                           VisibilityWorkspace& ws, int arcSteps = 180, Filter filter = Filter())
+    {
+        const float twoPi = 6.28318530718f;
+        const float eps = 1e-4f;
+
+        result.clear();
+        ws.segments.clear();
+        ws.angles.clear();
+        ws.rays.clear();
+
+        // Candidate segments, reported once per overlapping cell
+        const Point2D r(maxRadius, maxRadius);
+        index.forEachInBox(origin - r, origin + r, [&](uint32_t i) { ws.segments.push_back(i); });
+        std::sort(ws.segments.begin(), ws.segments.end());
+        ws.segments.erase(std::unique(ws.segments.begin(), ws.segments.end()), ws.segments.end());
+
+        const float r2 = maxRadius * maxRadius;
+        for (uint32_t i : ws.segments)
+        {
+            const IndexedSegment& s = index.segments()[i];
+            if (!filter(s))
+                continue;
+
+            for (const Point2D& p : { s.start, s.end })
+            {
+                const Point2D d = p - origin;
+                if (d.x * d.x + d.y * d.y > r2)
+                    continue;
+
+                const float angle = std::atan2(d.y, d.x);
+                ws.angles.push_back(angle - eps);
+                ws.angles.push_back(angle);
+                ws.angles.push_back(angle + eps);
+            }
+        }
+
+        for (int i = 0; i < arcSteps; i++)
+        {
+            ws.angles.push_back(-twoPi / 2 + twoPi * static_cast<float>(i) / static_cast<float>(arcSteps));
+        }
+
+        for (float angle : ws.angles)
+        {
+            const Point2D end = Point2D::fromPolar(origin, maxRadius, angle);
+
+            float t;
+            const Point2D hit = index.firstHit(origin, end, t, filter) >= 0 ? origin + (end - origin) * t : end;
+
+            // Normalize to [-pi, pi) for sorting
+            float a = angle;
+            if (a < -twoPi / 2) a += twoPi;
+            if (a >= twoPi / 2) a -= twoPi;
+            ws.rays.emplace_back(a, hit);
+        }
+
+        std::sort(ws.rays.begin(), ws.rays.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        result.reserve(ws.rays.size());
+        for (const auto& ray : ws.rays)
+        {
+            if (result.empty() || result.back() != ray.second)
+                result.push_back(ray.second);
+        }
+    }
+
+    template<typename Filter = DefaultBlocker>
+    std::vector<Point2D> visibilityPolygon(const Point2D& origin, float maxRadius, const WallIndex& index, int arcSteps = 180, Filter filter = Filter())
+    {
+        std::vector<Point2D> result;
+        VisibilityWorkspace ws;
+        visibilityPolygon(origin, maxRadius, index, result, ws, arcSteps, filter);
+        return result;
+    }
+
+    // Visibility polygons of many origins in parallel. threadCount 0 uses all hardware threads.
+    template<typename Filter = DefaultBlocker>
+    std::vector<std::vector<Point2D>> visibilityPolygons(const std::vector<Point2D>& origins, float maxRadius, const WallIndex& index,
+                                                         size_t threadCount = 0, int arcSteps = 180, Filter filter = Filter())
+    {
+        std::vector<std::vector<Point2D>> results(origins.size());
+        parallelFor(origins.size(), threadCount, [&](size_t begin, size_t end, size_t)
+        {
+            VisibilityWorkspace ws;
+            for (size_t i = begin; i < end; i++)
+                visibilityPolygon(origins[i], maxRadius, index, results[i], ws, arcSteps, filter);
+        });
+        return results;
+    }
+
+    // Line of sight for many pairs in parallel. threadCount 0 uses all hardware threads.
+    template<typename Filter = DefaultBlocker>
+    std::vector<uint8_t> visibleBatch(const std::vector<std::pair<Point2D, Point2D>>& pairs, const WallIndex& index,
+                                      size_t threadCount = 0, Filter filter = Filter())
+    {
+        std::vector<uint8_t> results(pairs.size());
+        parallelFor(pairs.size(), threadCount, [&](size_t begin, size_t end, size_t)
+        {
+            for (size_t i = begin; i < end; i++)
+                results[i] = visible(pairs[i].first, pairs[i].second, index, filter) ? 1 : 0;
+        });
+        return results;
+    }
+
+    // Coverage of targets by candidate origins, e.g. for camera or access point placement.
+    // Returns a row-major origins x targets matrix, a target is covered if it is within maxRange and visible.
+    template<typename Filter = DefaultBlocker>
+    std::vector<uint8_t> visibilityMatrix(const std::vector<Point2D>& origins, const std::vector<Point2D>& targets, float maxRange,
+                                          const WallIndex& index, size_t threadCount = 0, Filter filter = Filter())
+    {
+        const float maxRange2 = maxRange * maxRange;
+        std::vector<uint8_t> results(origins.size() * targets.size(), 0);
+
+        parallelFor(origins.size(), threadCount, [&](size_t begin, size_t end, size_t)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                uint8_t* row = results.data() + i * targets.size();
+                for (size_t j = 0; j < targets.size(); j++)
+                {
+                    const Point2D d = targets[j] - origins[i];
+                    if (d.x * d.x + d.y * d.y <= maxRange2)
+                        row[j] = visible(origins[i], targets[j], index, filter) ? 1 : 0;
+                }
+            }
+        });
+        return results;
+    }
+}
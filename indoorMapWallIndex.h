@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapWallSegments.h"
+
+namespace Indoor::Map
+{
+    // Floor list an indexed segment originates from
+    enum class SegmentSource : uint8_t
+    {
+        Wall,
+        LineObstacle,
+        CircleObstacle,
+        DoorObstacle,
+        ObjectObstacle,
+
+        // Edge of a Floor::outline polygon, not reported by forEachFloorSegment()
+        Outline
+    };
+
+    // Circles are approximated by regular polygons with this number of sides
+    constexpr int CircleObstacleSides = 12;
+
+    // A wall segment (wall, door or window) or an obstacle edge as stored in the WallIndex.
+    struct IndexedSegment
+    {
+        Point2D start;
+        Point2D end;
+
+        SegmentSource source;
+
+        // Index within the floor list given by source, e.g. Floor::walls
+        uint32_t element;
+
+        // Index within Wall::segments, the edge index for circles, objects and outline polygons
+        uint32_t segment;
+
+        WallSegmentType type;
+        WallMaterial material;
+        float thickness;
+
+        // Index within Wall::doors or Wall::windows for door and window segments of walls
+        int32_t listIndex = -1;
+    };
+
+    // Segments of type wall and window block, doors are open.
+    struct DefaultBlocker
+    {
+        bool operator()(const IndexedSegment& seg) const
+        {
+            return seg.type != WallSegmentType::Door;
+        }
+    };
+
+    // Calls func(IndexedSegment) for every wall segment and obstacle edge of the floor.
+    // Doors (wall doors and door obstacles) are reported with type WallSegmentType::Door, everything else blocks as wall or window.
+    template<typename Func>
+    void forEachFloorSegment(const Floor& floor, Func func)
+    {
+        std::vector<WallSegment2D> scratch;
+        for (uint32_t w = 0; w < floor.walls.size(); w++)
+        {
+            const Wall& wall = floor.walls[w];
+            const std::vector<WallSegment2D>& segments = wallSegments(wall, scratch);
+            for (uint32_t s = 0; s < segments.size(); s++)
+            {
+                const WallSegment2D& seg = segments[s];
+                WallMaterial material = wall.material;
+                if (seg.type == WallSegmentType::Door)
+                    material = wall.doors[seg.listIndex].material;
+                else if (seg.type == WallSegmentType::Window)
+                    material = wall.windows[seg.listIndex].material;
+
+                func(IndexedSegment{ seg.start, seg.end, SegmentSource::Wall, w, s, seg.type, material, wall.thickness, seg.listIndex });
+            }
+        }
+
+        for (uint32_t i = 0; i < floor.lineObstacles.size(); i++)
+        {
+            const LineObstacle& line = floor.lineObstacles[i];
+            func(IndexedSegment{ line.start(), line.end(), SegmentSource::LineObstacle, i, 0, WallSegmentType::Wall, line.material, line.thickness });
+        }
+
+        for (uint32_t i = 0; i < floor.circleObstacles.size(); i++)
+        {
+            const CircleObstacle& circle = floor.circleObstacles[i];
+            const Point2D center(circle.cx, circle.cy);
+            for (int k = 0; k < CircleObstacleSides; k++)
+            {
+                const float a0 = 6.28318530718f * k / CircleObstacleSides;
+                const float a1 = 6.28318530718f * (k + 1) / CircleObstacleSides;
+                func(IndexedSegment{ Point2D::fromPolar(center, circle.radius, a0), Point2D::fromPolar(center, circle.radius, a1),
+                                     SegmentSource::CircleObstacle, i, static_cast<uint32_t>(k), WallSegmentType::Wall, circle.material, 0.0f });
+            }
+        }
+
+        for (uint32_t i = 0; i < floor.doorObstacles.size(); i++)
+        {
+            const DoorObstacle& door = floor.doorObstacles[i];
+            func(IndexedSegment{ door.start(), door.end(), SegmentSource::DoorObstacle, i, 0, WallSegmentType::Door, door.material, 0.0f });
+        }
+
+        for (uint32_t i = 0; i < floor.objectObstacles.size(); i++)
+        {
+            const std::vector<Point2D>& fp = floor.objectObstacles[i].footprint;
+            for (uint32_t k = 0; k < fp.size(); k++)
+            {
+                func(IndexedSegment{ fp[k], fp[(k + 1) % fp.size()], SegmentSource::ObjectObstacle, i, k,
+                                     WallSegmentType::Wall, WallMaterial::Unknown, 0.0f });
+            }
+        }
+    }
+
+    // Calls func(IndexedSegment) for every edge of the floor's outline polygons, including PolygonMethod::Remove holes.
+    // Edges block as walls without thickness, element is the index within Outline::polygons.
+    template<typename Func>
+    void forEachOutlineSegment(const Floor& floor, Func func)
+    {
+        for (uint32_t i = 0; i < floor.outline.polygons.size(); i++)
+        {
+            const std::vector<Point2D>& points = floor.outline.polygons[i].points;
+            for (uint32_t k = 0; k < points.size(); k++)
+            {
+                func(IndexedSegment{ points[k], points[(k + 1) % points.size()], SegmentSource::Outline, i, k,
+                                     WallSegmentType::Wall, WallMaterial::Unknown, 0.0f });
+            }
+        }
+    }
+
+    // Uniform grid over the wall segments and obstacles of a floor.
+    // Cells are stored in CSR layout (one offset array and one item array), thus the index consists of three flat arrays.
+    // Segment queries walk the grid cells along the query line and stop at the first hit.
+    class WallIndex
+    {
+    private:
+        std::vector<IndexedSegment> segs;
+
+        Point2D origin;
+        float cellSize = 1.0f;
+        int cellsX = 0;
+        int cellsY = 0;
+
+        // Items of cell i are items[cellStart[i] .. cellStart[i + 1])
+        std::vector<uint32_t> cellStart;
+        std::vector<uint32_t> items;
+
+        int cellX(float x) const { return std::clamp(static_cast<int>(std::floor((x - origin.x) / cellSize)), 0, cellsX - 1); }
+        int cellY(float y) const { return std::clamp(static_cast<int>(std::floor((y - origin.y) / cellSize)), 0, cellsY - 1); }
+
+        // Calls func(cx, cy) for the cells of the segment's bounding box
+        template<typename Func>
+        void forEachCellOfBox(const Point2D& a, const Point2D& b, Func func) const
+        {
+            const int x0 = cellX(std::min(a.x, b.x)), x1 = cellX(std::max(a.x, b.x));
+            const int y0 = cellY(std::min(a.y, b.y)), y1 = cellY(std::max(a.y, b.y));
+            for (int cy = y0; cy <= y1; cy++)
+                for (int cx = x0; cx <= x1; cx++)
+                    func(cx, cy);
+        }
+
+        void build()
+        {
+            if (segs.empty())
+                return;
+
+            Point2D minP = segs[0].start, maxP = segs[0].start;
+            for (const IndexedSegment& s : segs)
+            {
+                minP.x = std::min({ minP.x, s.start.x, s.end.x });
+                minP.y = std::min({ minP.y, s.start.y, s.end.y });
+                maxP.x = std::max({ maxP.x, s.start.x, s.end.x });
+                maxP.y = std::max({ maxP.y, s.start.y, s.end.y });
+            }
+
+            // About two segments per cell
+            const float w = std::max(maxP.x - minP.x, 1e-3f);
+            const float h = std::max(maxP.y - minP.y, 1e-3f);
+            cellSize = std::max(std::sqrt(w * h * 2.0f / static_cast<float>(segs.size())), 0.25f);
+            cellsX = std::min(4096, static_cast<int>(w / cellSize) + 1);
+            cellsY = std::min(4096, static_cast<int>(h / cellSize) + 1);
+            cellSize = std::max(w / static_cast<float>(cellsX), h / static_cast<float>(cellsY)) * 1.0001f;
+            origin = minP;
+
+            // Count, prefix sum, fill
+            cellStart.assign(static_cast<size_t>(cellsX) * cellsY + 1, 0);
+            for (const IndexedSegment& s : segs)
+            {
+                forEachCellOfBox(s.start, s.end, [this](int cx, int cy) { cellStart[cy * cellsX + cx + 1]++; });
+            }
+            for (size_t i = 1; i < cellStart.size(); i++)
+            {
+                cellStart[i] += cellStart[i - 1];
+            }
+
+            items.resize(cellStart.back());
+            std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+            for (uint32_t i = 0; i < segs.size(); i++)
+            {
+                forEachCellOfBox(segs[i].start, segs[i].end, [&](int cx, int cy) { items[fill[cy * cellsX + cx]++] = i; });
+            }
+        }
+
+    public:
+        WallIndex() = default;
+
+        // Indexes arbitrary segments, e.g. whole walls without their doors and windows.
+        explicit WallIndex(std::vector<IndexedSegment> segments)
+            : segs(std::move(segments))
+        {
+            build();
+        }
+
+        // Indexes the segments of all walls and the edges of all obstacles, see forEachFloorSegment().
+        // Segments of walls without generated segments are computed on the fly.
+        explicit WallIndex(const Floor& floor)
+        {
+            forEachFloorSegment(floor, [this](const IndexedSegment& seg) { segs.push_back(seg); });
+            build();
+        }
+
+        const std::vector<IndexedSegment>& segments() const { return segs; }
+
+        // Intersection of the segments p-p2 and q-q2.
+        // Returns the parameter t along p-p2 in [0, 1] or a negative value if they do not intersect.
+        static float intersect(const Point2D& p, const Point2D& p2, const Point2D& q, const Point2D& q2)
+        {
+            const Point2D r = p2 - p;
+            const Point2D s = q2 - q;
+            const float denom = r.x * s.y - r.y * s.x;
+            if (denom == 0.0f)
+                return -1.0f; // parallel
+
+            const Point2D qp = q - p;
+            const float t = (qp.x * s.y - qp.y * s.x) / denom;
+            const float u = (qp.x * r.y - qp.y * r.x) / denom;
+
+            if (t < 0.0f || t > 1.0f || u < 0.0f || u > 1.0f)
+                return -1.0f;
+            return t;
+        }
+
+        // Calls func(segmentIndex) for all segments whose cells overlap the box. Segments may be reported more than once.
+        template<typename Func>
+        void forEachInBox(const Point2D& minP, const Point2D& maxP, Func func) const
+        {
+            if (segs.empty())
+                return;
+
+            forEachCellOfBox(minP, maxP, [&](int cx, int cy)
+            {
+                const size_t cell = static_cast<size_t>(cy) * cellsX + cx;
+                for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+                    func(items[i]);
+            });
+        }
+
+        // Walks the cells along a-b in order (Amanatides & Woo).
+        // Calls visit(cellIndex, tExit) which returns false to stop, tExit is the parameter where the line leaves the cell.
+        template<typename Visit>
+        void walkCells(const Point2D& a, const Point2D& b, Visit visit) const
+        {
+            if (segs.empty())
+                return;
+
+            const Point2D d = b - a;
+            int cx = cellX(a.x), cy = cellY(a.y);
+            const int ex = cellX(b.x), ey = cellY(b.y);
+
+            const int stepX = d.x > 0 ? 1 : -1;
+            const int stepY = d.y > 0 ? 1 : -1;
+            const float inf = std::numeric_limits<float>::infinity();
+
+            const float nextX = origin.x + (cx + (stepX > 0 ? 1 : 0)) * cellSize;
+            const float nextY = origin.y + (cy + (stepY > 0 ? 1 : 0)) * cellSize;
+            float tMaxX = d.x != 0 ? (nextX - a.x) / d.x : inf;
+            float tMaxY = d.y != 0 ? (nextY - a.y) / d.y : inf;
+            const float tDeltaX = d.x != 0 ? cellSize / std::abs(d.x) : inf;
+            const float tDeltaY = d.y != 0 ? cellSize / std::abs(d.y) : inf;
+
+            const int maxSteps = cellsX + cellsY + 2;
+            for (int step = 0; step < maxSteps; step++)
+            {
+                const float tExit = std::min({ tMaxX, tMaxY, 1.0f });
+                if (!visit(static_cast<size_t>(cy) * cellsX + cx, tExit))
+                    return;
+
+                if (cx == ex && cy == ey)
+                    return;
+
+                if (tMaxX < tMaxY)
+                {
+                    cx += stepX;
+                    tMaxX += tDeltaX;
+                }
+                else
+                {
+                    cy += stepY;
+                    tMaxY += tDeltaY;
+                }
+
+                if (cx < 0 || cy < 0 || cx >= cellsX || cy >= cellsY)
+                    return;
+            }
+        }
+
+        // First segment accepted by the filter which is crossed by a-b.
+        // Returns the segment index or -1, t receives the parameter of the hit along a-b.
+        template<typename Filter = DefaultBlocker>
+        int firstHit(const Point2D& a, const Point2D& b, float& t, Filter filter = Filter()) const
+        {
+            int best = -1;
+            float bestT = std::numeric_limits<float>::infinity();
+
+            walkCells(a, b, [&](size_t cell, float tExit)
+            {
+                for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+                {
+                    const IndexedSegment& s = segs[items[i]];
+                    if (!filter(s))
+                        continue;
+
+                    const float hit = intersect(a, b, s.start, s.end);
+                    if (hit >= 0.0f && hit < bestT)
+                    {
+                        bestT = hit;
+                        best = static_cast<int>(items[i]);
+                    }
+                }
+
+                // A hit within this cell can not be beaten by later cells
+                return bestT > tExit;
+            });
+
+            t = bestT;
+            return best;
+        }
+
+        // True if a-b crosses any segment accepted by the filter.
+        template<typename Filter = DefaultBlocker>
+        bool intersects(const Point2D& a, const Point2D& b, Filter filter = Filter()) const
+        {
+            bool hit = false;
+            walkCells(a, b, [&](size_t cell, float)
+            {
+                for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1] && !hit; i++)
+                {
+                    const IndexedSegment& s = segs[items[i]];
+                    hit = filter(s) && intersect(a, b, s.start, s.end) >= 0.0f;
+                }
+                return !hit;
+            });
+            return hit;
+        }
+
+        // Calls func(segmentIndex, t) once for every segment accepted by the filter which is crossed by a-b.
+        template<typename Func, typename Filter = DefaultBlocker>
+        void forEachCrossing(const Point2D& a, const Point2D& b, Func func, Filter filter = Filter()) const
+        {
+            float tEnter = 0.0f;
+            walkCells(a, b, [&](size_t cell, float tExit)
+            {
+                for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+                {
+                    const IndexedSegment& s = segs[items[i]];
+                    if (!filter(s))
+                        continue;
+
+                    // Segments spanning several cells are only reported in the cell containing the crossing
+                    const float t = intersect(a, b, s.start, s.end);
+                    if (t >= 0.0f && t >= tEnter && (t < tExit || tExit >= 1.0f))
+                        func(items[i], t);
+                }
+                tEnter = tExit;
+                return true;
+            });
+        }
+    };
+}
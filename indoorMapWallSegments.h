@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "indoorMap.h"
+#include "indoorMapParallel.h"
+
+namespace Indoor::Map
+{
+    // Converts a wall to wall segments, see Wall::segments.
+    // This method assumes that doors and windows do not overlap!
+    inline void computeWallSegments(const Wall& wall, std::vector<WallSegment2D>& result)
+    {
+        result.clear();
+
+        if (wall.doors.empty() && wall.windows.empty())
+        {
+            result.push_back(WallSegment2D(WallSegmentType::Wall, -1, wall.start(), wall.end()));
+            return;
+        }
+
+        const Point2D dir = wall.end() - wall.start();
+        const float length = dir.length();
+        const Point2D dirN = dir / length;
+
+        // Door and window segments together with the relative position of their start point
+        std::vector<std::pair<float, WallSegment2D>> segments;
+        segments.reserve(wall.doors.size() + wall.windows.size());
+
+        for (size_t i = 0; i < wall.doors.size(); i++)
+        {
+            const WallDoor& door = wall.doors[i];
+
+            WallSegment2D segDoor(WallSegmentType::Door, static_cast<int>(i));
+            segDoor.start = wall.start() + dir * door.atLinePos;
+            segDoor.end = segDoor.start + dirN * (door.leftRight ? -door.width : +door.width);
+
+            if (door.leftRight)
+                std::swap(segDoor.start, segDoor.end);
+
+            const float at = door.leftRight ? door.atLinePos - door.width / length : door.atLinePos;
+            segments.emplace_back(at, segDoor);
+        }
+
+        for (size_t i = 0; i < wall.windows.size(); i++)
+        {
+            const WallWindow& window = wall.windows[i];
+
+            WallSegment2D segWindow(WallSegmentType::Window, static_cast<int>(i));
+            const Point2D center = wall.start() + dir * window.atLinePos;
+            segWindow.start = center - dirN * window.width / 2.0f;
+            segWindow.end   = center + dirN * window.width / 2.0f;
+
+            segments.emplace_back(window.atLinePos - window.width / (2.0f * length), segWindow);
+        }
+
+        // Order by relative position
+        std::sort(segments.begin(), segments.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        // Connect door/window segments with wall segments
+        result.reserve(segments.size() * 2 + 1);
+        result.push_back(WallSegment2D(WallSegmentType::Wall, -1, wall.start(), segments.front().second.start));
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            result.push_back(segments[i].second);
+
+            const Point2D next = i + 1 < segments.size() ? segments[i + 1].second.start : wall.end();
+            result.push_back(WallSegment2D(WallSegmentType::Wall, -1, segments[i].second.end, next));
+        }
+    }
+
+    // Fills Wall::segments if they have not been generated yet.
+    inline void generateWallSegments(Wall& wall)
+    {
+        if (wall.segments.empty())
+            computeWallSegments(wall, wall.segments);
+    }
+
+    // Wall::segments if they have been generated, otherwise they are computed into scratch.
+    // Allows read-only consumers to work with maps parsed without segments.
+    inline const std::vector<WallSegment2D>& wallSegments(const Wall& wall, std::vector<WallSegment2D>& scratch)
+    {
+        if (!wall.segments.empty())
+            return wall.segments;
+
+        computeWallSegments(wall, scratch);
+        return scratch;
+    }
+
+    // Generates the segments of all walls of the map which have none yet. threadCount 0 uses all hardware threads.
+    inline void generateAllWallSegments(Map& map, size_t threadCount = 0)
+    {
+        std::vector<Wall*> walls;
+        for (Floor& floor : map.floors)
+        {
+            for (Wall& wall : floor.walls)
+            {
+                if (wall.segments.empty())
+                    walls.push_back(&wall);
+            }
+        }
+
+        parallelFor(walls.size(), threadCount, [&walls](size_t begin, size_t end, size_t)
+        {
+            for (size_t i = begin; i < end; i++)
+                computeWallSegments(*walls[i], walls[i]->segments);
+        });
+    }
+}
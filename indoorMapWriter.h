@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+#include "indoorMap.h"
+#include "indoorMapSchema.h"
+
+namespace Indoor::Map
+{
+    namespace detail
+    {
+        inline void appendEscaped(std::string& out, const std::string& s)
+        {
+            for (char c : s)
+            {
+                switch (c)
+                {
+                case '&': out += "&amp;"; break;
+                case '<': out += "&lt;"; break;
+                case '>': out += "&gt;"; break;
+                case '"': out += "&quot;"; break;
+                case '\'': out += "&apos;"; break;
+                default: out += c;
+                }
+            }
+        }
+
+        // Shortest representation which parses to the same float
+        inline void appendFloat(std::string& out, float value)
+        {
+            char buffer[32];
+            for (int precision = 6; precision <= 9; precision++)
+            {
+                std::snprintf(buffer, sizeof(buffer), "%.*g", precision, static_cast<double>(value));
+                if (std::strtof(buffer, nullptr) == value)
+                    break;
+            }
+            out += buffer;
+        }
+
+        template<typename M>
+        void appendValue(std::string& out, M value)
+        {
+            if constexpr (std::is_same_v<M, float>)
+                appendFloat(out, value);
+            else if constexpr (std::is_same_v<M, bool>)
+                out += value ? "true" : "false";
+            else
+                out += std::to_string(static_cast<int>(value));
+        }
+
+        inline void appendAttributeStart(std::string& out, const char* name)
+        {
+            out += ' ';
+            out += name;
+            out += "=\"";
+        }
+
+        template<typename T, typename M>
+        void writeAttribute(std::string& out, const T& object, const ValueField<T, M>& f)
+        {
+            if (f.binaryOnly)
+                return;
+            appendAttributeStart(out, f.name);
+            appendValue(out, object.*f.member);
+            out += '"';
+        }
+
+        template<typename T>
+        void writeAttribute(std::string& out, const T& object, const StringField<T>& f)
+        {
+            appendAttributeStart(out, f.name);
+            appendEscaped(out, object.*f.member);
+            out += '"';
+        }
+
+        template<typename T>
+        void writeAttribute(std::string& out, const T& object, const PointField<T>& f)
+        {
+            appendAttributeStart(out, f.xName);
+            appendFloat(out, object.*f.x);
+            out += '"';
+            appendAttributeStart(out, f.yName);
+            appendFloat(out, object.*f.y);
+            out += '"';
+        }
+
+        inline void appendIndent(std::string& out, size_t depth)
+        {
+            out.append(2 * depth, ' ');
+        }
+
+        inline void openContainer(std::string& out, const char*& open, const char* container, size_t depth)
+        {
+            if (open && container && std::strcmp(open, container) == 0)
+                return;
+
+            if (open)
+            {
+                appendIndent(out, depth);
+                out += "</";
+                out += open;
+                out += ">\n";
+            }
+
+            open = container;
+            if (open)
+            {
+                appendIndent(out, depth);
+                out += '<';
+                out += open;
+                out += ">\n";
+            }
+        }
+
+        template<typename T>
+        void writeElement(std::string& out, const T& object, size_t depth);
+
+        template<typename T, typename Item>
+        void writeChild(std::string& out, const T& object, const ListChild<T, Item>& c, const char*& open, size_t depth)
+        {
+            const std::vector<Item>& items = object.*c.member;
+            if (items.empty())
+                return;
+
+            openContainer(out, open, c.container, depth);
+            for (const Item& item : items)
+                writeElement(out, item, depth + (open ? 1 : 0));
+        }
+
+        template<typename T, typename M>
+        void writeChild(std::string& out, const T& object, const ObjectChild<T, M>& c, const char*& open, size_t depth)
+        {
+            openContainer(out, open, nullptr, depth);
+            writeElement(out, object.*c.member, depth);
+        }
+
+        template<typename T, typename Item>
+        bool hasChild(const T& object, const ListChild<T, Item>& c) { return !(object.*c.member).empty(); }
+
+        template<typename T, typename M>
+        bool hasChild(const T&, const ObjectChild<T, M>&) { return true; }
+
+        template<typename T>
+        void writeElement(std::string& out, const T& object, size_t depth)
+        {
+            appendIndent(out, depth);
+            out += '<';
+            out += Schema<T>::element;
+            forEachSchemaAttribute<T>([&](const auto& f) { writeAttribute(out, object, f); });
+
+            bool children = false;
+            forEachSchemaChild<T>([&](const auto& c) { children = children || hasChild(object, c); });
+
+            if (!children)
+            {
+                out += "/>\n";
+            }
+            else
+            {
+                out += ">\n";
+                const char* open = nullptr;
+                forEachSchemaChild<T>([&](const auto& c) { writeChild(out, object, c, open, depth + 1); });
+                openContainer(out, open, nullptr, depth + 1);
+
+                appendIndent(out, depth);
+                out += "</";
+                out += Schema<T>::element;
+                out += ">\n";
+            }
+        }
+    }
+
+    // Writes the map as XML in the format read by MapParser, generated from the schema (see indoorMapSchema.h).
+    // Values are written as stored, i.e. after a parse-time transform. Derived values (z positions, wall segments)
+    // are not written, the parser recomputes them.
+    inline std::string writeMapXml(const Map& map)
+    {
+        std::string out = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+        detail::writeElement(out, map, 0);
+        return out;
+    }
+
+    inline bool writeMapXmlFile(const Map& map, const std::string& filename)
+    {
+        std::ofstream out(filename, std::ios::binary);
+        if (!out.is_open())
+            return false;
+
+        const std::string xml = writeMapXml(map);
+        out.write(xml.data(), static_cast<std::streamsize>(xml.size()));
+        return static_cast<bool>(out);
+    }
+}
@@ -7,6 +7,7 @@
 #include <map>
 
 #include "indoorMap.h"
+#include "indoorMapWallSegments.h"
 
 namespace Indoor::Map
 {
@@ -187,7 +188,9 @@ namespace Indoor::Map
 
         void leaveWall(Wall& wall) override
         {
-            for (const WallSegment2D& seg : wall.segments)
+            // Segments are not generated if disabled in the ParseOptions
+            std::vector<WallSegment2D> scratch;
+            for (const WallSegment2D& seg : wallSegments(wall, scratch))
             {
                 switch (seg.type)
                 {
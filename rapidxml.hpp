@@ -131,6 +131,25 @@ namespace rapidxml
     #define RAPIDXML_ALIGNMENT sizeof(void *)
 #endif
 
+///////////////////////////////////////////////////////////////////////////
+// SIMD character scanning
+
+// Text and attribute values are skipped 16 (SSE2) or 32 (AVX2, selected at runtime) bytes at a time on x86.
+// Define RAPIDXML_NO_SIMD before including rapidxml.hpp to use the byte-wise scan only,
+// e.g. for AddressSanitizer, which reports the reads past the terminator (they never cross a page).
+#if !defined(RAPIDXML_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define RAPIDXML_SIMD_SSE2
+    #include <emmintrin.h>
+    #include <stdint.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+    #endif
+    #if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        #define RAPIDXML_SIMD_AVX2
+        #include <immintrin.h>
+    #endif
+#endif
+
 namespace rapidxml
 {
     // Forward declarations
@@ -305,6 +324,133 @@ namespace rapidxml
             static const unsigned char lookup_upcase[256];                  // To uppercase conversion table for ASCII characters
         };
 
+#if defined(RAPIDXML_SIMD_SSE2)
+
+        inline unsigned first_bit(unsigned mask)
+        {
+    #if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return index;
+    #else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+    #endif
+        }
+
+        // Whether an unaligned load of Size bytes at p stays within the page of p
+        template<std::size_t Size>
+        inline bool load_in_page(const char *p)
+        {
+            return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - Size;
+        }
+
+#endif
+
+        // Predicates whose runs are mostly shorter than a vector (names, whitespace) keep the byte-wise scan
+        struct simd_none
+        {
+            static const bool enabled = false;
+            static char *skip(char *p) { return p; }
+        };
+
+#if defined(RAPIDXML_SIMD_SSE2)
+
+        // Stop characters of a predicate for the vector scan. Every predicate stops at the terminating zero,
+        // thus the scan never passes the end of the text and a load at a readable position never reaches into the next page.
+        template<int... Chars>
+        struct simd_class
+        {
+            static const bool enabled = true;
+
+            static bool stops(char ch)
+            {
+                return ((ch == static_cast<char>(Chars)) || ...);
+            }
+
+            static unsigned mask_sse2(__m128i v)
+            {
+                __m128i m = _mm_setzero_si128();
+                ((m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(Chars))))), ...);
+                return static_cast<unsigned>(_mm_movemask_epi8(m));
+            }
+
+            static char *skip_sse2(char *p)
+            {
+                while (true)
+                {
+                    if (load_in_page<16>(p))
+                    {
+                        const unsigned mask = mask_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+                        if (mask)
+                            return p + first_bit(mask);
+                        p += 16;
+                    }
+                    else
+                    {
+                        // Near the end of a page only the bytes up to the stop are read
+                        if (stops(*p))
+                            return p;
+                        ++p;
+                    }
+                }
+            }
+
+    #if defined(RAPIDXML_SIMD_AVX2)
+            __attribute__((target("avx2")))
+            static unsigned mask_avx2(__m256i v)
+            {
+                __m256i m = _mm256_setzero_si256();
+                ((m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(static_cast<char>(Chars))))), ...);
+                return static_cast<unsigned>(_mm256_movemask_epi8(m));
+            }
+
+            __attribute__((target("avx2")))
+            static char *skip_avx2(char *p)
+            {
+                while (true)
+                {
+                    if (load_in_page<32>(p))
+                    {
+                        const unsigned mask = mask_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+                        if (mask)
+                            return p + first_bit(mask);
+                        p += 32;
+                    }
+                    else
+                    {
+                        if (stops(*p))
+                            return p;
+                        ++p;
+                    }
+                }
+            }
+    #endif
+
+            // Most runs end within the first 16 bytes, which are tested inline. Longer runs continue
+            // with AVX2 if the CPU supports it, the check is only paid for them.
+            static char *skip(char *p)
+            {
+                if (load_in_page<16>(p))
+                {
+                    const unsigned mask = mask_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+                    if (mask)
+                        return p + first_bit(mask);
+                    p += 16;
+                }
+
+    #if defined(RAPIDXML_SIMD_AVX2) && defined(__AVX2__)
+                return skip_avx2(p);
+    #elif defined(RAPIDXML_SIMD_AVX2)
+                static const bool avx2 = __builtin_cpu_supports("avx2");
+                return avx2 ? skip_avx2(p) : skip_sse2(p);
+    #else
+                return skip_sse2(p);
+    #endif
+            }
+        };
+
+#endif
+
         // Find length of the string
         template<class Ch>
         inline std::size_t measure(const Ch *p)
@@ -1431,6 +1577,7 @@ namespace rapidxml
             {
                 return internal::lookup_tables<0>::lookup_whitespace[static_cast<unsigned char>(ch)];
             }
+            typedef internal::simd_none simd;
         };
 
         // Detect node name character
@@ -1440,6 +1587,7 @@ namespace rapidxml
             {
                 return internal::lookup_tables<0>::lookup_node_name[static_cast<unsigned char>(ch)];
             }
+            typedef internal::simd_none simd;
         };
 
         // Detect attribute name character
@@ -1449,6 +1597,7 @@ namespace rapidxml
             {
                 return internal::lookup_tables<0>::lookup_attribute_name[static_cast<unsigned char>(ch)];
             }
+            typedef internal::simd_none simd;
         };
 
         // Detect text character (PCDATA)
@@ -1458,6 +1607,11 @@ namespace rapidxml
             {
                 return internal::lookup_tables<0>::lookup_text[static_cast<unsigned char>(ch)];
             }
+#if defined(RAPIDXML_SIMD_SSE2)
+            typedef internal::simd_class<0, '<'> simd;
+#else
+            typedef internal::simd_none simd;
+#endif
         };
 
         // Detect text character (PCDATA) that does not require processing
@@ -1467,6 +1621,11 @@ namespace rapidxml
             {
                 return internal::lookup_tables<0>::lookup_text_pure_no_ws[static_cast<unsigned char>(ch)];
             }
+#if defined(RAPIDXML_SIMD_SSE2)
+            typedef internal::simd_class<0, '&', '<'> simd;
+#else
+            typedef internal::simd_none simd;
+#endif
         };
 
         // Detect text character (PCDATA) that does not require processing
@@ -1476,6 +1635,7 @@ namespace rapidxml
             {
                 return internal::lookup_tables<0>::lookup_text_pure_with_ws[static_cast<unsigned char>(ch)];
             }
+            typedef internal::simd_none simd;
         };
 
         // Detect attribute value character
@@ -1490,6 +1650,11 @@ namespace rapidxml
                     return internal::lookup_tables<0>::lookup_attribute_data_2[static_cast<unsigned char>(ch)];
                 return 0;       // Should never be executed, to avoid warnings on Comeau
             }
+#if defined(RAPIDXML_SIMD_SSE2)
+            typedef internal::simd_class<0, Quote> simd;
+#else
+            typedef internal::simd_none simd;
+#endif
         };
 
         // Detect attribute value character
@@ -1504,6 +1669,11 @@ namespace rapidxml
                     return internal::lookup_tables<0>::lookup_attribute_data_2_pure[static_cast<unsigned char>(ch)];
                 return 0;       // Should never be executed, to avoid warnings on Comeau
             }
+#if defined(RAPIDXML_SIMD_SSE2)
+            typedef internal::simd_class<0, '&', Quote> simd;
+#else
+            typedef internal::simd_none simd;
+#endif
         };
 
         // Insert coded character, using UTF8 or 8-bit ASCII
@@ -1558,6 +1728,11 @@ namespace rapidxml
         static void skip(Ch *&text)
         {
             Ch *tmp = text;
+            if (sizeof(Ch) == 1 && StopPred::simd::enabled)
+            {
+                text = reinterpret_cast<Ch *>(StopPred::simd::skip(reinterpret_cast<char *>(tmp)));
+                return;
+            }
             while (StopPred::test(*tmp))
                 ++tmp;
             text = tmp;
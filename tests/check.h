@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the test programs: failed checks are printed, main returns checkResult().
+namespace Indoor::Map::Test
+{
+    inline int failures = 0;
+
+    inline void check(bool condition, const char* expression, const char* file, int line)
+    {
+        if (!condition)
+        {
+            std::printf("%s:%d: check failed: %s\n", file, line, expression);
+            failures++;
+        }
+    }
+
+    inline int checkResult()
+    {
+        if (failures > 0)
+            std::printf("%d check(s) failed\n", failures);
+        return failures > 0 ? 1 : 0;
+    }
+}
+
+#define CHECK(condition) Indoor::Map::Test::check((condition), #condition, __FILE__, __LINE__)
@@ -0,0 +1,145 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "indoorMapCompression.h"
+#include "indoorMapHash.h"
+#include "indoorMapParser.h"
+#include "indoorMapWriter.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+// Built with INDOOR_MAP_WITH_ZLIB and, if libzstd is found, INDOOR_MAP_WITH_ZSTD (see CMakeLists.txt)
+
+static std::string gzip(const std::string& data)
+{
+    z_stream z{};
+    deflateInit2(&z, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&z, static_cast<uLong>(data.size())) + 64, '\0');
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    z.avail_in = static_cast<uInt>(data.size());
+    z.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    z.avail_out = static_cast<uInt>(out.size());
+    deflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    deflateEnd(&z);
+    return out;
+}
+
+#if defined(INDOOR_MAP_WITH_ZSTD)
+static std::string zstd(const std::string& data)
+{
+    std::string out(ZSTD_compressBound(data.size()), '\0');
+    out.resize(ZSTD_compress(&out[0], out.size(), data.data(), data.size(), 1));
+    return out;
+}
+#endif
+
+static DecompressStatus decompress(const std::string& data, std::string& out)
+{
+    out.clear();
+    return decompressBuffer(data.data(), data.size(), detectCompression(data.data(), data.size()), out);
+}
+
+// Through the stream reader, which reads on a second thread
+static DecompressStatus decompressChunked(const std::string& data, std::string& out)
+{
+    out.clear();
+    std::istringstream in(data);
+    return decompressStream(in, detectCompression(data.data(), data.size()), out);
+}
+
+static void checkFormat(const std::string& plain, std::string (*compress)(const std::string&))
+{
+    const std::string data = compress(plain);
+    CHECK(detectCompression(data.data(), data.size()) != CompressionFormat::None);
+
+    std::string out;
+    CHECK(decompress(data, out) == DecompressStatus::Ok);
+    CHECK(out == plain);
+    CHECK(decompressChunked(data, out) == DecompressStatus::Ok);
+    CHECK(out == plain);
+
+    // Concatenated members or frames
+    const std::string second = "second member";
+    CHECK(decompress(data + compress(second), out) == DecompressStatus::Ok);
+    CHECK(out == plain + second);
+    CHECK(decompressChunked(data + compress(second), out) == DecompressStatus::Ok);
+    CHECK(out == plain + second);
+
+    // Truncated
+    for (size_t size : { data.size() / 2, data.size() - 1 })
+    {
+        CHECK(decompress(data.substr(0, size), out) == DecompressStatus::Corrupt);
+        CHECK(decompressChunked(data.substr(0, size), out) == DecompressStatus::Corrupt);
+    }
+
+    // Corrupt, the checksum fails at the latest
+    std::string corrupt = data;
+    corrupt[corrupt.size() / 2] ^= 0x55;
+    corrupt[corrupt.size() - 6] ^= 0x55;
+    CHECK(decompress(corrupt, out) == DecompressStatus::Corrupt);
+
+    // Garbage after the last member
+    CHECK(decompress(data + "garbage", out) == DecompressStatus::Corrupt);
+}
+
+static void checkParser(const std::string& xml, std::string (*compress)(const std::string&))
+{
+    MapParser parser;
+    const ParseResult plain = parser.tryReadMapFromString(xml);
+    const ParseResult compressed = parser.tryReadMapFromString(compress(xml));
+    CHECK(plain.ok() && compressed.ok());
+    if (plain.ok() && compressed.ok())
+        CHECK(contentHash(*plain.map).all == contentHash(*compressed.map).all);
+
+    // Error positions refer to the decompressed document
+    const std::string invalid = "<map>\n<floors>\n<floor\n name='a' atHeight='x'/>\n</floors>\n</map>\n";
+    const ParseResult error = parser.tryReadMapFromString(compress(invalid));
+    CHECK(error.error.code == ParseErrorCode::InvalidAttribute);
+    CHECK(error.error.line() == 4);
+    CHECK(error.error.column() == 21);
+
+    const std::string filename = "testCompression.xml.z";
+    {
+        std::ofstream out(filename, std::ios::binary);
+        out << compress(xml);
+    }
+    const ParseResult file = parser.tryReadMapFromFile(filename);
+    CHECK(file.ok());
+    if (plain.ok() && file.ok())
+        CHECK(contentHash(*plain.map).all == contentHash(*file.map).all);
+    std::remove(filename.c_str());
+
+    const ParseResult truncated = parser.tryReadMapFromString(compress(xml).substr(0, 100));
+    CHECK(truncated.error.code == ParseErrorCode::InvalidCompressedData);
+}
+
+int main()
+{
+    std::string plain;
+    for (int i = 0; i < 20000; i++)
+        plain += "line " + std::to_string(i * 7919 % 10007) + "\n";
+
+    const std::string xml = writeMapXml(makeMap({ "F0", "F1", "F2" }));
+
+    CHECK(compressionSupported(CompressionFormat::Gzip));
+    checkFormat(plain, gzip);
+    checkParser(xml, gzip);
+
+#if defined(INDOOR_MAP_WITH_ZSTD)
+    CHECK(compressionSupported(CompressionFormat::Zstd));
+    checkFormat(plain, zstd);
+    checkParser(xml, zstd);
+#else
+    std::string out;
+    const std::string zstdMagic("\x28\xb5\x2f\xfd\0\0\0\0", 8);
+    CHECK(decompress(zstdMagic, out) == DecompressStatus::Unsupported);
+#endif
+
+    return Indoor::Map::Test::checkResult();
+}
@@ -0,0 +1,52 @@
+#include <utility>
+
+#include "indoorMapDiff.h"
+#include "indoorMapHash.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static void checkCopy()
+{
+    Map a = makeMap({ "F0", "F1" });
+    const MapHash hashA = contentHash(a);
+
+    // The copy is modified without invalidateContentHash(), it must not report the hash of a
+    Map b = a;
+    b.floors[1].walls[0].x2 = 12.0f;
+    CHECK(contentHash(b).all != hashA.all);
+    CHECK(contentHash(b).floors[1].walls != hashA.floors[1].walls);
+    CHECK(contentHash(b).floors[0].all == hashA.floors[0].all);
+    CHECK(diff(a, b).floors.size() == 1);
+
+    Map c = makeMap({ "F0" });
+    contentHash(c);
+    c = a;
+    c.floors[0].pois[0].x = 7.0f;
+    CHECK(contentHash(c).all != hashA.all);
+    CHECK(diff(a, c).floors.size() == 1);
+}
+
+static void checkInvalidate()
+{
+    Map a = makeMap({ "F0" });
+    const MapHash before = contentHash(a);
+    a.floors[0].walls.pop_back();
+    invalidateContentHash(a);
+    CHECK(contentHash(a).all != before.all);
+
+    // Equal content gives equal hashes, independent of the cache
+    Map moved = std::move(a);
+    Map rebuilt = makeMap({ "F0" });
+    rebuilt.floors[0].walls.pop_back();
+    CHECK(contentHash(moved).all == contentHash(rebuilt).all);
+}
+
+int main()
+{
+    checkCopy();
+    checkInvalidate();
+    return Indoor::Map::Test::checkResult();
+}
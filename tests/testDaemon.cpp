@@ -0,0 +1,218 @@
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "indoorMapDaemon.h"
+#include "indoorMapSharedMemory.h"
+#include "indoorMapWallSegments.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static bool waitFor(const std::function<bool()>& condition)
+{
+    for (int i = 0; i < 500; i++)
+    {
+        if (condition())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static QueryStatus lookup(MapQueryClient& client, const std::string& room)
+{
+    Query query;
+    query.type = QueryType::RoomLookup;
+    query.data = room;
+    return client.query({ query })[0].status();
+}
+
+class TestServer
+{
+public:
+    std::string shmName = "/indoor-map-test-" + std::to_string(getpid());
+    std::string socketPath = "/tmp/indoor-map-test-" + std::to_string(getpid()) + ".sock";
+    std::unique_ptr<MapQueryServer> server;
+    std::thread thread;
+    std::unique_ptr<MapQueryClient> client;
+
+    explicit TestServer(const Map& map, uint32_t maxFrameSize = 16 * 1024 * 1024)
+    {
+        SharedMap::publish(shmName, map);
+
+        MapQueryServer::Options options;
+        options.socketPath = socketPath;
+        options.maxFrameSize = maxFrameSize;
+        options.workerCount = 2;
+        options.reloadIntervalMs = 10;
+        server = std::make_unique<MapQueryServer>(options, std::vector<MapQueryServer::MapSource>{ { "shm:" + shmName } });
+        thread = std::thread([this] { server->run(); });
+
+        waitFor([&]
+        {
+            try
+            {
+                client = std::make_unique<MapQueryClient>(options.socketPath);
+                return true;
+            }
+            catch (const std::runtime_error&)
+            {
+                return false;
+            }
+        });
+    }
+
+    ~TestServer()
+    {
+        client.reset();
+        server->stop();
+        thread.join();
+        SharedMap::unpublish(shmName);
+    }
+};
+
+// Republishing with the default generation must be picked up
+static void checkReload()
+{
+    TestServer test(makeMap({ "F0" }));
+    CHECK(test.client != nullptr);
+    if (!test.client)
+        return;
+
+    CHECK(lookup(*test.client, "F0 entrance") == QueryStatus::Ok);
+
+    Map renamed = makeMap({ "F0" });
+    renamed.floors[0].pois[0].name = "F0 lobby";
+    SharedMap::publish(test.shmName, renamed);
+    CHECK(waitFor([&] { return lookup(*test.client, "F0 lobby") == QueryStatus::Ok; }));
+    CHECK(lookup(*test.client, "F0 entrance") == QueryStatus::NotFound);
+
+    // Equal content keeps the served map
+    const std::shared_ptr<const Map> served = test.server->map(0);
+    SharedMap::publish(test.shmName, renamed);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(test.server->map(0) == served);
+}
+
+// Many frames are sent before the responses are read. The server stops reading while its buffers are full,
+// every frame must still be answered in order.
+static void checkPipelining()
+{
+    TestServer test(makeMap({ "F0" }), 256);
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, test.socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    CHECK(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+
+    const std::string room = "F0 entrance";
+    QueryRequest request = {};
+    request.type = static_cast<uint16_t>(QueryType::RoomLookup);
+    request.dataLength = static_cast<uint32_t>(room.size());
+
+    std::vector<char> body;
+    detail::appendBytes(body, &request, sizeof(request));
+    detail::appendBytes(body, room.data(), room.size());
+    const QueryFrameHeader header = { QueryProtocolMagic, 1, static_cast<uint32_t>(body.size()) };
+
+    const int count = 2000;
+    std::vector<char> frames;
+    for (int i = 0; i < count; i++)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&header);
+        frames.insert(frames.end(), bytes, bytes + sizeof(header));
+        frames.insert(frames.end(), body.begin(), body.end());
+    }
+
+    // Written at once, the server answers while the client is still sending
+    std::thread writer([&] { detail::writeAll(fd, frames.data(), frames.size()); });
+
+    int answered = 0;
+    for (int i = 0; i < count; i++)
+    {
+        QueryFrameHeader responseHeader;
+        if (!detail::readAll(fd, reinterpret_cast<char*>(&responseHeader), sizeof(responseHeader)))
+            break;
+        std::vector<char> responseBody(responseHeader.bodySize);
+        if (!detail::readAll(fd, responseBody.data(), responseBody.size()) || responseHeader.count != 1)
+            break;
+
+        QueryResponse response;
+        std::memcpy(&response, responseBody.data(), sizeof(response));
+        if (static_cast<QueryStatus>(response.status) == QueryStatus::Ok)
+            answered++;
+    }
+    CHECK(answered == count);
+
+    writer.join();
+    ::close(fd);
+}
+
+static QueryStatus route(MapQueryClient& client)
+{
+    Query query;
+    query.type = QueryType::Route;
+    query.x = 2.0f;
+    query.y = 5.0f;
+    query.x2 = 8.0f;
+    query.y2 = 5.0f;
+    return client.query({ query })[0].status();
+}
+
+static QueryStatus setDoor(MapQueryClient& client, uint32_t door, bool open)
+{
+    const DoorStateUpdate update = { door, open ? 1u : 0u, 0.0f };
+    Query query;
+    query.type = QueryType::SetDoorState;
+    query.data.assign(reinterpret_cast<const char*>(&update), sizeof(update));
+    return client.query({ query })[0].status();
+}
+
+// Two rooms connected by the door of the middle wall
+static void checkDoorStates()
+{
+    Map map = makeMap({ "F0" });
+    Wall middle = makeWall(5.0f, 0.0f, 5.0f, 10.0f);
+    WallDoor door{};
+    door.width = 1.5f;
+    door.height = 2.0f;
+    door.atLinePos = 0.5f;
+    middle.doors.push_back(door);
+    map.floors[0].walls.push_back(middle);
+    for (Wall& wall : map.floors[0].walls)
+        generateWallSegments(wall);
+
+    TestServer test(map);
+    CHECK(test.client != nullptr);
+    if (!test.client)
+        return;
+
+    CHECK(test.server->doorStates(0) && test.server->doorStates(0)->size() == 1);
+    CHECK(route(*test.client) == QueryStatus::Ok);
+
+    CHECK(setDoor(*test.client, 0, false) == QueryStatus::Ok);
+    CHECK(route(*test.client) == QueryStatus::NotFound);
+
+    CHECK(setDoor(*test.client, 1, false) == QueryStatus::NotFound);
+
+    test.server->doorStates(0)->setOpen(0, true);
+    CHECK(route(*test.client) == QueryStatus::Ok);
+}
+
+int main()
+{
+    checkReload();
+    checkPipelining();
+    checkDoorStates();
+    return Indoor::Map::Test::checkResult();
+}
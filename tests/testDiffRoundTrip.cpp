@@ -0,0 +1,88 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "indoorMapDiff.h"
+#include "indoorMapHash.h"
+#include "indoorMapSnapshot.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static std::vector<std::string> floorNames(const Map& map)
+{
+    std::vector<std::string> names;
+    for (const Floor& floor : map.floors)
+        names.push_back(floor.name);
+    return names;
+}
+
+// hash(apply(a, diff(a, b))) == hash(b), for Map and MapSnapshot
+static void checkRoundTrip(const Map& a, const Map& b)
+{
+    const MapPatch patch = diff(a, b);
+    const std::shared_ptr<Map> patched = apply(a, patch);
+    CHECK(patched != nullptr);
+    if (patched)
+    {
+        CHECK(computeContentHash(*patched).all == computeContentHash(b).all);
+        CHECK(floorNames(*patched) == floorNames(b));
+    }
+
+    // Qualified, std::apply is found by ADL for the shared_ptr argument
+    const MapSnapshotPtr snapshot = Indoor::Map::apply(makeSnapshot(a), patch);
+    CHECK(computeContentHash(snapshot->toMap()).all == computeContentHash(b).all);
+
+    CHECK(patch.empty() == (computeContentHash(a).all == computeContentHash(b).all));
+}
+
+int main()
+{
+    const Map a = makeMap({ "F0", "F1" });
+
+    // Unchanged
+    checkRoundTrip(a, a);
+
+    // Floor inserted between existing floors
+    Map inserted = a;
+    inserted.floors.insert(inserted.floors.begin() + 1, makeFloor("Fnew", 1.5f));
+    checkRoundTrip(a, inserted);
+    CHECK(!diff(a, inserted).floorOrder.empty());
+
+    // Floor appended, the order does not need to be stored
+    Map appended = a;
+    appended.floors.push_back(makeFloor("F2", 6.0f));
+    checkRoundTrip(a, appended);
+    CHECK(diff(a, appended).floorOrder.empty());
+
+    // Floors swapped without other changes
+    Map swapped = a;
+    std::swap(swapped.floors[0], swapped.floors[1]);
+    checkRoundTrip(a, swapped);
+
+    // Removed, modified and added in front
+    Map mixed = a;
+    mixed.floors.erase(mixed.floors.begin());
+    mixed.floors[0].walls.pop_back();
+    mixed.floors[0].walls.push_back(makeWall(2.0f, 2.0f, 4.0f, 2.0f));
+    mixed.floors[0].pois[0].x = 3.0f;
+    mixed.floors.insert(mixed.floors.begin(), makeFloor("B1", -3.0f));
+    checkRoundTrip(a, mixed);
+    checkRoundTrip(mixed, a);
+
+    // Duplicate floor names are matched in order
+    const Map duplicates = makeMap({ "F", "F", "G" });
+    Map reordered = duplicates;
+    std::swap(reordered.floors[1], reordered.floors[2]);
+    reordered.floors[2].height = 4.0f;
+    checkRoundTrip(duplicates, reordered);
+
+    // A patch from another map is rejected, its floor and element indices do not fit
+    const MapPatch other = diff(makeMap({ "X0", "X1", "X2", "X3" }), a);
+    CHECK(apply(a, other) == nullptr);
+    CHECK(Indoor::Map::apply(makeSnapshot(a), other) == nullptr);
+
+    return Indoor::Map::Test::checkResult();
+}
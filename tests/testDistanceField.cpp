@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "indoorMapDistanceField.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static std::vector<char> readFile(const std::string& filename)
+{
+    std::ifstream in(filename, std::ios::binary);
+    return std::vector<char>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& filename, const std::vector<char>& data)
+{
+    std::ofstream out(filename, std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+int main()
+{
+    const std::string filename = "testDistanceField.bin";
+    const WalkableGrid grid(makeFloor("F0", 0.0f));
+    DistanceFieldBuilder builder(grid);
+    const DistanceField field = builder.compute({ Point2D(2.0f, 2.0f) });
+    CHECK(field.saveToFile(filename));
+
+    DistanceField loaded;
+    CHECK(loaded.loadFromFile(filename));
+    CHECK(loaded.values() == field.values());
+    CHECK(loaded.sourceHash() == field.sourceHash());
+
+    const std::vector<char> data = readFile(filename);
+
+    // Truncated values
+    writeFile(filename, std::vector<char>(data.begin(), data.end() - 4));
+    CHECK(!loaded.loadFromFile(filename));
+
+    // Sizes in the header which the file does not hold, the product overflows 32 bits and the byte count 64 bits
+    for (uint32_t size : { 0x10000u, 0xFFFFFFFFu })
+    {
+        std::vector<char> crafted = data;
+        DistanceFieldHeader header;
+        std::memcpy(&header, crafted.data(), sizeof(header));
+        header.width = size;
+        header.height = size;
+        std::memcpy(crafted.data(), &header, sizeof(header));
+        writeFile(filename, crafted);
+        CHECK(!loaded.loadFromFile(filename));
+    }
+
+    // Still holds the field loaded first
+    CHECK(loaded.values() == field.values());
+
+    std::remove(filename.c_str());
+    return Indoor::Map::Test::checkResult();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "indoorMap.h"
+
+// Small maps built in code for the test programs
+namespace Indoor::Map::Test
+{
+    inline Polygon2D makeSquare(const std::string& name, float x, float y, float size)
+    {
+        Polygon2D polygon{};
+        polygon.name = name;
+        polygon.method = PolygonMethod::Add;
+        polygon.points = { Point2D(x, y), Point2D(x + size, y), Point2D(x + size, y + size), Point2D(x, y + size) };
+        return polygon;
+    }
+
+    inline Wall makeWall(float x1, float y1, float x2, float y2)
+    {
+        Wall wall{};
+        wall.material = WallMaterial::Concrete;
+        wall.type = ObstacleType::Wall;
+        wall.x1 = x1;
+        wall.y1 = y1;
+        wall.x2 = x2;
+        wall.y2 = y2;
+        wall.thickness = 0.2f;
+        return wall;
+    }
+
+    // A 10 x 10 room with four walls and a POI
+    inline Floor makeFloor(const std::string& name, float atHeight)
+    {
+        Floor floor{};
+        floor.name = name;
+        floor.atHeight = atHeight;
+        floor.height = 3.0f;
+        floor.outline.polygons.push_back(makeSquare("main", 0.0f, 0.0f, 10.0f));
+        floor.walls.push_back(makeWall(0.0f, 0.0f, 10.0f, 0.0f));
+        floor.walls.push_back(makeWall(10.0f, 0.0f, 10.0f, 10.0f));
+        floor.walls.push_back(makeWall(10.0f, 10.0f, 0.0f, 10.0f));
+        floor.walls.push_back(makeWall(0.0f, 10.0f, 0.0f, 0.0f));
+
+        PointOfInterest poi{};
+        poi.name = name + " entrance";
+        poi.x = 5.0f;
+        poi.y = 1.0f;
+        floor.pois.push_back(poi);
+        return floor;
+    }
+
+    inline Map makeMap(const std::vector<std::string>& floorNames)
+    {
+        Map map{};
+        map.width = 10.0f;
+        map.depth = 10.0f;
+        for (size_t i = 0; i < floorNames.size(); i++)
+            map.floors.push_back(makeFloor(floorNames[i], 3.0f * static_cast<float>(i)));
+        return map;
+    }
+}
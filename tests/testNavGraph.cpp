@@ -0,0 +1,110 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "indoorMapDoorState.h"
+#include "indoorMapIsochrone.h"
+#include "indoorMapNavGraph.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+// The room is split at x = 5 by a wall with a door from y = 4 to y = 6
+static Map makeSplitRoom()
+{
+    Map map = makeMap({ "F0" });
+    Floor& floor = map.floors[0];
+    floor.walls.push_back(makeWall(5.0f, 0.0f, 5.0f, 4.0f));
+    floor.walls.push_back(makeWall(5.0f, 6.0f, 5.0f, 10.0f));
+
+    DoorObstacle door{};
+    door.x1 = 5.0f;
+    door.y1 = 4.0f;
+    door.x2 = 5.0f;
+    door.y2 = 6.0f;
+    door.height = 2.0f;
+    floor.doorObstacles.push_back(door);
+    return map;
+}
+
+static float pathLength(const NavGraph& graph, const Point2D& from, const Point2D& to)
+{
+    NavSearchWorkspace ws;
+    std::vector<NavWaypoint> path;
+    float length = 0.0f;
+    return shortestPath(graph, 0, from, 0, to, path, length, ws) ? length : std::numeric_limits<float>::infinity();
+}
+
+static void checkDoorCosts()
+{
+    const Map map = makeSplitRoom();
+    DoorStateOverlay doors(map);
+    const NavGraph graph(map, doors);
+    const uint32_t door = doors.doorObstacleId(0, 0);
+    const Point2D a(2.0f, 5.0f), b(8.0f, 5.0f);
+
+    const float free = pathLength(graph, a, b);
+    CHECK(std::abs(free - 6.0f) < 0.5f);
+
+    doors.setCost(door, 3.0f);
+    CHECK(std::abs(pathLength(graph, a, b) - (free + 3.0f)) < 1e-3f);
+
+    // Negative costs would break the bucket queue, they are stored as 0
+    doors.setCost(door, -4.0f);
+    CHECK(doors.get(door).cost == 0.0f);
+    CHECK(pathLength(graph, a, b) == free);
+
+    doors.set(door, DoorState{ true, std::nanf("") });
+    CHECK(doors.get(door).cost == 0.0f);
+    CHECK(pathLength(graph, a, b) == free);
+
+    doors.setOpen(door, false);
+    CHECK(pathLength(graph, a, b) == std::numeric_limits<float>::infinity());
+}
+
+static bool poiReached(const Isochrone& isochrone, uint32_t index)
+{
+    for (const ReachedElement& e : isochrone.pois)
+    {
+        if (e.index == index)
+            return true;
+    }
+    return false;
+}
+
+// Elements next to a reached cell are only reached if no wall is in between
+static void checkIsochroneElements()
+{
+    Map map = makeSplitRoom();
+    map.floors[0].pois.clear();
+    for (const Point2D& p : { Point2D(4.8f, 2.0f), Point2D(5.2f, 2.0f) })
+    {
+        PointOfInterest poi{};
+        poi.x = p.x;
+        poi.y = p.y;
+        map.floors[0].pois.push_back(poi);
+    }
+
+    DoorStateOverlay doors(map);
+    const NavGraph graph(map, doors);
+    Isochrone isochrone;
+    IsochroneWorkspace ws;
+
+    // The far side is about 5.6 away through the door
+    CHECK(reachableWithin(graph, 0, Point2D(2.0f, 2.0f), 4.0f, isochrone, ws));
+    CHECK(poiReached(isochrone, 0));
+    CHECK(!poiReached(isochrone, 1));
+
+    CHECK(reachableWithin(graph, 0, Point2D(2.0f, 2.0f), 7.0f, isochrone, ws));
+    CHECK(poiReached(isochrone, 0));
+    CHECK(poiReached(isochrone, 1));
+}
+
+int main()
+{
+    checkDoorCosts();
+    checkIsochroneElements();
+    return Indoor::Map::Test::checkResult();
+}
@@ -0,0 +1,93 @@
+#include <string>
+
+#include "indoorMapHash.h"
+#include "indoorMapParser.h"
+#include "indoorMapWriter.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+// Six floors with many walls, above the size from which documents are split
+static std::string makeLargeDocument()
+{
+    Map map = makeMap({ "F0", "F1", "F2", "F3", "F4", "F5" });
+    for (size_t f = 0; f < map.floors.size(); f++)
+    {
+        for (int i = 0; i < 3000; i++)
+        {
+            const float x = static_cast<float>(i % 97) * 0.1f;
+            const float y = static_cast<float>(i % 89) * 0.1f + static_cast<float>(f);
+            map.floors[f].walls.push_back(makeWall(x, y, x + 0.5f, y + 0.25f));
+        }
+    }
+    return writeMapXml(map);
+}
+
+static ParseResult parse(const std::string& xml, size_t threads)
+{
+    ParseOptions options;
+    options.parseThreads = threads;
+    MapParser parser(options);
+    return parser.tryReadMapFromString(xml);
+}
+
+// Both modes give the same map or the same error
+static void checkSameResult(const std::string& xml, ParseErrorCode expected)
+{
+    const ParseResult sequential = parse(xml, 1);
+    const ParseResult parallel = parse(xml, 4);
+
+    CHECK(sequential.error.code == expected);
+    CHECK(parallel.error.code == sequential.error.code);
+    CHECK(parallel.error.offset == sequential.error.offset);
+    CHECK(parallel.error.line() == sequential.error.line());
+    CHECK(parallel.error.column() == sequential.error.column());
+
+    CHECK(sequential.ok() == parallel.ok());
+    if (sequential.ok() && parallel.ok())
+        CHECK(contentHash(*sequential.map).all == contentHash(*parallel.map).all);
+}
+
+// Replaces the value of the first attribute name="..." after the n-th occurrence of marker
+static std::string replaceAttribute(std::string xml, const std::string& marker, int n, const std::string& name, const std::string& value)
+{
+    size_t pos = 0;
+    for (int i = 0; i <= n; i++)
+        pos = xml.find(marker, pos + 1);
+    const size_t begin = xml.find(name + "=\"", pos) + name.size() + 2;
+    const size_t end = xml.find('"', begin);
+    return xml.replace(begin, end - begin, value);
+}
+
+static std::string insertAfter(std::string xml, const std::string& marker, const std::string& text)
+{
+    return xml.insert(xml.find(marker) + marker.size(), text);
+}
+
+int main()
+{
+    const std::string xml = makeLargeDocument();
+    CHECK(xml.size() > (size_t(1) << 20));
+
+    checkSameResult(xml, ParseErrorCode::None);
+
+    // Errors within a floor, in the skeleton before and after the floors
+    checkSameResult(replaceAttribute(xml, "<floor ", 3, "atHeight", "x"), ParseErrorCode::InvalidAttribute);
+    checkSameResult(replaceAttribute(xml, "<floor ", 5, "thickness", "y"), ParseErrorCode::InvalidAttribute);
+    checkSameResult(replaceAttribute(xml, "<map ", 0, "width", "z"), ParseErrorCode::InvalidAttribute);
+    checkSameResult(insertAfter(xml, "</floors>", "\n  <earthReg><bad/></earthReg>"), ParseErrorCode::None);
+
+    // Malformed floor: the floor does not tokenize on its own
+    checkSameResult(insertAfter(xml, "<obstacles>", "<wall"), ParseErrorCode::XmlSyntax);
+
+    // Fallbacks: comments or CDATA within <floors>, malformed skeleton
+    checkSameResult(insertAfter(xml, "<floors>", "<!-- <floor name=\"hidden\"/> -->"), ParseErrorCode::None);
+    checkSameResult(insertAfter(xml, "</floor>", "<![CDATA[ </floors> ]]>"), ParseErrorCode::None);
+    checkSameResult(insertAfter(xml, "<floors>", "\n  <?pi </floor> ?>"), ParseErrorCode::None);
+    checkSameResult(xml.substr(0, xml.rfind("</map>")), ParseErrorCode::XmlSyntax);
+    checkSameResult(insertAfter(xml, "<earthReg", " x"), ParseErrorCode::XmlSyntax);
+
+    return Indoor::Map::Test::checkResult();
+}
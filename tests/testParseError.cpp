@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "indoorMapParser.h"
+#include "check.h"
+
+using namespace Indoor::Map;
+
+// rapidxml terminates the name "floor" in place by overwriting the newline after it
+static const char* invalidAttribute =
+    "<map>\n"
+    "<floors>\n"
+    "<floor\n"
+    " name='a' atHeight='x'/>\n"
+    "</floors>\n"
+    "</map>\n";
+
+static void checkString()
+{
+    MapParser parser;
+    const ParseResult result = parser.tryReadMapFromString(invalidAttribute);
+    CHECK(result.error.code == ParseErrorCode::InvalidAttribute);
+    CHECK(result.error.line() == 4);
+    CHECK(result.error.column() == 21);
+}
+
+static void checkEntities()
+{
+    // Entity translation moves text in place, newlines behind it must still be counted
+    const std::string xml =
+        "<map name='a &amp; b\n"
+        "&lt;c&gt;'>\n"
+        "<floors>\n"
+        "<floor name='a'\n"
+        "  atHeight='1' height='y'/>\n"
+        "</floors>\n"
+        "</map>\n";
+
+    MapParser parser;
+    const ParseResult result = parser.tryReadMapFromString(xml);
+    CHECK(result.error.code == ParseErrorCode::InvalidAttribute);
+    CHECK(result.error.line() == 5);
+    CHECK(result.error.column() == 24);
+}
+
+static void checkSyntax()
+{
+    MapParser parser;
+    const ParseResult result = parser.tryReadMapFromString("<map>\n<floors>\n<floor name='a'\n</floors>\n</map>\n");
+    CHECK(result.error.code == ParseErrorCode::XmlSyntax);
+    CHECK(result.error.line() == 4);
+    CHECK(result.error.column() == 1);
+}
+
+static void checkFile()
+{
+    const std::string filename = "testParseError.xml";
+    {
+        std::ofstream out(filename, std::ios::binary);
+        out << invalidAttribute;
+    }
+
+    MapParser parser;
+    const ParseResult result = parser.tryReadMapFromFile(filename);
+    CHECK(result.error.code == ParseErrorCode::InvalidAttribute);
+    CHECK(result.error.line() == 4);
+    CHECK(result.error.column() == 21);
+
+    bool thrown = false;
+    try
+    {
+        parser.readMapFromFile(filename);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        thrown = std::string(e.what()).find("line 4, column 21") != std::string::npos;
+    }
+    CHECK(thrown);
+
+    std::remove(filename.c_str());
+}
+
+int main()
+{
+    checkString();
+    checkEntities();
+    checkSyntax();
+    checkFile();
+    return Indoor::Map::Test::checkResult();
+}
@@ -0,0 +1,107 @@
+#include <cmath>
+#include <cstring>
+
+#include "indoorMapParticles.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static void checkFastMath()
+{
+    double logError = 0.0, sqrtError = 0.0, sinCosError = 0.0;
+    for (uint32_t r = 0; r < (1u << 24); r += 101)
+    {
+        const float u = detail::unitOpen(r << 8);
+        logError = std::max(logError, std::abs(detail::fastLog(u) - std::log(static_cast<double>(u))));
+    }
+    for (float x = 0.0f; x < 40.0f; x += 1e-3f)
+        sqrtError = std::max(sqrtError, std::abs(detail::fastSqrt(x) - std::sqrt(static_cast<double>(x))));
+    for (float t = -100.0f; t < 100.0f; t += 1.37e-3f)
+    {
+        float s, c;
+        detail::fastSinCosTurns(t, s, c);
+        const double a = 6.283185307179586 * static_cast<double>(t);
+        sinCosError = std::max(sinCosError, std::max(std::abs(s - std::sin(a)), std::abs(c - std::cos(a))));
+    }
+
+    CHECK(logError < 1e-6);
+    CHECK(sqrtError < 1e-5);
+    CHECK(sinCosError < 1e-6);
+}
+
+static ParticleSet makeParticles(size_t count)
+{
+    ParticleSet particles;
+    particles.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        particles.x[i] = 5.0f;
+        particles.y[i] = 5.0f;
+        particles.heading[i] = 0.0f;
+        particles.weight[i] = 1.0f;
+        particles.floor[i] = 0;
+    }
+    return particles;
+}
+
+// Not a multiple of the block size, so that the last block is partial
+static ParticleSet propagated(size_t threadCount)
+{
+    ParticleMotionOptions options;
+    options.seed = 42;
+    options.threadCount = threadCount;
+    ParticleMotionModel model(makeMap({ "F0" }), options);
+
+    ParticleMotion motion;
+    motion.stepLength = 0.7f;
+    motion.headingChange = 0.3f;
+
+    ParticleSet particles = makeParticles(5000);
+    for (int i = 0; i < 3; i++)
+        model.propagate(particles, motion);
+    return particles;
+}
+
+static bool sameBits(const std::vector<float>& a, const std::vector<float>& b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+int main()
+{
+    checkFastMath();
+
+    // Results do not depend on the number of threads
+    const ParticleSet single = propagated(1);
+    const ParticleSet multi = propagated(4);
+    CHECK(sameBits(single.x, multi.x));
+    CHECK(sameBits(single.y, multi.y));
+    CHECK(sameBits(single.heading, multi.heading));
+
+    // The heading noise is standard normal
+    {
+        ParticleMotionOptions options;
+        ParticleMotionModel model(makeMap({ "F0" }), options);
+        ParticleMotion motion;
+        motion.headingSigma = 1.0f;
+
+        const size_t n = 100000;
+        ParticleSet particles = makeParticles(n);
+        model.propagate(particles, motion);
+
+        double sum = 0.0, sum2 = 0.0;
+        for (float h : particles.heading)
+        {
+            sum += h;
+            sum2 += static_cast<double>(h) * h;
+        }
+        const double mean = sum / n;
+        const double sigma = std::sqrt(sum2 / n - mean * mean);
+        CHECK(std::abs(mean) < 0.02);
+        CHECK(std::abs(sigma - 1.0) < 0.02);
+    }
+
+    return Indoor::Map::Test::checkResult();
+}
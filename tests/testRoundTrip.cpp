@@ -0,0 +1,110 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "indoorMapBinary.h"
+#include "indoorMapHash.h"
+#include "indoorMapParser.h"
+#include "indoorMapWriter.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static Map makeRichMap()
+{
+    Map map = makeMap({ "F0", "F1" });
+    Floor& floor = map.floors[1];
+    floor.walls[0].doors.push_back(WallDoor{});
+    floor.walls[0].doors[0].atLinePos = 0.4f;
+    floor.walls[0].doors[0].width = 0.9f;
+    floor.walls[0].doors[0].height = 2.0f;
+
+    DoorObstacle door{};
+    door.x1 = 2.0f;
+    door.x2 = 3.0f;
+    door.height = 2.1f;
+    floor.doorObstacles.push_back(door);
+
+    AccessPoint ap{};
+    ap.name = "ap <&>";
+    ap.macAddress = "00:11:22:33:44:55";
+    ap.x = 1.5f;
+    ap.y = 2.5f;
+    floor.accessPoints.push_back(ap);
+    return map;
+}
+
+static std::shared_ptr<Map> parse(const std::string& xml)
+{
+    MapParser parser;
+    return parser.tryReadMapFromString(xml).map;
+}
+
+// parse -> write -> parse keeps the content
+static void checkXml()
+{
+    const std::shared_ptr<Map> first = parse(writeMapXml(makeRichMap()));
+    CHECK(first != nullptr);
+    if (!first)
+        return;
+
+    const std::shared_ptr<Map> second = parse(writeMapXml(*first));
+    CHECK(second != nullptr);
+    if (second)
+        CHECK(contentHash(*first).all == contentHash(*second).all);
+}
+
+static void checkBinary()
+{
+    const std::shared_ptr<Map> map = parse(writeMapXml(makeRichMap()));
+    CHECK(map != nullptr);
+    if (!map)
+        return;
+
+    const std::vector<uint8_t> data = encodeMapBinary(*map);
+    Map decoded;
+    CHECK(decodeMapBinary(data.data(), data.size(), decoded));
+    CHECK(contentHash(decoded).all == contentHash(*map).all);
+
+    // Truncated data
+    for (size_t size = 0; size < data.size(); size += 7)
+        CHECK(!decodeMapBinary(data.data(), size, decoded));
+}
+
+// Element counts must fit the remaining bytes with elements of the smallest size
+static void checkCounts()
+{
+    Map map;
+    map.floors.resize(1000);
+    std::vector<uint8_t> data = encodeMapBinary(map);
+
+    Map decoded;
+    CHECK(decodeMapBinary(data.data(), data.size(), decoded));
+    CHECK(decoded.floors.size() == 1000);
+
+    // The floor count is the only 1000 in the data
+    const uint32_t floors = 1000;
+    size_t at = 0;
+    for (size_t i = 0; i + 4 <= data.size(); i++)
+    {
+        if (std::memcmp(&data[i], &floors, 4) == 0)
+            at = i;
+    }
+    CHECK(at > 0);
+
+    for (uint32_t n : { 1001u, 100000u, 0xFFFFFFFFu })
+    {
+        std::memcpy(&data[at], &n, 4);
+        CHECK(!decodeMapBinary(data.data(), data.size(), decoded));
+    }
+}
+
+int main()
+{
+    checkXml();
+    checkBinary();
+    checkCounts();
+    return Indoor::Map::Test::checkResult();
+}
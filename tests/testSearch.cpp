@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "indoorMapKdTree.h"
+#include "indoorMapSearch.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static Map makeNamedMap()
+{
+    Map map = makeMap({ "F0", "F1" });
+    const char* names[] = { "Lecture Hall", "Cafeteria", "Library", "Main Hall" };
+    for (size_t f = 0; f < map.floors.size(); f++)
+    {
+        map.floors[f].pois.clear();
+        for (size_t i = 0; i < 4; i++)
+        {
+            PointOfInterest poi{};
+            poi.name = names[i];
+            poi.x = static_cast<float>(i);
+            poi.y = static_cast<float>(f);
+            map.floors[f].pois.push_back(poi);
+        }
+    }
+    return map;
+}
+
+static void checkSearch()
+{
+    std::vector<SearchHit> hits;
+    {
+        const Map map = makeNamedMap();
+        PoiSearchIndex index(map);
+
+        // Word prefixes, names of both floors
+        hits = index.prefix("hall");
+        CHECK(hits.size() == 4);
+        CHECK(std::all_of(hits.begin(), hits.end(), [](const SearchHit& h) { return h.name == "Lecture Hall" || h.name == "Main Hall"; }));
+
+        // The preferred floor first
+        SearchOptions options;
+        options.map = 0;
+        options.floor = 1;
+        hits = index.prefix("lib", options);
+        CHECK(hits.size() == 2);
+        CHECK(!hits.empty() && hits[0].floor == 1 && hits[0].source == SearchSource::PointOfInterest && hits[0].index == 2);
+
+        hits = index.fuzzy("cafetria");
+        CHECK(hits.size() == 2);
+        CHECK(!hits.empty() && hits[0].name == "Cafeteria" && hits[0].edits == 1);
+
+        options.maxResults = 3;
+        CHECK(index.search("ma", options).size() == 3);
+
+        // Adding maps reallocates the entries, the hits keep their names
+        hits = index.prefix("lecture");
+        for (uint32_t id = 1; id < 50; id++)
+            index.addMap(map, id);
+        CHECK(index.prefix("lecture", SearchOptions{ -1, -1, false, Point2D(), 1000, -1 }).size() == 100);
+    }
+
+    // The index is gone
+    CHECK(hits.size() == 2);
+    CHECK(std::all_of(hits.begin(), hits.end(), [](const SearchHit& h) { return h.name == "Lecture Hall"; }));
+}
+
+// Queries against a linear scan
+template<int Dim>
+static void checkKdTree(uint32_t seed)
+{
+    using Point = typename KdTree<Dim>::Point;
+    auto random = [&seed]
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / 16777216.0f * 100.0f;
+    };
+
+    std::vector<Point> points(500);
+    for (Point& p : points)
+    {
+        for (int d = 0; d < Dim; d++)
+            p[d] = random();
+    }
+
+    const KdTree<Dim> tree(points);
+    auto dist2 = [](const Point& a, const Point& b)
+    {
+        float sum = 0.0f;
+        for (int d = 0; d < Dim; d++)
+            sum += (a[d] - b[d]) * (a[d] - b[d]);
+        return sum;
+    };
+
+    std::vector<KdNeighbor> result;
+    for (int q = 0; q < 50; q++)
+    {
+        Point query;
+        for (int d = 0; d < Dim; d++)
+            query[d] = random();
+
+        std::vector<float> all;
+        for (const Point& p : points)
+            all.push_back(dist2(p, query));
+        std::vector<float> sorted = all;
+        std::sort(sorted.begin(), sorted.end());
+
+        const int nearest = tree.nearest(query);
+        CHECK(nearest >= 0 && all[nearest] == sorted[0]);
+
+        tree.knn(query, 7, result);
+        CHECK(result.size() == 7);
+        for (size_t i = 0; i < result.size(); i++)
+            CHECK(result[i].distanceSquared == sorted[i] && all[result[i].index] == sorted[i]);
+
+        tree.radius(query, 15.0f, result);
+        CHECK(result.size() == static_cast<size_t>(std::upper_bound(sorted.begin(), sorted.end(), 15.0f * 15.0f) - sorted.begin()));
+        for (const KdNeighbor& n : result)
+            CHECK(all[n.index] <= 15.0f * 15.0f);
+    }
+
+    CHECK(KdTree<Dim>().nearest(Point()) == -1);
+}
+
+int main()
+{
+    checkSearch();
+    checkKdTree<2>(1);
+    checkKdTree<3>(2);
+    return Indoor::Map::Test::checkResult();
+}
@@ -0,0 +1,128 @@
+#include <string>
+#include <thread>
+
+#include "indoorMapDiff.h"
+#include "indoorMapHash.h"
+#include "indoorMapSnapshot.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static const Floor* findFloor(const Map& map, const std::string& name)
+{
+    for (const Floor& floor : map.floors)
+    {
+        if (floor.name == name)
+            return &floor;
+    }
+    return nullptr;
+}
+
+// Publishes the change made by edit to the current snapshot, computes the patch again if another writer was first
+template<typename Edit>
+static void publishEdit(MapSnapshotStore& store, Edit edit)
+{
+    while (true)
+    {
+        const MapSnapshotPtr base = store.load();
+        Map map = base->toMap();
+        edit(map);
+
+        // Lets the other writer publish in between
+        std::this_thread::yield();
+        if (store.publish(diff(base->toMap(), map)))
+            return;
+    }
+}
+
+static void checkStalePatch()
+{
+    const Map a = makeMap({ "F0", "F1" });
+    MapSnapshotStore store(makeSnapshot(a));
+
+    Map inserted = a;
+    inserted.floors.insert(inserted.floors.begin(), makeFloor("B1", -3.0f));
+    Map modified = a;
+    modified.floors[1].pois[0].x = 2.0f;
+
+    const MapPatch first = diff(a, inserted);
+    const MapPatch stale = diff(a, modified);
+
+    const MapSnapshotPtr published = store.publish(first);
+    CHECK(published && published->version == 1);
+
+    // Diffed against a, the current snapshot has another floor 1
+    CHECK(!store.publish(stale));
+    CHECK(store.load() == published);
+
+    const Map current = store.load()->toMap();
+    Map retried = current;
+    retried.floors[2].pois[0].x = 2.0f;
+    CHECK(store.publish(diff(current, retried)) != nullptr);
+    CHECK(store.load()->contentHash == computeContentHash(retried).all);
+}
+
+static void checkConcurrentPublish()
+{
+    const int iterations = 200;
+    MapSnapshotStore store(makeSnapshot(makeMap({ "F0", "F1" })));
+
+    // Adds POIs to F1 while the other writer inserts and removes a floor in front of it
+    std::thread poiWriter([&]
+    {
+        for (int i = 0; i < iterations; i++)
+        {
+            publishEdit(store, [i](Map& map)
+            {
+                for (Floor& floor : map.floors)
+                {
+                    if (floor.name != "F1")
+                        continue;
+
+                    PointOfInterest poi{};
+                    poi.name = "poi " + std::to_string(i);
+                    poi.x = static_cast<float>(i);
+                    floor.pois.push_back(poi);
+                }
+            });
+        }
+    });
+
+    std::thread floorWriter([&]
+    {
+        for (int i = 0; i < iterations + 1; i++)
+        {
+            publishEdit(store, [](Map& map)
+            {
+                if (!map.floors.empty() && map.floors[0].name == "T")
+                    map.floors.erase(map.floors.begin());
+                else
+                    map.floors.insert(map.floors.begin(), makeFloor("T", -3.0f));
+            });
+        }
+    });
+
+    poiWriter.join();
+    floorWriter.join();
+
+    const MapSnapshotPtr snapshot = store.load();
+    const Map map = snapshot->toMap();
+    CHECK(snapshot->version == static_cast<uint64_t>(2 * iterations + 1));
+    CHECK(snapshot->contentHash == computeContentHash(map).all);
+    CHECK(map.floors.size() == 3);
+    CHECK(findFloor(map, "T") && findFloor(map, "F0") && findFloor(map, "F1"));
+
+    const Floor* f1 = findFloor(map, "F1");
+    const Floor* f0 = findFloor(map, "F0");
+    CHECK(f1 && f1->pois.size() == static_cast<size_t>(iterations + 1));
+    CHECK(f0 && f0->pois.size() == 1);
+}
+
+int main()
+{
+    checkStalePatch();
+    checkConcurrentPublish();
+    return Indoor::Map::Test::checkResult();
+}
@@ -0,0 +1,44 @@
+#include <vector>
+
+#include "indoorMapValidation.h"
+#include "check.h"
+#include "testMaps.h"
+
+using namespace Indoor::Map;
+using namespace Indoor::Map::Test;
+
+static size_t degeneratePolygons(const std::vector<Point2D>& points)
+{
+    Floor floor = makeFloor("F0", 0.0f);
+    floor.outline.polygons[0].points = points;
+
+    std::vector<ValidationIssue> issues;
+    validateFloor(floor, 0, issues);
+
+    size_t count = 0;
+    for (const ValidationIssue& issue : issues)
+    {
+        if (issue.type == ValidationIssueType::DegeneratePolygon)
+            count++;
+    }
+    return count;
+}
+
+int main()
+{
+    const Point2D a(0, 0), b(10, 0), c(10, 10), d(0, 10);
+
+    CHECK(degeneratePolygons({ a, b, c, d }) == 0);
+    CHECK(degeneratePolygons({ a, b, c, d, a }) == 0);
+    CHECK(degeneratePolygons({ a, b, c }) == 0);
+    CHECK(degeneratePolygons({ a, b, c, a }) == 0);
+    CHECK(degeneratePolygons({ a, a, b, b, c, a, a }) == 0);
+
+    CHECK(degeneratePolygons({ a, b }) == 1);
+    CHECK(degeneratePolygons({ a, b, a }) == 1);
+    CHECK(degeneratePolygons({ a, b, b, a }) == 1);
+    CHECK(degeneratePolygons({ a, a, a }) == 1);
+    CHECK(degeneratePolygons({}) == 1);
+
+    return Indoor::Map::Test::checkResult();
+}